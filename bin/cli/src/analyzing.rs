@@ -1,24 +1,48 @@
 use std::collections::HashMap;
 use std::path::PathBuf;
 
-use analyzer::{checker::RecursiveTypeChecker, project::Project};
-use vfs::Vfs;
+use analyzer::{checker::RecursiveTypeChecker, header::HeaderAnalyzer, project::Project};
+use rayon::prelude::*;
+use vfs::{Vfs, VirtulFile};
 
+use crate::cache::AnalysisCache;
 use crate::error::{CompilerError, Result};
 
-/// 分析项目中的所有文件
-pub fn analyze_project(input_paths: &[PathBuf], vfs: &Vfs) -> Result<Project> {
-    for input_path in input_paths {
-        let text = std::fs::read_to_string(input_path).map_err(CompilerError::Io)?;
-        let absolute_path = input_path
-            .canonicalize()
-            .unwrap_or_else(|_| input_path.clone());
-        vfs.new_file(absolute_path, text);
-    }
+/// 分析输入文件以及它们直接或间接导入的文件
+///
+/// `reuse_cache` 为 true 时，命中缓存的模块只加载元数据，不出现在 `Project::modules` 中
+pub fn analyze_project(
+    input_paths: &[PathBuf],
+    vfs: &Vfs,
+    cache: Option<&AnalysisCache>,
+    reuse_cache: bool,
+) -> Result<Project> {
+    // 并行读取所有输入文件，一次插入 VFS
+    let files = input_paths
+        .par_iter()
+        .map(|input_path| {
+            let text = vfs::load::read_text(input_path)?;
+            let absolute_path = input_path
+                .canonicalize()
+                .unwrap_or_else(|_| input_path.clone());
+            Ok(VirtulFile::new(absolute_path, text))
+        })
+        .collect::<std::io::Result<Vec<_>>>()
+        .map_err(CompilerError::Io)?;
+    let entries = vfs.new_files(files);
+
+    // 只加载入口文件可以导入到的模块，不需要在命令行中列出所有文件
+    HeaderAnalyzer::load_imports(vfs, &entries);
 
     // 初始化并分析项目
     let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
-    project.full_initialize(vfs);
+    match cache {
+        Some(cache) if reuse_cache => cache.initialize_project(&mut project, vfs),
+        _ => project.full_initialize(vfs),
+    }
+    if let Some(cache) = cache {
+        cache.store_project(&project, vfs);
+    }
 
     // 按文件收集错误
     let mut errors_by_file = HashMap::new();
@@ -0,0 +1,707 @@
+//! 分析结果缓存
+//!
+//! 每个模块分析完成后，把它的 `ThinModule` 和 import 列表写入缓存目录。再次编译时，
+//! 源码没有变化、且导入模块的接口指纹都与缓存记录一致的模块直接使用缓存的元数据，
+//! 跳过解析和语义分析
+
+use std::{
+    collections::HashMap,
+    fmt, fs,
+    hash::{Hash, Hasher},
+    path::{Path, PathBuf},
+    sync::Arc,
+};
+
+use analyzer::{
+    array::FlatArray,
+    module::{Constant, Field, FieldID, Function, Struct, StructID, ThinModule, VariableID},
+    project::Project,
+    r#type::Ty,
+    value::Value,
+};
+use serde::{Deserialize, Serialize};
+use sha2::{Digest, Sha256};
+use thunderdome::{Arena, Index};
+use tools::TextRange;
+use vfs::{FileID, Vfs};
+
+/// 缓存格式版本，格式变化时递增
+const FORMAT_VERSION: u32 = 4;
+
+/// 编译器版本，不同版本之间的缓存互不复用
+pub const COMPILER_VERSION: &str = env!("CARGO_PKG_VERSION");
+
+/// 缓存目录
+pub struct AnalysisCache {
+    dir: PathBuf,
+}
+
+/// 单个模块的缓存记录
+///
+/// 只缓存没有错误的模块，所以不需要保存错误信息
+#[derive(Serialize, Deserialize)]
+struct CacheEntry {
+    format_version: u32,
+    compiler_version: String,
+    /// 源码内容的哈希
+    source_hash: ContentHash,
+    /// 导入的模块路径，以及写入缓存时它们的接口指纹
+    imports: Vec<(PathBuf, ContentHash)>,
+    metadata: CachedMetadata,
+}
+
+/// 可序列化的 `ThinModule`
+///
+/// `FileID` 在每次编译时重新分配，这里替换为 `modules` 中路径的下标，
+/// 下标 0 是模块自身。arena 下标按原值保存，保证依赖方使用的 ID 不变
+#[derive(Serialize, Deserialize)]
+struct CachedMetadata {
+    modules: Vec<PathBuf>,
+    functions: Vec<(u64, CachedFunction)>,
+    structs: Vec<(u64, CachedStruct)>,
+    fields: Vec<(u64, CachedField)>,
+    constants: Vec<(u64, CachedConstant)>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct CachedFunction {
+    name: String,
+    params: Vec<u64>,
+    meta_types: Vec<(String, CachedTy)>,
+    ret_type: CachedTy,
+    have_local_impl: bool,
+    is_variadic: bool,
+    range: (u32, u32),
+}
+
+#[derive(Serialize, Deserialize)]
+struct CachedStruct {
+    name: String,
+    fields: Vec<CachedID>,
+    range: (u32, u32),
+}
+
+#[derive(Serialize, Deserialize)]
+struct CachedField {
+    name: String,
+    ty: CachedTy,
+    range: (u32, u32),
+}
+
+#[derive(Serialize, Deserialize)]
+struct CachedConstant {
+    name: String,
+    ty: CachedTy,
+    value: Option<CachedValue>,
+    range: (u32, u32),
+}
+
+/// 跨模块 ID：(模块路径下标, arena 下标)
+#[derive(Serialize, Deserialize, Hash, Clone, Copy)]
+struct CachedID {
+    module: usize,
+    index: u64,
+}
+
+#[derive(Serialize, Deserialize, Hash)]
+enum CachedTy {
+    I32,
+    I8,
+    U8,
+    U32,
+    I64,
+    U64,
+    Bool,
+    Void,
+    Array(Box<CachedTy>, Option<i32>),
+    Pointer {
+        pointee: Box<CachedTy>,
+        is_const: bool,
+    },
+    Struct {
+        id: CachedID,
+        name: String,
+    },
+    Const(Box<CachedTy>),
+}
+
+/// 导出常量的值，只包含 [`Value::is_portable`] 的值
+#[derive(Serialize, Deserialize, Hash)]
+enum CachedValue {
+    I32(i32),
+    I8(i8),
+    U8(u8),
+    U32(u32),
+    I64(i64),
+    U64(u64),
+    Bool(bool),
+    String(String),
+    /// 各维长度、元素类型和非零元素 (下标, 位模式)
+    FlatArray {
+        shape: Vec<u32>,
+        elem: CachedTy,
+        nonzeros: Vec<(usize, u64)>,
+    },
+    Struct(CachedID, Vec<CachedValue>),
+    StructZero(CachedID),
+    Null,
+}
+
+impl AnalysisCache {
+    pub fn new(dir: PathBuf) -> std::io::Result<Self> {
+        fs::create_dir_all(&dir)?;
+        Ok(Self { dir })
+    }
+
+    /// 使用缓存初始化项目
+    ///
+    /// 命中缓存的模块不会出现在 `project.modules` 中
+    pub fn initialize_project(&self, project: &mut Project, vfs: &Vfs) {
+        let mut entries = HashMap::new();
+        vfs.for_each_file(|file_id, file| {
+            if let Some(entry) = self.load(&file.path, &file.text) {
+                entries.insert(file_id, entry);
+            }
+        });
+
+        // 缓存中引用的模块必须都在本次编译的输入中
+        let mut cached = HashMap::new();
+        let mut imports = HashMap::new();
+        entries.retain(|file_id, entry: &mut CacheEntry| {
+            let targets: Option<Vec<FileID>> = entry
+                .imports
+                .iter()
+                .map(|(path, _)| vfs.get_file_id_by_path(path))
+                .collect();
+            if let Some(thin) = entry.metadata.decode(vfs)
+                && let Some(targets) = targets
+            {
+                cached.insert(*file_id, thin);
+                imports.insert(*file_id, targets);
+                true
+            } else {
+                false
+            }
+        });
+
+        project.initialize_with_cache(vfs, cached);
+        for (file_id, targets) in imports {
+            project.dependency.set_imports(file_id, targets);
+        }
+
+        // 导入模块的接口发生变化时缓存失效，重新分析后它自身的接口也可能变化，直到不动点。
+        // 接口变化后，导入它的完整模块由 materialize 重新分析，导入它的缓存模块在下一轮失效
+        loop {
+            let fingerprints = Self::fingerprints_with(project, vfs, &entries);
+            let stale: Vec<FileID> = entries
+                .iter()
+                .filter(|(_, entry)| {
+                    entry.imports.iter().any(|(path, fingerprint)| {
+                        vfs.get_file_id_by_path(path)
+                            .and_then(|id| fingerprints.get(&id))
+                            != Some(fingerprint)
+                    })
+                })
+                .map(|(file_id, _)| *file_id)
+                .collect();
+            if stale.is_empty() {
+                break;
+            }
+            for file_id in &stale {
+                entries.remove(file_id);
+            }
+            project.materialize(vfs, &stale);
+        }
+    }
+
+    /// 把分析完成且没有错误的模块写入缓存
+    pub fn store_project(&self, project: &Project, vfs: &Vfs) {
+        let fingerprints = fingerprints(project, vfs);
+        for (file_id, module) in &project.modules {
+            if !module.semantic_errors.is_empty() {
+                continue;
+            }
+            let Some(file) = vfs.get_file_by_file_id(file_id) else {
+                continue;
+            };
+            let path = file.path.clone();
+            let source_hash = hash_of(&file.text);
+            drop(file);
+
+            let Some(metadata) = project
+                .metadata
+                .get(file_id)
+                .and_then(|thin| CachedMetadata::encode(thin, *file_id, vfs))
+            else {
+                continue;
+            };
+            let imports: Option<Vec<_>> = project
+                .dependency
+                .imports_of(*file_id)
+                .iter()
+                .map(|target| {
+                    let file = vfs.get_file_by_file_id(target)?;
+                    Some((file.path.clone(), *fingerprints.get(target)?))
+                })
+                .collect();
+            let Some(imports) = imports else {
+                continue;
+            };
+
+            let entry = CacheEntry {
+                format_version: FORMAT_VERSION,
+                compiler_version: COMPILER_VERSION.to_string(),
+                source_hash,
+                imports,
+                metadata,
+            };
+            if let Err(e) = self.store(&path, &entry) {
+                eprintln!("Warning: failed to write analysis cache: {}", e);
+            }
+        }
+    }
+
+    /// 当前所有模块与路径无关的接口指纹，`entries` 中的模块使用缓存记录
+    fn fingerprints_with(
+        project: &Project,
+        vfs: &Vfs,
+        entries: &HashMap<FileID, CacheEntry>,
+    ) -> HashMap<FileID, ContentHash> {
+        project
+            .metadata
+            .iter()
+            .filter_map(|(file_id, thin)| {
+                let fingerprint = match entries.get(file_id) {
+                    Some(entry) => entry.metadata.fingerprint(),
+                    None => CachedMetadata::encode(thin, *file_id, vfs)?.fingerprint(),
+                };
+                Some((*file_id, fingerprint))
+            })
+            .collect()
+    }
+
+    /// 读取与当前源码和编译器版本一致的缓存记录
+    fn load(&self, path: &Path, text: &str) -> Option<CacheEntry> {
+        let bytes = fs::read(self.entry_path(path)).ok()?;
+        let entry: CacheEntry = serde_json::from_slice(&bytes).ok()?;
+        (entry.format_version == FORMAT_VERSION
+            && entry.compiler_version == COMPILER_VERSION
+            && entry.source_hash == hash_of(text))
+        .then_some(entry)
+    }
+
+    /// 先写入临时文件再重命名，避免并发编译读到不完整的记录
+    fn store(&self, path: &Path, entry: &CacheEntry) -> std::io::Result<()> {
+        let entry_path = self.entry_path(path);
+        let temp_path = entry_path.with_extension(format!("tmp{}", std::process::id()));
+        fs::write(&temp_path, serde_json::to_vec(entry)?)?;
+        fs::rename(&temp_path, &entry_path)
+    }
+
+    fn entry_path(&self, path: &Path) -> PathBuf {
+        self.dir.join(format!(
+            "{}.json",
+            hash_of(path.as_os_str().as_encoded_bytes())
+        ))
+    }
+}
+
+impl CachedMetadata {
+    fn encode(thin: &ThinModule, file_id: FileID, vfs: &Vfs) -> Option<Self> {
+        let mut encoder = Encoder {
+            vfs,
+            modules: Vec::new(),
+            ids: HashMap::new(),
+        };
+        encoder.module(file_id)?;
+
+        let functions = thin
+            .functions
+            .iter()
+            .map(|(idx, f)| {
+                let function = CachedFunction {
+                    name: f.name.clone(),
+                    params: f.params.iter().map(|p| p.0.to_bits()).collect(),
+                    meta_types: f
+                        .meta_types
+                        .iter()
+                        .map(|(name, ty)| Some((name.clone(), encoder.ty(ty)?)))
+                        .collect::<Option<_>>()?,
+                    ret_type: encoder.ty(&f.ret_type)?,
+                    have_local_impl: f.have_local_impl,
+                    is_variadic: f.is_variadic,
+                    range: encode_range(f.range),
+                };
+                Some((idx.to_bits(), function))
+            })
+            .collect::<Option<_>>()?;
+        let structs = thin
+            .structs
+            .iter()
+            .map(|(idx, s)| {
+                let struct_def = CachedStruct {
+                    name: s.name.clone(),
+                    fields: s
+                        .fields
+                        .iter()
+                        .map(|id| encoder.id(id.module, id.index))
+                        .collect::<Option<_>>()?,
+                    range: encode_range(s.range),
+                };
+                Some((idx.to_bits(), struct_def))
+            })
+            .collect::<Option<_>>()?;
+        let fields = thin
+            .fields
+            .iter()
+            .map(|(idx, f)| {
+                let field = CachedField {
+                    name: f.name.clone(),
+                    ty: encoder.ty(&f.ty)?,
+                    range: encode_range(f.range),
+                };
+                Some((idx.to_bits(), field))
+            })
+            .collect::<Option<_>>()?;
+        let constants = thin
+            .constants
+            .iter()
+            .map(|(idx, c)| {
+                let constant = CachedConstant {
+                    name: c.name.clone(),
+                    ty: encoder.ty(&c.ty)?,
+                    value: match &c.value {
+                        Some(value) => Some(encoder.value(value)?),
+                        None => None,
+                    },
+                    range: encode_range(c.range),
+                };
+                Some((idx.to_bits(), constant))
+            })
+            .collect::<Option<_>>()?;
+
+        Some(Self {
+            modules: encoder.modules,
+            functions,
+            structs,
+            fields,
+            constants,
+        })
+    }
+
+    /// 在当前的 Vfs 中还原 `ThinModule`，引用的模块不存在时返回 `None`
+    fn decode(&self, vfs: &Vfs) -> Option<ThinModule> {
+        let decoder = Decoder {
+            file_ids: self
+                .modules
+                .iter()
+                .map(|path| vfs.get_file_id_by_path(path))
+                .collect::<Option<_>>()?,
+        };
+
+        let mut thin = ThinModule::default();
+        for (idx, f) in &self.functions {
+            let function = Function {
+                name: f.name.clone(),
+                params: f
+                    .params
+                    .iter()
+                    .map(|p| Some(VariableID(Index::from_bits(*p)?)))
+                    .collect::<Option<_>>()?,
+                meta_types: f
+                    .meta_types
+                    .iter()
+                    .map(|(name, ty)| Some((name.clone(), decoder.ty(ty)?)))
+                    .collect::<Option<_>>()?,
+                ret_type: decoder.ty(&f.ret_type)?,
+                have_local_impl: f.have_local_impl,
+                is_variadic: f.is_variadic,
+                range: decode_range(f.range),
+            };
+            insert_at(Arc::make_mut(&mut thin.functions), *idx, function)?;
+        }
+        for (idx, s) in &self.structs {
+            let struct_def = Struct {
+                name: s.name.clone(),
+                fields: s
+                    .fields
+                    .iter()
+                    .map(|id| Some(FieldID::from(decoder.id(*id)?)))
+                    .collect::<Option<_>>()?,
+                range: decode_range(s.range),
+            };
+            insert_at(Arc::make_mut(&mut thin.structs), *idx, struct_def)?;
+        }
+        for (idx, f) in &self.fields {
+            let field = Field {
+                name: f.name.clone(),
+                ty: decoder.ty(&f.ty)?,
+                range: decode_range(f.range),
+            };
+            insert_at(Arc::make_mut(&mut thin.fields), *idx, field)?;
+        }
+        for (idx, c) in &self.constants {
+            let constant = Constant {
+                name: c.name.clone(),
+                ty: decoder.ty(&c.ty)?,
+                value: match &c.value {
+                    Some(value) => Some(decoder.value(value)?),
+                    None => None,
+                },
+                range: decode_range(c.range),
+            };
+            insert_at(Arc::make_mut(&mut thin.constants), *idx, constant)?;
+        }
+        Some(thin)
+    }
+
+    /// 与 `ThinModule::interface_fingerprint` 包含相同的内容，但使用路径代替 `FileID`，
+    /// 在不同次编译之间保持稳定
+    fn fingerprint(&self) -> ContentHash {
+        let mut hasher = ContentHasher::default();
+        self.modules.len().hash(&mut hasher);
+        for path in &self.modules {
+            path.as_os_str().as_encoded_bytes().hash(&mut hasher);
+        }
+        self.functions.len().hash(&mut hasher);
+        for (idx, function) in &self.functions {
+            idx.hash(&mut hasher);
+            function.name.hash(&mut hasher);
+            function.meta_types.hash(&mut hasher);
+            function.ret_type.hash(&mut hasher);
+            function.is_variadic.hash(&mut hasher);
+        }
+        self.structs.len().hash(&mut hasher);
+        for (idx, struct_def) in &self.structs {
+            idx.hash(&mut hasher);
+            struct_def.name.hash(&mut hasher);
+            struct_def.fields.hash(&mut hasher);
+        }
+        self.fields.len().hash(&mut hasher);
+        for (idx, field) in &self.fields {
+            idx.hash(&mut hasher);
+            field.name.hash(&mut hasher);
+            field.ty.hash(&mut hasher);
+        }
+        self.constants.len().hash(&mut hasher);
+        for (idx, constant) in &self.constants {
+            idx.hash(&mut hasher);
+            constant.name.hash(&mut hasher);
+            constant.ty.hash(&mut hasher);
+            constant.value.hash(&mut hasher);
+        }
+        hasher.digest()
+    }
+}
+
+/// `FileID` -> 模块路径下标
+struct Encoder<'a> {
+    vfs: &'a Vfs,
+    modules: Vec<PathBuf>,
+    ids: HashMap<FileID, usize>,
+}
+
+impl Encoder<'_> {
+    fn module(&mut self, file_id: FileID) -> Option<usize> {
+        if let Some(idx) = self.ids.get(&file_id) {
+            return Some(*idx);
+        }
+        let path = self.vfs.get_file_by_file_id(&file_id)?.path.clone();
+        self.modules.push(path);
+        self.ids.insert(file_id, self.modules.len() - 1);
+        Some(self.modules.len() - 1)
+    }
+
+    fn id(&mut self, module: FileID, index: Index) -> Option<CachedID> {
+        Some(CachedID {
+            module: self.module(module)?,
+            index: index.to_bits(),
+        })
+    }
+
+    fn ty(&mut self, ty: &Ty) -> Option<CachedTy> {
+        Some(match ty {
+            Ty::I32 => CachedTy::I32,
+            Ty::I8 => CachedTy::I8,
+            Ty::U8 => CachedTy::U8,
+            Ty::U32 => CachedTy::U32,
+            Ty::I64 => CachedTy::I64,
+            Ty::U64 => CachedTy::U64,
+            Ty::Bool => CachedTy::Bool,
+            Ty::Void => CachedTy::Void,
+            Ty::Array(inner, size) => CachedTy::Array(Box::new(self.ty(inner)?), *size),
+            Ty::Pointer { pointee, is_const } => CachedTy::Pointer {
+                pointee: Box::new(self.ty(pointee)?),
+                is_const: *is_const,
+            },
+            Ty::Struct { id, name } => CachedTy::Struct {
+                id: self.id(id.module, id.index)?,
+                name: name.clone(),
+            },
+            Ty::Const(inner) => CachedTy::Const(Box::new(self.ty(inner)?)),
+        })
+    }
+
+    fn value(&mut self, value: &Value) -> Option<CachedValue> {
+        Some(match value {
+            Value::I32(v) => CachedValue::I32(*v),
+            Value::I8(v) => CachedValue::I8(*v),
+            Value::U8(v) => CachedValue::U8(*v),
+            Value::U32(v) => CachedValue::U32(*v),
+            Value::I64(v) => CachedValue::I64(*v),
+            Value::U64(v) => CachedValue::U64(*v),
+            Value::Bool(v) => CachedValue::Bool(*v),
+            Value::String(v) => CachedValue::String(v.clone()),
+            Value::FlatArray(flat) => CachedValue::FlatArray {
+                shape: flat.shape.clone(),
+                elem: self.ty(&flat.elem)?,
+                nonzeros: flat.nonzeros().collect(),
+            },
+            Value::Struct(id, fields) => CachedValue::Struct(
+                self.id(id.module, id.index)?,
+                fields
+                    .iter()
+                    .map(|field| self.value(field))
+                    .collect::<Option<_>>()?,
+            ),
+            Value::StructZero(id) => CachedValue::StructZero(self.id(id.module, id.index)?),
+            Value::Null => CachedValue::Null,
+            // 叶子是模块内的表达式位置，导出的常量中不会出现
+            Value::Array(_) => return None,
+        })
+    }
+}
+
+/// 模块路径下标 -> 当前的 `FileID`
+struct Decoder {
+    file_ids: Vec<FileID>,
+}
+
+impl Decoder {
+    fn id(&self, id: CachedID) -> Option<(FileID, Index)> {
+        Some((*self.file_ids.get(id.module)?, Index::from_bits(id.index)?))
+    }
+
+    fn ty(&self, ty: &CachedTy) -> Option<Ty> {
+        Some(match ty {
+            CachedTy::I32 => Ty::I32,
+            CachedTy::I8 => Ty::I8,
+            CachedTy::U8 => Ty::U8,
+            CachedTy::U32 => Ty::U32,
+            CachedTy::I64 => Ty::I64,
+            CachedTy::U64 => Ty::U64,
+            CachedTy::Bool => Ty::Bool,
+            CachedTy::Void => Ty::Void,
+            CachedTy::Array(inner, size) => Ty::Array(Box::new(self.ty(inner)?), *size),
+            CachedTy::Pointer { pointee, is_const } => Ty::Pointer {
+                pointee: Box::new(self.ty(pointee)?),
+                is_const: *is_const,
+            },
+            CachedTy::Struct { id, name } => Ty::Struct {
+                id: StructID::from(self.id(*id)?),
+                name: name.clone(),
+            },
+            CachedTy::Const(inner) => Ty::Const(Box::new(self.ty(inner)?)),
+        })
+    }
+
+    fn value(&self, value: &CachedValue) -> Option<Value> {
+        Some(match value {
+            CachedValue::I32(v) => Value::I32(*v),
+            CachedValue::I8(v) => Value::I8(*v),
+            CachedValue::U8(v) => Value::U8(*v),
+            CachedValue::U32(v) => Value::U32(*v),
+            CachedValue::I64(v) => Value::I64(*v),
+            CachedValue::U64(v) => Value::U64(*v),
+            CachedValue::Bool(v) => Value::Bool(*v),
+            CachedValue::String(v) => Value::String(v.clone()),
+            CachedValue::FlatArray {
+                shape,
+                elem,
+                nonzeros,
+            } => Value::FlatArray(Arc::new(FlatArray::from_nonzeros(
+                shape.clone(),
+                self.ty(elem)?,
+                nonzeros.iter().copied(),
+            )?)),
+            CachedValue::Struct(id, fields) => Value::Struct(
+                StructID::from(self.id(*id)?),
+                fields
+                    .iter()
+                    .map(|field| self.value(field))
+                    .collect::<Option<_>>()?,
+            ),
+            CachedValue::StructZero(id) => Value::StructZero(StructID::from(self.id(*id)?)),
+            CachedValue::Null => Value::Null,
+        })
+    }
+}
+
+/// 按原下标插入 arena，下标无效或重复时返回 `None`
+fn insert_at<T>(arena: &mut Arena<T>, bits: u64, value: T) -> Option<()> {
+    let index = Index::from_bits(bits)?;
+    match arena.insert_at(index, value) {
+        None => Some(()),
+        Some(_) => None,
+    }
+}
+
+fn encode_range(range: TextRange) -> (u32, u32) {
+    (range.start().into(), range.end().into())
+}
+
+fn decode_range((start, end): (u32, u32)) -> TextRange {
+    TextRange::new(start, end)
+}
+
+/// 当前所有模块在不同次编译之间保持稳定的接口指纹
+pub fn fingerprints(project: &Project, vfs: &Vfs) -> HashMap<FileID, ContentHash> {
+    AnalysisCache::fingerprints_with(project, vfs, &HashMap::new())
+}
+
+/// 写入磁盘的内容哈希（SHA-256）
+///
+/// 缓存按它查找和校验记录，碰撞会静默复用另一个文件的分析结果或目标文件，
+/// 所以不能使用只用于内部表的 FxHash
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Hash, Serialize, Deserialize)]
+pub struct ContentHash([u8; 32]);
+
+impl fmt::Display for ContentHash {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        for byte in &self.0 {
+            write!(f, "{:02x}", byte)?;
+        }
+        Ok(())
+    }
+}
+
+/// 把 `Hash` 写入的数据输入 SHA-256
+///
+/// 整数按本机字节序写入，缓存只在同一台机器上复用。路径按字节哈希，不依赖 `Path` 的
+/// `Hash` 实现
+#[derive(Default, Clone)]
+pub struct ContentHasher(Sha256);
+
+impl ContentHasher {
+    pub fn digest(self) -> ContentHash {
+        ContentHash(self.0.finalize().into())
+    }
+}
+
+impl Hasher for ContentHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        self.0.update(bytes);
+    }
+
+    /// 截断的摘要，只用于满足 `Hasher`，写入磁盘的键使用 [`ContentHasher::digest`]
+    fn finish(&self) -> u64 {
+        let digest = self.0.clone().finalize();
+        u64::from_le_bytes(digest[..8].try_into().unwrap())
+    }
+}
+
+pub fn hash_of<T: Hash + ?Sized>(value: &T) -> ContentHash {
+    let mut hasher = ContentHasher::default();
+    value.hash(&mut hasher);
+    hasher.digest()
+}
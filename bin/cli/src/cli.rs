@@ -10,7 +10,7 @@ use clap::{Parser, ValueEnum};
     about = "https://github.com/widsnoy/airyc/"
 )]
 pub struct Args {
-    /// source file(s) (.airy) path - can specify multiple files
+    /// entry source file(s) (.airy) path; imported files are loaded automatically
     pub input_path: Vec<PathBuf>,
 
     /// output dir, (default .)
@@ -24,6 +24,57 @@ pub struct Args {
     /// optimization level
     #[arg(short = 'O', default_value = "default")]
     pub opt_level: OptLevel,
+
+    /// target cpu, e.g. x86-64-v3, or native for the host cpu
+    #[arg(long, default_value = "generic")]
+    pub target_cpu: String,
+
+    /// target features, e.g. +avx2,+fma
+    #[arg(long, default_value = "")]
+    pub target_features: String,
+
+    /// let optimizations assume that int, long, bool and pointer accesses never alias
+    /// (C strict aliasing); type punning through `*void` becomes undefined behavior
+    #[arg(long)]
+    pub strict_aliasing: bool,
+
+    /// let optimizations assume that signed integer arithmetic never overflows;
+    /// overflow becomes undefined behavior instead of wrapping
+    #[arg(long)]
+    pub no_signed_overflow: bool,
+
+    /// link all modules into one LLVM module before optimization (whole-program LTO)
+    #[arg(long)]
+    pub lto: bool,
+
+    /// split each module into up to N codegen units that are generated and optimized
+    /// in parallel; calls between units are not inlined (ignored with --lto and --emit ir)
+    #[arg(long, default_value_t = 1, value_parser = clap::value_parser!(u32).range(1..))]
+    pub codegen_units: u32,
+
+    /// instrument the generated code to write an LLVM profile (default.profraw) when run
+    #[arg(long, conflicts_with = "profile_use")]
+    pub profile_generate: bool,
+
+    /// optimize with a profile merged by `llvm-profdata merge`
+    #[arg(long, value_name = "FILE")]
+    pub profile_use: Option<PathBuf>,
+
+    /// cache dir for analysis results, disabled if not specified
+    #[arg(long)]
+    pub cache_dir: Option<PathBuf>,
+
+    /// print the time spent in each compiler phase and module
+    #[arg(long)]
+    pub time_passes: bool,
+
+    /// print counts (tokens, syntax nodes, symbols, IR instructions) and peak memory
+    #[arg(long)]
+    pub stats: bool,
+
+    /// write a Chrome trace (chrome://tracing, Perfetto) of the compiler phases to this file
+    #[arg(long)]
+    pub trace: Option<PathBuf>,
 }
 
 /// 编译输出目标
@@ -33,6 +84,12 @@ pub enum EmitTarget {
     Ir,
     /// 输出可执行文件
     Exe,
+    /// 输出合并后的单个目标文件 (.o 文件)
+    Obj,
+    /// 输出静态库 (.a 文件)
+    Lib,
+    /// JIT 编译并直接运行 `main`
+    Run,
     /// 输出 AST
     Ast,
     /// 静态分析
@@ -40,7 +97,7 @@ pub enum EmitTarget {
 }
 
 /// 优化级别
-#[derive(Copy, Clone, PartialEq, Eq, PartialOrd, Ord, ValueEnum, Debug)]
+#[derive(Copy, Clone, PartialEq, Eq, PartialOrd, Ord, Hash, ValueEnum, Debug)]
 pub enum OptLevel {
     None,
     Less,
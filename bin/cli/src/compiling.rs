@@ -1,11 +1,16 @@
+use std::cell::RefCell;
 use std::collections::HashMap;
 use std::path::Path;
+use std::rc::Rc;
+use std::sync::Once;
 
 use analyzer::module::Module;
 use analyzer::project::Project;
 use codegen::error::{CodegenError, Result};
-use codegen::llvm_ir::Program;
+use codegen::llvm_ir::{CodegenOptions, CodegenUnit, Program};
 use inkwell::context::Context as LlvmContext;
+use inkwell::memory_buffer::MemoryBuffer;
+use inkwell::module::Linkage;
 use inkwell::passes::PassBuilderOptions;
 use inkwell::targets::{
     CodeModel, FileType, InitializationConfig, RelocMode, Target, TargetMachine,
@@ -14,9 +19,56 @@ use rayon::prelude::*;
 use rowan::GreenNode;
 use syntax::SyntaxNode;
 use syntax::ast::{AstNode, CompUnit};
-use vfs::Vfs;
+use tools::profile;
+use vfs::{FileID, Vfs};
 
 use crate::cli::OptLevel;
+use crate::object_cache::ObjectCache;
+use crate::pgo;
+
+/// 目标机器的 CPU 和特性配置
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct TargetConfig {
+    pub cpu: String,
+    pub features: String,
+}
+
+impl TargetConfig {
+    /// `cpu` 为 `native` 时使用本机的 CPU 名称和全部特性，`features` 追加在其后
+    pub fn new(cpu: &str, features: &str) -> Self {
+        if cpu != "native" {
+            return Self {
+                cpu: cpu.to_string(),
+                features: features.to_string(),
+            };
+        }
+
+        let cpu = TargetMachine::get_host_cpu_name()
+            .to_string_lossy()
+            .into_owned();
+        let mut host_features = TargetMachine::get_host_cpu_features()
+            .to_string_lossy()
+            .into_owned();
+        if !features.is_empty() {
+            if !host_features.is_empty() {
+                host_features.push(',');
+            }
+            host_features.push_str(features);
+        }
+        Self {
+            cpu,
+            features: host_features,
+        }
+    }
+}
+
+thread_local! {
+    /// 每个线程缓存的目标机器
+    ///
+    /// `TargetMachine` 不能跨线程共享，rayon 的工作线程各自创建一次后复用
+    static TARGET_MACHINES: RefCell<HashMap<(OptLevel, TargetConfig), Rc<TargetMachine>>> =
+        RefCell::new(HashMap::new());
+}
 
 /// 编译到 LLVM IR 文件
 /// 将语义分析后的 AST 转换为 LLVM IR 并写入 .ll 文件
@@ -25,10 +77,21 @@ pub fn compile_to_ir_file(
     green_node: GreenNode,
     analyzer: &Module,
     opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
     output_path: &Path,
 ) -> Result<()> {
     let context = LlvmContext::create();
-    let module = generate_and_optimize(&context, module_name, green_node, analyzer, opt_level)?;
+    let module = generate_and_optimize(
+        &context,
+        module_name,
+        green_node,
+        analyzer,
+        None,
+        opt_level,
+        target,
+        options,
+    )?;
     module
         .print_to_file(output_path)
         .map_err(|e| CodegenError::LlvmWrite(e.to_string()))?;
@@ -41,22 +104,85 @@ pub fn compile_to_ir_file(
 
 /// 编译到目标文件字节数据
 /// 将语义分析后的 AST 转换为目标文件（.o）的字节数据
+///
+/// `codegen_units` 大于 1 时把模块的函数体分成多个代码生成单元，并行生成和优化，
+/// 每个单元输出一个目标文件。单元之间的调用不能内联
 pub fn compile_to_object_bytes(
     module_name: &str,
     green_node: GreenNode,
     analyzer: &Module,
+    codegen_units: usize,
     opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+) -> Result<Vec<Vec<u8>>> {
+    let units = match codegen_units {
+        0 | 1 => Vec::new(),
+        _ => {
+            let root = SyntaxNode::new_root(green_node.clone());
+            let comp_unit = CompUnit::cast(root).ok_or(CodegenError::InvalidRoot)?;
+            CodegenUnit::partition(&comp_unit, codegen_units)
+        }
+    };
+    if units.len() <= 1 {
+        let object_bytes = compile_unit_to_object_bytes(
+            module_name,
+            green_node,
+            analyzer,
+            None,
+            opt_level,
+            target,
+            options,
+        )?;
+        return Ok(vec![object_bytes]);
+    }
+
+    units
+        .into_par_iter()
+        .map(|unit| {
+            let unit_name = format!("{}.cgu{}", module_name, unit.index);
+            compile_unit_to_object_bytes(
+                &unit_name,
+                green_node.clone(),
+                analyzer,
+                Some(unit),
+                opt_level,
+                target,
+                options,
+            )
+        })
+        .collect()
+}
+
+/// 编译一个代码生成单元，`unit` 为 None 时编译整个模块
+fn compile_unit_to_object_bytes(
+    module_name: &str,
+    green_node: GreenNode,
+    analyzer: &Module,
+    unit: Option<CodegenUnit>,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
 ) -> Result<Vec<u8>> {
     let context = LlvmContext::create();
-    let module = generate_and_optimize(&context, module_name, green_node, analyzer, opt_level)?;
+    let module = generate_and_optimize(
+        &context,
+        module_name,
+        green_node,
+        analyzer,
+        unit,
+        opt_level,
+        target,
+        options,
+    )?;
     module
         .verify()
         .map_err(|e| CodegenError::LlvmVerification(e.to_string_lossy().to_string()))?;
 
-    // 初始化目标机器
-    let machine = create_target_machine(opt_level)?;
+    let machine = target_machine(opt_level, target)?;
 
     // 生成目标文件到内存
+    let _span = profile::span_with("emit object", || module_name.to_string());
     let buffer = machine
         .write_to_memory_buffer(&module, FileType::Object)
         .map_err(|e| CodegenError::LlvmWrite(e.to_string()))?;
@@ -65,14 +191,52 @@ pub fn compile_to_object_bytes(
 }
 
 /// 生成并优化 LLVM IR
+#[allow(clippy::too_many_arguments)]
 fn generate_and_optimize<'ctx>(
     context: &'ctx LlvmContext,
     module_name: &str,
     green_node: GreenNode,
     analyzer: &Module,
+    unit: Option<CodegenUnit>,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+) -> Result<inkwell::module::Module<'ctx>> {
+    let module = generate_module(
+        context,
+        module_name,
+        green_node,
+        analyzer,
+        unit,
+        opt_level,
+        target,
+        options,
+    )?;
+    optimize_module(&module, opt_level, target)?;
+    Ok(module)
+}
+
+/// 生成未优化的 LLVM IR
+///
+/// 生成前设置目标机器和数据布局，聚合初始化按目标机器的类型布局选择方式
+#[allow(clippy::too_many_arguments)]
+fn generate_module<'ctx>(
+    context: &'ctx LlvmContext,
+    module_name: &str,
+    green_node: GreenNode,
+    analyzer: &Module,
+    unit: Option<CodegenUnit>,
     opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
 ) -> Result<inkwell::module::Module<'ctx>> {
+    let machine = target_machine(opt_level, target)?;
+    let target_data = machine.get_target_data();
+
+    let span = profile::span_with("llvm codegen", || module_name.to_string());
     let module = context.create_module(module_name);
+    module.set_triple(&machine.get_triple());
+    module.set_data_layout(&target_data.get_data_layout());
     let builder = context.create_builder();
 
     let mut program = Program {
@@ -80,72 +244,342 @@ fn generate_and_optimize<'ctx>(
         builder: &builder,
         module: &module,
         analyzer,
+        target_data: &target_data,
+        options,
         symbols: Default::default(),
         string_constants: HashMap::new(),
+        unit,
     };
 
     let root = SyntaxNode::new_root(green_node);
     let comp_unit = CompUnit::cast(root).ok_or(CodegenError::InvalidRoot)?;
 
     program.compile_comp_unit(comp_unit)?;
+    drop(span);
 
-    // 设置目标机器信息
-    let machine = create_target_machine(opt_level)?;
+    if profile::is_enabled() {
+        profile::count("ir instructions", count_instructions(&module));
+    }
+    Ok(module)
+}
+
+/// 设置目标机器信息并运行优化 pass
+fn optimize_module(
+    module: &inkwell::module::Module,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+) -> Result<()> {
+    let machine = target_machine(opt_level, target)?;
     module.set_triple(&machine.get_triple());
     module.set_data_layout(&machine.get_target_data().get_data_layout());
 
     // 运行 LLVM IR 优化 pass
-    run_optimization_passes(&module, &machine, opt_level)?;
+    let span = profile::span_with("llvm optimize", || {
+        module.get_name().to_string_lossy().into_owned()
+    });
+    run_optimization_passes(module, &machine, opt_level)?;
+    drop(span);
 
-    Ok(module)
+    if profile::is_enabled() {
+        profile::count("optimized ir instructions", count_instructions(module));
+    }
+    Ok(())
+}
+
+/// 统计模块中所有函数的指令数
+fn count_instructions(module: &inkwell::module::Module) -> u64 {
+    let mut count = 0;
+    for function in module.get_functions() {
+        for block in function.get_basic_blocks() {
+            let mut instruction = block.get_first_instruction();
+            while let Some(inst) = instruction {
+                count += 1;
+                instruction = inst.get_next_instruction();
+            }
+        }
+    }
+    count
+}
+
+/// 整个程序一起优化（LTO）：链接所有模块后只运行一次优化 pass，跨模块的调用可以被内联
+///
+/// 各模块先在各自的 context 中并行生成 bitcode，再读入同一个 context 链接。
+/// `internalize` 为 true 时除 `main` 外的定义都改为内部链接，未被使用的函数可以被删除
+pub fn compile_project_lto<'ctx>(
+    context: &'ctx LlvmContext,
+    project: &Project,
+    vfs: &Vfs,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+    internalize: bool,
+) -> Result<inkwell::module::Module<'ctx>> {
+    let mut bitcodes = project
+        .modules
+        .par_iter()
+        .map(|(file_id, module)| {
+            let module_name = module_name(vfs, file_id);
+            let context = LlvmContext::create();
+            let llvm_module = generate_module(
+                &context,
+                &module_name,
+                module.green_tree.clone(),
+                module,
+                None,
+                opt_level,
+                target,
+                options,
+            )?;
+            let bitcode = llvm_module.write_bitcode_to_memory().as_slice().to_vec();
+            Ok((module_name, bitcode))
+        })
+        .collect::<Result<Vec<_>>>()?;
+    // 链接顺序与 HashMap 的遍历顺序无关，保证输出稳定
+    bitcodes.sort();
+
+    let span = profile::span("lto link");
+    let combined = context.create_module("lto");
+    for (module_name, bitcode) in bitcodes {
+        let buffer = MemoryBuffer::create_from_memory_range_copy(&bitcode, &module_name);
+        let llvm_module = inkwell::module::Module::parse_bitcode_from_buffer(&buffer, context)
+            .map_err(|e| CodegenError::LlvmLink(e.to_string()))?;
+        combined
+            .link_in_module(llvm_module)
+            .map_err(|e| CodegenError::LlvmLink(e.to_string()))?;
+    }
+
+    if internalize {
+        for function in combined.get_functions() {
+            if !function.as_global_value().is_declaration()
+                && function.get_name().to_bytes() != b"main"
+            {
+                function.set_linkage(Linkage::Internal);
+            }
+        }
+        for global in combined.get_globals() {
+            if !global.is_declaration() {
+                global.set_linkage(Linkage::Internal);
+            }
+        }
+    }
+
+    drop(span);
+
+    combined
+        .verify()
+        .map_err(|e| CodegenError::LlvmVerification(e.to_string_lossy().to_string()))?;
+    optimize_module(&combined, opt_level, target)?;
+    Ok(combined)
+}
+
+/// LTO 模式下输出整个程序的 LLVM IR 到单个 .ll 文件
+pub fn compile_project_lto_to_ir_file(
+    project: &Project,
+    vfs: &Vfs,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+    output_path: &Path,
+) -> Result<()> {
+    let context = LlvmContext::create();
+    let module = compile_project_lto(&context, project, vfs, opt_level, target, options, true)?;
+    module
+        .print_to_file(output_path)
+        .map_err(|e| CodegenError::LlvmWrite(e.to_string()))
+}
+
+/// LTO 模式下编译整个程序为单个目标文件
+pub fn compile_project_lto_to_object_bytes(
+    project: &Project,
+    vfs: &Vfs,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+    internalize: bool,
+) -> Result<Vec<u8>> {
+    let context = LlvmContext::create();
+    let module = compile_project_lto(
+        &context,
+        project,
+        vfs,
+        opt_level,
+        target,
+        options,
+        internalize,
+    )?;
+    let machine = target_machine(opt_level, target)?;
+    let _span = profile::span_with("emit object", || "lto".to_string());
+    let buffer = machine
+        .write_to_memory_buffer(&module, FileType::Object)
+        .map_err(|e| CodegenError::LlvmWrite(e.to_string()))?;
+    Ok(buffer.as_slice().to_vec())
+}
+
+/// JIT 编译整个程序并调用 `main`，返回 `main` 的返回值
+///
+/// 与 LTO 相同，先把所有模块链接为一个 LLVM 模块并优化，再由 MCJIT 生成机器码，不写入磁盘。
+/// 只声明未定义的函数中，运行时库的函数映射到编译器中链接的同一份实现，其他的（`printf`、
+/// `scanf` 等）在编译器进程中按符号名解析到 libc
+pub fn run_project_jit(
+    project: &Project,
+    vfs: &Vfs,
+    opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+) -> Result<i32> {
+    type MainFn = unsafe extern "C" fn() -> i32;
+
+    let context = LlvmContext::create();
+    let module = compile_project_lto(&context, project, vfs, opt_level, target, options, true)?;
+
+    let span = profile::span("jit");
+    let engine = module
+        .create_jit_execution_engine(opt_level.into())
+        .map_err(|e| CodegenError::TargetMachine(e.to_string()))?;
+    // 运行时库链接在编译器中，程序中没有实现的运行时函数使用这里的实现
+    for (name, address) in runtime::symbols() {
+        if let Some(function) = module.get_function(name)
+            && function.count_basic_blocks() == 0
+        {
+            engine.add_global_mapping(&function, address);
+        }
+    }
+    let main = unsafe { engine.get_function::<MainFn>("main") }
+        .map_err(|_| CodegenError::UndefinedFunc("main".to_string()))?;
+    drop(span);
+
+    Ok(unsafe { main.call() })
 }
 
 /// 将 Project 中的所有模块分别编译为目标文件
+///
+/// 每个模块至多分为 `codegen_units` 个代码生成单元，见 [`compile_to_object_bytes`]。
+/// 给出 `cache` 时，缓存键没有变化的模块直接复用缓存的目标文件。只加载了缓存元数据、
+/// 但没有命中目标文件的模块会先重新分析
 /// - `Ok(Vec<(String, Vec<u8>)>)`:  (模块名, 目标文件字节)
 pub fn compile_project_to_object_bytes(
-    project: &Project,
+    project: &mut Project,
     vfs: &Vfs,
+    codegen_units: usize,
     opt_level: OptLevel,
+    target: &TargetConfig,
+    options: CodegenOptions,
+    cache: Option<&ObjectCache>,
 ) -> Result<Vec<(String, Vec<u8>)>> {
-    project
+    let keys = match cache {
+        Some(_) => {
+            let triple = TargetMachine::get_default_triple();
+            let triple = triple.as_str().to_string_lossy();
+            ObjectCache::object_keys(
+                project,
+                vfs,
+                codegen_units,
+                opt_level,
+                &triple,
+                target,
+                options,
+            )
+        }
+        None => HashMap::new(),
+    };
+    let mut objects: HashMap<FileID, Vec<Vec<u8>>> = match cache {
+        Some(cache) => keys
+            .iter()
+            .filter_map(|(file_id, key)| Some((*file_id, cache.load(*key)?)))
+            .collect(),
+        None => HashMap::new(),
+    };
+
+    let missing: Vec<FileID> = project
+        .metadata
+        .keys()
+        .filter(|file_id| !project.modules.contains_key(file_id) && !objects.contains_key(file_id))
+        .copied()
+        .collect();
+    project.materialize(vfs, &missing);
+
+    let compiled = project
         .modules
         .par_iter()
+        .filter(|(file_id, _)| !objects.contains_key(file_id))
         .map(|(file_id, module)| {
-            let module_name = vfs
-                .get_file_by_file_id(file_id)
-                .and_then(|file| {
-                    std::path::Path::new(&file.path)
-                        .file_stem()
-                        .and_then(|s| s.to_str())
-                        .map(|s| s.to_string())
-                })
-                .unwrap_or_else(|| "unknown".to_string());
-
             let object_bytes = compile_to_object_bytes(
-                &module_name,
+                &module_name(vfs, file_id),
                 module.green_tree.clone(),
                 module,
+                codegen_units,
                 opt_level,
+                target,
+                options,
             )?;
 
-            Ok((module_name, object_bytes))
+            if let Some(cache) = cache
+                && let Some(key) = keys.get(file_id)
+            {
+                cache.store(*key, &object_bytes);
+            }
+
+            Ok((*file_id, object_bytes))
+        })
+        .collect::<Result<Vec<_>>>()?;
+    objects.extend(compiled);
+
+    Ok(objects
+        .into_iter()
+        .flat_map(|(file_id, units)| {
+            let module_name = module_name(vfs, &file_id);
+            let count = units.len();
+            units
+                .into_iter()
+                .enumerate()
+                .map(move |(i, object_bytes)| match count {
+                    1 => (module_name.clone(), object_bytes),
+                    _ => (format!("{}.cgu{}", module_name, i), object_bytes),
+                })
+        })
+        .collect())
+}
+
+/// 模块名：源文件名去掉扩展名
+fn module_name(vfs: &Vfs, file_id: &FileID) -> String {
+    vfs.get_file_by_file_id(file_id)
+        .and_then(|file| {
+            std::path::Path::new(&file.path)
+                .file_stem()
+                .and_then(|s| s.to_str())
+                .map(|s| s.to_string())
         })
-        .collect::<Result<Vec<_>>>()
+        .unwrap_or_else(|| "unknown".to_string())
+}
+
+/// 取得当前线程缓存的目标机器，没有时创建
+fn target_machine(opt_level: OptLevel, target: &TargetConfig) -> Result<Rc<TargetMachine>> {
+    TARGET_MACHINES.with(|machines| {
+        let key = (opt_level, target.clone());
+        if let Some(machine) = machines.borrow().get(&key) {
+            return Ok(Rc::clone(machine));
+        }
+        let machine = Rc::new(create_target_machine(opt_level, target)?);
+        machines.borrow_mut().insert(key, Rc::clone(&machine));
+        Ok(machine)
+    })
 }
 
 /// 创建目标机器
-/// 初始化 LLVM 目标并创建目标机器实例
-fn create_target_machine(opt_level: OptLevel) -> Result<TargetMachine> {
-    Target::initialize_all(&InitializationConfig::default());
+/// 初始化 LLVM 目标（每个进程只初始化一次）并创建目标机器实例
+fn create_target_machine(opt_level: OptLevel, target: &TargetConfig) -> Result<TargetMachine> {
+    static INITIALIZE: Once = Once::new();
+    INITIALIZE.call_once(|| Target::initialize_all(&InitializationConfig::default()));
+
     let triple = inkwell::targets::TargetMachine::get_default_triple();
-    let target =
+    let llvm_target =
         Target::from_triple(&triple).map_err(|e| CodegenError::TargetMachine(e.to_string()))?;
 
-    target
+    llvm_target
         .create_target_machine(
             &triple,
-            "generic",
-            "",
+            &target.cpu,
+            &target.features,
             opt_level.into(),
             RelocMode::PIC,
             CodeModel::Default,
@@ -154,44 +588,36 @@ fn create_target_machine(opt_level: OptLevel) -> Result<TargetMachine> {
 }
 
 /// 运行 LLVM IR 优化 pass
-/// 根据优化等级运行相应的优化 pass pipeline
+/// 根据优化等级运行相应的优化 pass pipeline，开启 PGO 时先插桩或读取剖析数据
 fn run_optimization_passes(
     module: &inkwell::module::Module,
     machine: &TargetMachine,
     opt_level: OptLevel,
 ) -> Result<()> {
-    // None 不运行任何优化
-    if matches!(opt_level, OptLevel::None) {
+    // 构建 pass pipeline 字符串
+    // LLVM 的新 Pass Manager 使用 "default<OX>" 格式来指定标准优化等级，None 不运行标准优化
+    let default = match opt_level {
+        OptLevel::None => None,
+        OptLevel::Less => Some("default<O1>"),
+        OptLevel::Default => Some("default<O2>"),
+        OptLevel::Aggressive => Some("default<O3>"),
+    };
+    let passes: Vec<_> = [pgo::passes(), default].into_iter().flatten().collect();
+    if passes.is_empty() {
         return Ok(());
     }
 
     // 创建 PassBuilderOptions
     let options = PassBuilderOptions::create();
-
-    // 根据优化等级设置选项
-    match opt_level {
-        OptLevel::None => {
-            unreachable!()
-        }
-        OptLevel::Less | OptLevel::Default | OptLevel::Aggressive => {
-            // 启用循环向量化和循环展开
-            options.set_loop_vectorization(true);
-            options.set_loop_unrolling(true);
-        }
+    if default.is_some() {
+        // 启用循环向量化和循环展开
+        options.set_loop_vectorization(true);
+        options.set_loop_unrolling(true);
     }
 
-    // 构建 pass pipeline 字符串
-    // LLVM 的新 Pass Manager 使用 "default<OX>" 格式来指定标准优化等级
-    let passes = match opt_level {
-        OptLevel::None => "default<O0>",
-        OptLevel::Less => "default<O1>",
-        OptLevel::Default => "default<O2>",
-        OptLevel::Aggressive => "default<O3>",
-    };
-
     // 运行优化 pass
     module
-        .run_passes(passes, machine, options)
+        .run_passes(&passes.join(","), machine, options)
         .map_err(|e| CodegenError::LlvmOptimization(e.to_string()))?;
 
     Ok(())
@@ -22,6 +22,9 @@ pub enum CompilerError {
 
     #[error("link failed: {0}")]
     Link(String),
+
+    #[error("invalid PGO configuration: {0}")]
+    Pgo(String),
 }
 
 impl CompilerError {
@@ -32,7 +35,7 @@ impl CompilerError {
                 for (file_id, errors) in semantic_errors {
                     if let Some(file) = vfs.get_file_by_file_id(&file_id) {
                         let source =
-                            NamedSource::new(file.path.to_string_lossy(), file.text.clone());
+                            NamedSource::new(file.path.to_string_lossy(), file.text.to_string());
                         for error in errors {
                             let report =
                                 miette::Report::new(error).with_source_code(source.clone());
@@ -1,17 +1,22 @@
 use std::fs;
-use std::path::Path;
+use std::hash::{BuildHasher, Hasher, RandomState};
+use std::path::{Path, PathBuf};
+use std::process::Command;
+use std::sync::atomic::{AtomicUsize, Ordering};
 
 use crate::error::{CompilerError, Result};
 
 /// 链接多个目标文件生成可执行文件
 ///
-/// 将多个目标文件字节数据写入临时文件，然后使用 clang 链接运行时库生成可执行文件
+/// 目标文件写入进程独占的临时目录，通过响应文件传给 clang 链接运行时库，
+/// 多个编译器进程可以同时向同一个输出目录链接。airyc 的运行时静态库放在所有目标文件之后，
+/// 只链接程序用到的部分
 ///
 /// # 参数
 /// - `object_files`: (模块名, 目标文件字节) 的列表
 /// - `output_dir`: 输出目录
 /// - `output_name`: 输出可执行文件名称
-/// - `runtime_path`: 运行时库路径
+/// - `flags`: 额外传给 clang 的参数
 ///
 /// # 返回
 /// - `Ok(())`: 链接成功
@@ -20,26 +25,66 @@ pub fn link_multiple_objects(
     object_files: &[(String, Vec<u8>)],
     output_dir: &Path,
     output_name: &str,
+    flags: &[&str],
 ) -> Result<()> {
-    let mut object_paths = Vec::new();
+    let temp_dir = TempDir::new()?;
+    let mut object_paths = temp_dir.write_objects(object_files)?;
+    object_paths.push(temp_dir.write_runtime()?);
+    let response_file = temp_dir.write_response_file(&object_paths)?;
 
-    // 写入所有目标文件
-    for (module_name, object_bytes) in object_files {
-        let object_path = output_dir.join(format!("{}.o", module_name));
-        fs::write(&object_path, object_bytes)?;
-        object_paths.push(object_path);
+    run_clang(flags, &response_file, &output_dir.join(output_name))
+}
+
+/// 把多个目标文件合并为单个可重定位目标文件（`-r` 链接）
+///
+/// 只有一个目标文件时直接写出，不调用链接器
+pub fn link_relocatable(object_files: &[(String, Vec<u8>)], output_path: &Path) -> Result<()> {
+    if let [(_, object_bytes)] = object_files {
+        fs::write(output_path, object_bytes)?;
+        return Ok(());
     }
 
-    let output_path = output_dir.join(output_name);
+    let temp_dir = TempDir::new()?;
+    let object_paths = temp_dir.write_objects(object_files)?;
+    let response_file = temp_dir.write_response_file(&object_paths)?;
+
+    run_clang(&["-r", "-nostdlib"], &response_file, output_path)
+}
+
+/// 把多个目标文件打包为静态库
+///
+/// 调用 `llvm-ar`（找不到时使用系统的 `ar`）生成归档和符号索引，支持 LLVM 能生成的所有
+/// 目标文件格式
+pub fn write_static_archive(object_files: &[(String, Vec<u8>)], output_path: &Path) -> Result<()> {
+    let temp_dir = TempDir::new()?;
+    let object_paths = temp_dir.write_objects(object_files)?;
+    let _ = fs::remove_file(output_path);
 
-    // 使用 clang 链接所有目标文件
-    let mut cmd = std::process::Command::new("clang");
-    for object_path in &object_paths {
-        cmd.arg(object_path);
+    let run_ar = |program: &str| {
+        Command::new(program)
+            .arg("rcs")
+            .arg(output_path)
+            .args(&object_paths)
+            .output()
+    };
+    let output = match run_ar("llvm-ar") {
+        Err(e) if e.kind() == std::io::ErrorKind::NotFound => run_ar("ar"),
+        output => output,
+    }
+    .map_err(|e| CompilerError::Link(e.to_string()))?;
+    if !output.status.success() {
+        let std_err = String::from_utf8_lossy(&output.stderr);
+        return Err(CompilerError::Link(std_err.into_owned()));
     }
-    cmd.arg("-o").arg(&output_path);
+    Ok(())
+}
 
-    let output = cmd
+fn run_clang(flags: &[&str], response_file: &Path, output_path: &Path) -> Result<()> {
+    let output = Command::new("clang")
+        .args(flags)
+        .arg(format!("@{}", response_file.display()))
+        .arg("-o")
+        .arg(output_path)
         .output()
         .map_err(|e| CompilerError::Link(e.to_string()))?;
 
@@ -48,10 +93,83 @@ pub fn link_multiple_objects(
         return Err(CompilerError::Link(std_err.into_owned()));
     }
 
-    // 删除临时目标文件
-    for object_path in &object_paths {
-        let _ = fs::remove_file(object_path);
+    Ok(())
+}
+
+/// 归档成员名，加上序号避免不同目录下的同名模块冲突
+fn member_name(index: usize, module_name: &str) -> String {
+    format!("{}-{}.o", index, module_name)
+}
+
+/// 当前进程独占的临时目录，析构时删除
+///
+/// 目录以独占方式创建，权限为 0700，名字带随机部分：其他用户不能预先创建或替换它并注入目标文件
+struct TempDir(PathBuf);
+
+impl TempDir {
+    fn new() -> Result<Self> {
+        const ATTEMPTS: usize = 16;
+        static COUNTER: AtomicUsize = AtomicUsize::new(0);
+
+        let mut builder = fs::DirBuilder::new();
+        #[cfg(unix)]
+        std::os::unix::fs::DirBuilderExt::mode(&mut builder, 0o700);
+
+        let mut last_error = None;
+        for _ in 0..ATTEMPTS {
+            let random = RandomState::new().build_hasher().finish();
+            let dir = std::env::temp_dir().join(format!(
+                "airyc-{}-{}-{:016x}",
+                std::process::id(),
+                COUNTER.fetch_add(1, Ordering::Relaxed),
+                random
+            ));
+            // 不复用已经存在的目录，名字冲突时换一个名字重试
+            match builder.create(&dir) {
+                Ok(()) => return Ok(Self(dir)),
+                Err(e) if e.kind() == std::io::ErrorKind::AlreadyExists => last_error = Some(e),
+                Err(e) => return Err(e.into()),
+            }
+        }
+        Err(last_error.unwrap().into())
     }
 
-    Ok(())
+    fn write_objects(&self, object_files: &[(String, Vec<u8>)]) -> Result<Vec<PathBuf>> {
+        object_files
+            .iter()
+            .enumerate()
+            .map(|(i, (module_name, object_bytes))| {
+                let object_path = self.0.join(member_name(i, module_name));
+                fs::write(&object_path, object_bytes)?;
+                Ok(object_path)
+            })
+            .collect()
+    }
+
+    fn write_runtime(&self) -> Result<PathBuf> {
+        let runtime_path = self.0.join(runtime::ARCHIVE_NAME);
+        fs::write(&runtime_path, runtime::ARCHIVE)?;
+        Ok(runtime_path)
+    }
+
+    /// 写入 clang 的响应文件，避免目标文件很多时命令行过长
+    fn write_response_file(&self, object_paths: &[PathBuf]) -> Result<PathBuf> {
+        let mut content = String::new();
+        for object_path in object_paths {
+            let escaped = object_path
+                .to_string_lossy()
+                .replace('\\', "\\\\")
+                .replace('"', "\\\"");
+            content.push_str(&format!("\"{}\"\n", escaped));
+        }
+        let response_file = self.0.join("objects.rsp");
+        fs::write(&response_file, content)?;
+        Ok(response_file)
+    }
+}
+
+impl Drop for TempDir {
+    fn drop(&mut self) {
+        let _ = fs::remove_dir_all(&self.0);
+    }
 }
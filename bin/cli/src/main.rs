@@ -1,21 +1,61 @@
 mod analyzing;
+mod cache;
 mod cli;
 mod compiling;
 mod error;
 mod linking;
+mod object_cache;
+mod pgo;
+mod profiling;
 
 use std::fs;
 
 use clap::Parser;
 use cli::{Args, EmitTarget};
+use codegen::llvm_ir::CodegenOptions;
 use rayon::prelude::*;
 use syntax::SyntaxNode;
+use tools::profile;
 use vfs::Vfs;
 
-use crate::compiling::{compile_project_to_object_bytes, compile_to_ir_file};
+use crate::cache::AnalysisCache;
+use crate::compiling::{
+    TargetConfig, compile_project_lto_to_ir_file, compile_project_lto_to_object_bytes,
+    compile_project_to_object_bytes, compile_to_ir_file, run_project_jit,
+};
+use crate::object_cache::ObjectCache;
+use crate::pgo::Pgo;
 
 fn main() {
     let args = Args::parse();
+    if args.time_passes || args.stats || args.trace.is_some() {
+        profile::enable();
+    }
+
+    let exit_code = compile(&args);
+
+    let events = profile::take_events();
+    if args.time_passes {
+        profiling::print_time_passes(&events);
+    }
+    if args.stats {
+        profiling::print_stats();
+    }
+    if let Some(trace) = &args.trace
+        && let Err(e) = profiling::write_chrome_trace(&events, trace)
+    {
+        eprintln!("Error: failed to write trace: {}", e);
+        std::process::exit(1);
+    }
+    if exit_code != 0 {
+        std::process::exit(exit_code);
+    }
+}
+
+/// 按命令行参数编译，出错时直接退出进程
+///
+/// 返回进程的退出码，`--emit run` 时为 `main` 的返回值
+fn compile(args: &Args) -> i32 {
     let vfs = Vfs::default();
 
     // 检查是否有输入文件
@@ -44,31 +84,102 @@ fn main() {
         let (green_node, _) = parser.parse();
 
         println!("{:#?}", SyntaxNode::new_root(green_node));
-        return;
+        return 0;
     }
 
-    // 语义分析
-    let project = match analyzing::analyze_project(&args.input_path, &vfs) {
-        Ok(project) => project,
+    let (cache, object_cache) = match args
+        .cache_dir
+        .as_ref()
+        .map(|dir| {
+            Ok::<_, std::io::Error>((
+                AnalysisCache::new(dir.clone())?,
+                ObjectCache::new(dir.join("objects"))?,
+            ))
+        })
+        .transpose()
+    {
+        Ok(caches) => caches.unzip(),
         Err(e) => {
-            e.report(vfs);
+            eprintln!("Error: {}", e);
             std::process::exit(1);
         }
     };
 
+    // 语义分析
+    // 输出 LLVM IR 和 LTO 需要所有模块的完整分析结果；生成可执行文件时，
+    // 没有命中目标文件缓存的模块会在代码生成前重新分析
+    let reuse_cache = match args.emit {
+        EmitTarget::Check => true,
+        EmitTarget::Exe | EmitTarget::Obj | EmitTarget::Lib => !args.lto,
+        EmitTarget::Ir | EmitTarget::Run | EmitTarget::Ast => false,
+    };
+    let span = profile::span("analyze");
+    let mut project =
+        match analyzing::analyze_project(&args.input_path, &vfs, cache.as_ref(), reuse_cache) {
+            Ok(project) => project,
+            Err(e) => {
+                e.report(vfs);
+                std::process::exit(1);
+            }
+        };
+    drop(span);
+
     if args.emit == EmitTarget::Check {
         if args.input_path.len() > 1 {
             println!("✓ All files checked successfully");
         } else {
             println!("✓ File checked successfully");
         }
-        return;
+        return 0;
     }
 
     let opt_level = args.opt_level;
+    let target = TargetConfig::new(&args.target_cpu, &args.target_features);
+
+    let pgo = if args.profile_generate {
+        Some(Pgo::Generate)
+    } else if let Some(profile) = &args.profile_use {
+        match Pgo::load_profile(profile) {
+            Ok(pgo) => Some(pgo),
+            Err(e) => {
+                eprintln!("Error: failed to read profile {}: {}", profile.display(), e);
+                std::process::exit(1);
+            }
+        }
+    } else {
+        None
+    };
+    if let Err(e) = pgo::configure(pgo) {
+        eprintln!("Error: {}", e);
+        std::process::exit(1);
+    }
+    let options = CodegenOptions {
+        strict_aliasing: args.strict_aliasing,
+        no_signed_overflow: args.no_signed_overflow,
+    };
+
+    // 确定输出文件名（使用第一个文件的名称）
+    let output_name = args.input_path[0]
+        .file_stem()
+        .and_then(|s| s.to_str())
+        .unwrap_or("a.out");
 
     // 代码生成
     match args.emit {
+        EmitTarget::Ir if args.lto => {
+            let output_path = args.output_dir.join(format!("{}.ll", output_name));
+            if let Err(e) = compile_project_lto_to_ir_file(
+                &project,
+                &vfs,
+                opt_level,
+                &target,
+                options,
+                &output_path,
+            ) {
+                eprintln!("Error: {}", e);
+                std::process::exit(1);
+            }
+        }
         EmitTarget::Ir => {
             // 为每个模块生成 IR 文件（并行）
             if let Err(e) = project
@@ -91,6 +202,8 @@ fn main() {
                         module.green_tree.clone(),
                         module,
                         opt_level,
+                        &target,
+                        options,
                         &output_path,
                     )
                 })
@@ -100,30 +213,81 @@ fn main() {
                 std::process::exit(1);
             }
         }
-        EmitTarget::Exe => {
-            // 生成所有模块的目标文件
-            let object_files = match compile_project_to_object_bytes(&project, &vfs, opt_level) {
+        EmitTarget::Exe | EmitTarget::Obj | EmitTarget::Lib => {
+            // 生成所有模块的目标文件，LTO 模式下只有一个
+            // 目标文件和静态库的符号需要被外部使用，不能改为内部链接
+            let span = profile::span("codegen");
+            let object_files = if args.lto {
+                let internalize = args.emit == EmitTarget::Exe;
+                compile_project_lto_to_object_bytes(
+                    &project,
+                    &vfs,
+                    opt_level,
+                    &target,
+                    options,
+                    internalize,
+                )
+                .map(|bytes| vec![(output_name.to_string(), bytes)])
+            } else {
+                compile_project_to_object_bytes(
+                    &mut project,
+                    &vfs,
+                    args.codegen_units as usize,
+                    opt_level,
+                    &target,
+                    options,
+                    object_cache.as_ref(),
+                )
+            };
+            let object_files = match object_files {
                 Ok(v) => v,
                 Err(e) => {
                     eprintln!("Error: {}", e);
                     std::process::exit(1);
                 }
             };
+            drop(span);
 
-            // 确定输出文件名（使用第一个文件的名称）
-            let output_name = args.input_path[0]
-                .file_stem()
-                .and_then(|s| s.to_str())
-                .unwrap_or("a.out");
-
-            // 链接所有目标文件
-            if let Err(e) =
-                linking::link_multiple_objects(&object_files, &args.output_dir, output_name)
-            {
+            let _span = profile::span("link");
+            let result = match args.emit {
+                EmitTarget::Obj => {
+                    let output_path = args.output_dir.join(format!("{}.o", output_name));
+                    linking::link_relocatable(&object_files, &output_path)
+                }
+                EmitTarget::Lib => {
+                    let output_path = args.output_dir.join(format!("lib{}.a", output_name));
+                    linking::write_static_archive(&object_files, &output_path)
+                }
+                // 链接所有目标文件，插桩的程序需要 clang 的剖析运行时
+                _ => {
+                    let flags: &[&str] = if args.profile_generate {
+                        &["-fprofile-generate"]
+                    } else {
+                        &[]
+                    };
+                    linking::link_multiple_objects(
+                        &object_files,
+                        &args.output_dir,
+                        output_name,
+                        flags,
+                    )
+                }
+            };
+            if let Err(e) = result {
                 eprintln!("Error: {}", e);
                 std::process::exit(1);
             }
         }
+        EmitTarget::Run => {
+            return match run_project_jit(&project, &vfs, opt_level, &target, options) {
+                Ok(exit_code) => exit_code,
+                Err(e) => {
+                    eprintln!("Error: {}", e);
+                    std::process::exit(1);
+                }
+            };
+        }
         EmitTarget::Ast | EmitTarget::Check => {}
     };
+    0
 }
@@ -0,0 +1,134 @@
+//! 目标文件缓存
+//!
+//! 以编译器和 LLVM 版本、模块源码、导入闭包中所有模块的接口指纹、代码生成单元数、代码生成选项、
+//! 优化级别、PGO 模式和目标机器配置的 SHA-256 为键保存模块的目标文件，键相同的模块直接复用上次的编译结果，跳过 LLVM 代码生成和优化
+
+use std::{collections::HashMap, fs, hash::Hash, path::PathBuf};
+
+use analyzer::project::Project;
+use codegen::llvm_ir::CodegenOptions;
+use vfs::{FileID, Vfs};
+
+use crate::{
+    cache::{COMPILER_VERSION, ContentHash, ContentHasher, fingerprints},
+    cli::OptLevel,
+    compiling::TargetConfig,
+    pgo::{self, Pgo},
+};
+
+/// 目标文件缓存目录
+pub struct ObjectCache {
+    dir: PathBuf,
+}
+
+impl ObjectCache {
+    pub fn new(dir: PathBuf) -> std::io::Result<Self> {
+        fs::create_dir_all(&dir)?;
+        Ok(Self { dir })
+    }
+
+    /// 计算所有模块的缓存键
+    pub fn object_keys(
+        project: &Project,
+        vfs: &Vfs,
+        codegen_units: usize,
+        opt_level: OptLevel,
+        triple: &str,
+        target: &TargetConfig,
+        options: CodegenOptions,
+    ) -> HashMap<FileID, ContentHash> {
+        let fingerprints = fingerprints(project, vfs);
+        let path_of = |file_id: &FileID| {
+            vfs.get_file_by_file_id(file_id)
+                .map(|file| file.path.clone())
+        };
+
+        project
+            .metadata
+            .keys()
+            .filter_map(|file_id| {
+                let file = vfs.get_file_by_file_id(file_id)?;
+                // 碰撞会链接错误的目标代码，使用 SHA-256，见 [`ContentHash`]
+                let mut hasher = ContentHasher::default();
+                COMPILER_VERSION.hash(&mut hasher);
+                inkwell::support::get_llvm_version().hash(&mut hasher);
+                triple.hash(&mut hasher);
+                target.hash(&mut hasher);
+                opt_level.hash(&mut hasher);
+                codegen_units.hash(&mut hasher);
+                options.hash(&mut hasher);
+                // 剖析数据只按内容参与哈希，不依赖 `Path` 的 `Hash` 实现
+                match pgo::current() {
+                    None => 0u8.hash(&mut hasher),
+                    Some(Pgo::Generate) => 1u8.hash(&mut hasher),
+                    Some(Pgo::Use { hash, .. }) => (2u8, hash).hash(&mut hasher),
+                }
+                file.path.as_os_str().as_encoded_bytes().hash(&mut hasher);
+                file.text.hash(&mut hasher);
+                drop(file);
+
+                // 按路径排序，与 FileID 的分配顺序无关
+                let mut imports = project
+                    .dependency
+                    .import_closure(*file_id)
+                    .iter()
+                    .map(|target| {
+                        let path = path_of(target)?;
+                        Some((
+                            path.into_os_string().into_encoded_bytes(),
+                            *fingerprints.get(target)?,
+                        ))
+                    })
+                    .collect::<Option<Vec<_>>>()?;
+                imports.sort();
+                imports.hash(&mut hasher);
+
+                Some((*file_id, hasher.digest()))
+            })
+            .collect()
+    }
+
+    /// 读取模块的目标文件，每个代码生成单元一个
+    pub fn load(&self, key: ContentHash) -> Option<Vec<Vec<u8>>> {
+        decode_objects(&fs::read(self.object_path(key)).ok()?)
+    }
+
+    /// 先写入临时文件再重命名，避免并发编译读到不完整的目标文件
+    pub fn store(&self, key: ContentHash, objects: &[Vec<u8>]) {
+        let object_path = self.object_path(key);
+        let temp_path = object_path.with_extension(format!("tmp{}", std::process::id()));
+        if let Err(e) = fs::write(&temp_path, encode_objects(objects))
+            .and_then(|_| fs::rename(&temp_path, &object_path))
+        {
+            eprintln!("Warning: failed to write object cache: {}", e);
+        }
+    }
+
+    fn object_path(&self, key: ContentHash) -> PathBuf {
+        self.dir.join(format!("{}.objs", key))
+    }
+}
+
+/// 缓存文件的格式：目标文件个数（u32 小端），之后依次是每个目标文件的长度（u64 小端）和内容
+fn encode_objects(objects: &[Vec<u8>]) -> Vec<u8> {
+    let len = 4 + objects.iter().map(|bytes| 8 + bytes.len()).sum::<usize>();
+    let mut data = Vec::with_capacity(len);
+    data.extend_from_slice(&(objects.len() as u32).to_le_bytes());
+    for bytes in objects {
+        data.extend_from_slice(&(bytes.len() as u64).to_le_bytes());
+        data.extend_from_slice(bytes);
+    }
+    data
+}
+
+/// 解析 [`encode_objects`] 的输出，格式错误时返回 `None`
+fn decode_objects(mut data: &[u8]) -> Option<Vec<Vec<u8>>> {
+    let count = u32::from_le_bytes(data.split_off(..4)?.try_into().ok()?);
+    let objects = (0..count)
+        .map(|_| {
+            let len = u64::from_le_bytes(data.split_off(..8)?.try_into().ok()?);
+            Some(data.split_off(..usize::try_from(len).ok()?)?.to_vec())
+        })
+        .collect::<Option<Vec<_>>>()?;
+    (data.is_empty() && !objects.is_empty()).then_some(objects)
+}
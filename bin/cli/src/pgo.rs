@@ -0,0 +1,79 @@
+//! 基于剖析数据的优化（PGO）
+//!
+//! `--profile-generate` 在优化前插入 IR 级别的计数器，程序运行时写出 `default.profraw`；
+//! 用 `llvm-profdata merge` 合并后通过 `--profile-use` 传回，优化 pass 按计数安排分支、
+//! 内联和代码布局。两次编译都在未优化的 IR 上插桩或读取计数，控制流图的校验和与优化级别无关
+
+use std::{
+    ffi::CString,
+    fs,
+    path::{Path, PathBuf},
+    sync::OnceLock,
+};
+
+use llvm_sys::support::LLVMParseCommandLineOptions;
+
+use crate::{
+    cache::{ContentHash, hash_of},
+    error::{CompilerError, Result},
+};
+
+/// 进程唯一的 PGO 模式，见 [`configure`]
+static PGO: OnceLock<Option<Pgo>> = OnceLock::new();
+
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub enum Pgo {
+    /// 插桩，链接时需要 clang 的剖析运行时
+    Generate,
+    /// 使用合并后的剖析数据，`hash` 是文件内容的哈希，作为目标文件缓存键的一部分
+    Use { path: PathBuf, hash: ContentHash },
+}
+
+impl Pgo {
+    pub fn load_profile(path: &Path) -> std::io::Result<Self> {
+        let data = fs::read(path)?;
+        Ok(Self::Use {
+            path: path.to_path_buf(),
+            hash: hash_of(&data),
+        })
+    }
+}
+
+/// 设置整个进程的 PGO 模式，在代码生成前调用一次，再次调用返回错误
+///
+/// LLVM 的 `pgo-instr-use` pass 不接受参数，C API 和 inkwell 也不提供设置剖析数据文件的
+/// 接口，文件名只能通过进程全局的 `cl::opt` 选项 `-pgo-test-profile-file` 传入。这个选项
+/// 每个进程只能解析一次，之后构造的每个 `pgo-instr-use` pass 都会读取它，所以 PGO 模式
+/// 也是进程全局的：只在这里设置，[`passes`] 和目标文件缓存的键都从 [`current`] 读取，
+/// 保证插入 `pgo-instr-use` 的模块使用的剖析数据就是缓存键中哈希的那一份
+pub fn configure(pgo: Option<Pgo>) -> Result<()> {
+    if PGO.get().is_some() {
+        return Err(CompilerError::Pgo("PGO is already configured".to_string()));
+    }
+    if let Some(Pgo::Use { path, .. }) = &pgo {
+        // `display` 会替换无法表示的字符，LLVM 会静默地找不到文件
+        let path = path.to_str().ok_or_else(|| {
+            CompilerError::Pgo(format!("profile path is not UTF-8: {}", path.display()))
+        })?;
+        let option = CString::new(format!("-pgo-test-profile-file={}", path)).map_err(|_| {
+            CompilerError::Pgo(format!("profile path contains a NUL byte: {}", path))
+        })?;
+        let argv = [c"airyc".as_ptr(), option.as_ptr()];
+        unsafe { LLVMParseCommandLineOptions(argv.len() as i32, argv.as_ptr(), c"".as_ptr()) };
+    }
+    PGO.set(pgo)
+        .map_err(|_| CompilerError::Pgo("PGO is already configured".to_string()))
+}
+
+/// 当前的 PGO 模式
+pub fn current() -> Option<&'static Pgo> {
+    PGO.get().and_then(Option::as_ref)
+}
+
+/// 在标准优化 pipeline 之前运行的 pass
+pub fn passes() -> Option<&'static str> {
+    match current()? {
+        Pgo::Generate => Some("pgo-instr-gen,instrprof"),
+        Pgo::Use { .. } => Some("pgo-instr-use"),
+    }
+}
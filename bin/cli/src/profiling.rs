@@ -0,0 +1,109 @@
+//! `--time-passes` / `--stats` / `--trace` 的输出
+
+use std::{fs, path::Path, time::Duration};
+
+use serde_json::json;
+use tools::profile::{self, Event};
+
+/// 打印各阶段和各模块的耗时
+pub fn print_time_passes(events: &[Event]) {
+    eprintln!("Time passes:");
+    for (name, duration) in group_by(events.iter().filter(|e| e.detail.is_none()), |e| e.name) {
+        eprintln!("  {:<24} {:>10}", name, format_duration(duration));
+    }
+    eprintln!(
+        "  {:<24} {:>10}",
+        "total",
+        format_duration(profile::elapsed())
+    );
+
+    // 并行阶段中各模块的耗时之和可能超过阶段的墙钟时间
+    let module_events: Vec<_> = events.iter().filter(|e| e.detail.is_some()).collect();
+    if module_events.is_empty() {
+        return;
+    }
+    eprintln!("\nPer module:");
+    let modules = group_by(module_events.iter().copied(), |e| e.detail.as_deref());
+    for (module, total) in modules {
+        eprintln!(
+            "  {:<24} {:>10}",
+            module.unwrap_or_default(),
+            format_duration(total)
+        );
+        let passes = module_events
+            .iter()
+            .copied()
+            .filter(|e| e.detail.as_deref() == module);
+        for (name, duration) in group_by(passes, |e| e.name) {
+            eprintln!("    {:<22} {:>10}", name, format_duration(duration));
+        }
+    }
+}
+
+/// 打印计数器和峰值内存
+pub fn print_stats() {
+    eprintln!("Stats:");
+    for (name, value) in profile::counters() {
+        eprintln!("  {:<24} {:>10}", name, value);
+    }
+    match peak_rss() {
+        Some(bytes) => eprintln!(
+            "  {:<24} {:>7.1}MiB",
+            "peak RSS",
+            bytes as f64 / (1024.0 * 1024.0)
+        ),
+        None => eprintln!("  {:<24} {:>10}", "peak RSS", "unknown"),
+    }
+}
+
+/// 写出 Chrome trace 格式（`chrome://tracing`、Perfetto）的时间线
+pub fn write_chrome_trace(events: &[Event], path: &Path) -> std::io::Result<()> {
+    let trace_events: Vec<_> = events
+        .iter()
+        .map(|event| {
+            let mut value = json!({
+                "name": event.name,
+                "cat": "airyc",
+                "ph": "X",
+                "ts": event.start.as_secs_f64() * 1e6,
+                "dur": event.duration.as_secs_f64() * 1e6,
+                "pid": std::process::id(),
+                "tid": event.thread,
+            });
+            if let Some(detail) = &event.detail {
+                value["args"] = json!({ "module": detail });
+            }
+            value
+        })
+        .collect();
+    let trace = json!({ "traceEvents": trace_events, "displayTimeUnit": "ms" });
+    fs::write(path, serde_json::to_string(&trace)?)
+}
+
+/// 进程的峰值常驻内存，只在 Linux 上可用
+fn peak_rss() -> Option<u64> {
+    let status = fs::read_to_string("/proc/self/status").ok()?;
+    let line = status.lines().find(|line| line.starts_with("VmHWM:"))?;
+    let kib: u64 = line.split_whitespace().nth(1)?.parse().ok()?;
+    Some(kib * 1024)
+}
+
+/// 按 `key` 分组累加耗时，保持每组第一次出现的顺序
+fn group_by<'a, K: PartialEq>(
+    events: impl Iterator<Item = &'a Event>,
+    key: impl Fn(&'a Event) -> K,
+) -> Vec<(K, Duration)> {
+    let mut groups: Vec<(K, Duration)> = Vec::new();
+    for event in events {
+        let k = key(event);
+        match groups.iter_mut().find(|(group, _)| *group == k) {
+            Some((_, duration)) => *duration += event.duration,
+            None => groups.push((k, event.duration)),
+        }
+    }
+    groups
+}
+
+fn format_duration(duration: Duration) -> String {
+    format!("{:.2}ms", duration.as_secs_f64() * 1000.0)
+}
@@ -1,45 +1,80 @@
+use std::collections::HashMap;
 use std::path::PathBuf;
 use std::sync::Arc;
 use std::sync::atomic::{AtomicU64, Ordering};
 
-use analyzer::checker::RecursiveTypeChecker;
-use analyzer::project::Project;
 use dashmap::DashMap;
-use parking_lot::RwLock;
+use parking_lot::Mutex;
 use tower_lsp_server::jsonrpc::Result;
 use tower_lsp_server::ls_types::*;
 use tower_lsp_server::{Client, LanguageServer};
 use vfs::{FileID, Vfs};
 
+use crate::analysis::{Analysis, EditHint, Snapshot};
 use crate::lsp_features;
+use crate::lsp_features::diagnostics::DiagnosticCache;
+use crate::utils::position_trans::{TextMap, ls_range_to_text_range};
 
 /// Airyc Language Server
 #[derive(Debug)]
 pub(crate) struct Backend {
-    /// LSP 客户端连接
-    client: Client,
-    /// 项目管理器（使用 RwLock 实现内部可变性）
-    project: RwLock<Project>,
-    /// virtul file system
-    vfs: Vfs,
+    /// 后台分析线程，请求处理读取它发布的快照
+    analysis: Analysis,
+    /// virtul file system，总是最新的文件内容
+    vfs: Arc<Vfs>,
     /// URI 到 FileID 的映射
     uri_to_file_id: DashMap<Uri, FileID>,
-    /// FileID 到 URI 的反向映射
-    file_id_to_uri: DashMap<FileID, Uri>,
-    /// 防抖版本号，用于取消过期的诊断任务
-    debounce_version: Arc<AtomicU64>,
+    /// FileID 到 URI 的反向映射，与分析线程共享
+    file_id_to_uri: Arc<DashMap<FileID, Uri>>,
 }
 
 impl Backend {
     pub fn new(client: Client) -> Self {
-        let project = Project::new().with_checker::<RecursiveTypeChecker>();
+        let vfs = Arc::new(Vfs::default());
+        let file_id_to_uri = Arc::new(DashMap::new());
+
+        let runtime = tokio::runtime::Handle::current();
+        let uris = Arc::clone(&file_id_to_uri);
+        // 最近一次发布的快照序号，用于取消过期的延迟诊断
+        let latest = Arc::new(AtomicU64::new(0));
+        // 已计算但还没有发送的诊断，被取消的发布留给下一次
+        let pending = Arc::new(Mutex::new(HashMap::new()));
+        let mut cache = DiagnosticCache::default();
+        let analysis = Analysis::new(Arc::clone(&vfs), move |snapshot, debounce| {
+            let revision = snapshot.revision;
+            latest.store(revision, Ordering::SeqCst);
+            let diagnostics = Self::collect_diagnostics(snapshot, &uris, &mut cache);
+            // 这一轮没有新的诊断时，之前被取消的发布留下的诊断也要发送
+            {
+                let mut pending = pending.lock();
+                pending.extend(diagnostics);
+                if pending.is_empty() {
+                    return;
+                }
+            }
+
+            let client = client.clone();
+            let latest = Arc::clone(&latest);
+            let pending = Arc::clone(&pending);
+            runtime.spawn(async move {
+                if debounce {
+                    tokio::time::sleep(tokio::time::Duration::from_millis(500)).await;
+                    if latest.load(Ordering::SeqCst) != revision {
+                        return;
+                    }
+                }
+                let diagnostics = std::mem::take(&mut *pending.lock());
+                for (uri, diagnostics) in diagnostics {
+                    client.publish_diagnostics(uri, diagnostics, None).await;
+                }
+            });
+        });
+
         Self {
-            client,
-            project: RwLock::new(project),
+            analysis,
             uri_to_file_id: DashMap::new(),
-            file_id_to_uri: DashMap::new(),
-            vfs: Default::default(),
-            debounce_version: Arc::new(AtomicU64::new(0)),
+            file_id_to_uri,
+            vfs,
         }
     }
 
@@ -59,70 +94,110 @@ impl Backend {
         F: FnOnce(&analyzer::module::Module, &tools::LineIndex) -> R,
     {
         let file_id = self.get_file_id(uri)?;
-        let project = self.project.read();
+        let snapshot = self.analysis.snapshot();
 
-        let module = project.modules.get(&file_id)?;
-        let file = self.vfs.get_file_by_file_id(&file_id)?;
+        let module = snapshot.project.modules.get(&file_id)?;
+        let file = snapshot.vfs.get_file_by_file_id(&file_id)?;
         let line_index = &file.line_index;
 
         Some(f(module, line_index))
     }
 
-    /// 重新构建整个项目
-    fn rebuild_project(&self) {
-        let mut project = self.project.write();
-        project.full_initialize(&self.vfs);
+    /// 把快照中的位置换算到最新的文本中，快照可能还没有包含最后几次输入
+    fn live_locations<'a>(
+        &self,
+        snapshot: &Snapshot,
+        locations: impl IntoIterator<Item = &'a mut Location>,
+    ) {
+        let locations: Vec<_> = locations
+            .into_iter()
+            .filter_map(|location| Some((self.get_file_id(&location.uri)?, location)))
+            .collect();
+        let files: HashMap<_, _> = locations
+            .iter()
+            .filter_map(|(file_id, _)| Some((*file_id, self.vfs.get_file_by_file_id(file_id)?)))
+            .collect();
+        let maps: HashMap<_, _> = files
+            .iter()
+            .filter_map(|(file_id, file)| {
+                let snapshot_file = snapshot.vfs.get_file_by_file_id(file_id)?;
+                Some((*file_id, TextMap::new(snapshot_file, file)))
+            })
+            .collect();
+        for (file_id, location) in locations {
+            if let Some(map) = maps.get(&file_id) {
+                location.range = map.range(&location.range);
+            }
+        }
     }
 
-    /// 发布所有文件的诊断信息
-    async fn publish_all_diagnostics(&self) {
-        // 收集所有需要发布的诊断信息
-        let diagnostics_to_publish = {
-            let project = self.project.read();
-
-            let mut result = Vec::new();
-
-            // 遍历 uri_to_file_id 映射
-            for entry in self.uri_to_file_id.iter() {
-                let uri = entry.key().clone();
-                let file_id = *entry.value();
-
-                if let Some(module) = project.modules.get(&file_id)
-                    && let Some(file) = self.vfs.get_file_by_file_id(&file_id)
-                {
-                    let diagnostics = lsp_features::diagnostics::compute_diagnostics(
-                        &module.semantic_errors,
-                        &file.line_index,
-                    );
-
-                    result.push((uri, diagnostics));
+    /// 依次把 LSP 的增量修改应用到 VFS，返回合并后的编辑
+    fn apply_content_changes(
+        &self,
+        file_id: FileID,
+        changes: Vec<TextDocumentContentChangeEvent>,
+    ) -> Option<tools::TextEdit> {
+        let mut edits = Vec::with_capacity(changes.len());
+        for change in changes {
+            let edit = {
+                let file = self.vfs.get_file_by_file_id(&file_id)?;
+                match change.range {
+                    Some(range) => tools::TextEdit::new(
+                        ls_range_to_text_range(&file.line_index, &range),
+                        change.text,
+                    ),
+                    // 没有范围时为全量文本
+                    None => match tools::TextEdit::diff(&file.text, &change.text) {
+                        Some(edit) => edit,
+                        None => continue,
+                    },
                 }
+            };
+
+            if !self.vfs.apply_edit(&file_id, &edit) {
+                // 范围非法，退化为没有编辑信息的全量更新
+                return None;
             }
+            edits.push(edit);
+        }
 
-            result
-        }; // project 锁在这里释放
+        let file = self.vfs.get_file_by_file_id(&file_id)?;
+        tools::TextEdit::compose(&edits, &file.text)
+    }
 
-        // 发布所有诊断信息
-        for (uri, diagnostics) in diagnostics_to_publish {
-            self.client
-                .publish_diagnostics(uri, diagnostics, None)
-                .await;
+    /// 计算快照中诊断有变化的文件的诊断信息
+    fn collect_diagnostics(
+        snapshot: &Snapshot,
+        file_id_to_uri: &DashMap<FileID, Uri>,
+        cache: &mut DiagnosticCache,
+    ) -> Vec<(Uri, Vec<Diagnostic>)> {
+        let mut result = Vec::new();
+
+        // 遍历 file_id_to_uri 映射
+        for entry in file_id_to_uri.iter() {
+            let file_id = *entry.key();
+            let uri = entry.value().clone();
+
+            if let Some(module) = snapshot.project.modules.get(&file_id)
+                && let Some(file) = snapshot.vfs.get_file_by_file_id(&file_id)
+                && cache.changed(file_id, &file.text, &module.semantic_errors)
+            {
+                let diagnostics = lsp_features::diagnostics::compute_diagnostics(
+                    &module.semantic_errors,
+                    &file.line_index,
+                );
+
+                result.push((uri, diagnostics));
+            }
         }
+
+        result
     }
 
-    /// 扫描工作区目录下的所有 .airy 文件
+    /// 并行递归扫描工作区目录下的所有 .airy 文件，跳过 .gitignore 忽略的文件
     fn scan_workspace(&self, root_path: PathBuf) {
-        if let Ok(entries) = std::fs::read_dir(&root_path) {
-            for entry in entries.flatten() {
-                let path = entry.path();
-                if path.is_file()
-                    && path.extension().and_then(|s| s.to_str()) == Some("airy")
-                    && let Ok(text) = std::fs::read_to_string(&path)
-                {
-                    self.vfs.new_file(path, text);
-                }
-            }
-        }
+        let files = vfs::load::scan_dir(&root_path, "airy");
+        self.vfs.new_files(files);
     }
 }
 
@@ -151,9 +226,8 @@ impl LanguageServer for Backend {
                 }
             });
 
-            // 初始化项目
-            let mut project = self.project.write();
-            project.full_initialize(&self.vfs);
+            // 在后台初始化项目
+            self.analysis.file_changed(None, false);
         }
 
         Ok(InitializeResult {
@@ -165,7 +239,7 @@ impl LanguageServer for Backend {
                 text_document_sync: Some(TextDocumentSyncCapability::Options(
                     TextDocumentSyncOptions {
                         open_close: Some(true),
-                        change: Some(TextDocumentSyncKind::FULL),
+                        change: Some(TextDocumentSyncKind::INCREMENTAL),
                         save: Some(TextDocumentSyncSaveOptions::SaveOptions(SaveOptions {
                             include_text: Some(false),
                         })),
@@ -192,23 +266,22 @@ impl LanguageServer for Backend {
                 hover_provider: Some(HoverProviderCapability::Simple(true)),
                 document_symbol_provider: Some(OneOf::Left(true)),
                 workspace_symbol_provider: Some(OneOf::Left(true)),
-                // completion_provider: Some(CompletionOptions {
-                //     trigger_characters: Some(vec![".".to_string(), "->".to_string()]),
-                //     all_commit_characters: None,
-                //     resolve_provider: Some(false),
-                //     work_done_progress_options: WorkDoneProgressOptions {
-                //         work_done_progress: None,
-                //     },
-                //     completion_item: None,
-                // }),
+                completion_provider: Some(CompletionOptions {
+                    trigger_characters: None,
+                    all_commit_characters: None,
+                    resolve_provider: Some(false),
+                    work_done_progress_options: WorkDoneProgressOptions {
+                        work_done_progress: None,
+                    },
+                    completion_item: None,
+                }),
                 ..Default::default()
             },
         })
     }
 
     async fn initialized(&self, _: InitializedParams) {
-        // 发布所有文件的诊断信息
-        self.publish_all_diagnostics().await;
+        // 诊断信息在分析完成后由分析线程发布
     }
 
     async fn shutdown(&self) -> Result<()> {
@@ -234,73 +307,50 @@ impl LanguageServer for Backend {
             let file_id = self.vfs.new_file(path, text);
             self.uri_to_file_id.insert(uri.clone(), file_id);
             self.file_id_to_uri.insert(file_id, uri.clone());
-        };
-
-        // 重新分析整个项目
-        self.rebuild_project();
+        }
 
-        // 发布诊断信息
-        self.publish_all_diagnostics().await;
+        // 增量更新项目（新文件会触发全量初始化），完成后发布诊断信息
+        self.analysis.file_changed(None, false);
     }
 
     async fn did_change(&self, params: DidChangeTextDocumentParams) {
         let uri = params.text_document.uri.clone();
 
-        let Some(change) = params.content_changes.into_iter().next() else {
-            return;
-        };
-
         let Some(file_id) = self.get_file_id(&uri) else {
             return;
         };
 
-        // 更新文件内容
-        self.vfs.update_file(&file_id, change.text);
-
-        // 重新分析整个项目
-        self.rebuild_project();
-
-        // 提取诊断数据
-        let Some(diagnostics) = (|| {
-            let project = self.project.read();
-            let module = project.modules.get(&file_id)?;
-            let file = self.vfs.get_file_by_file_id(&file_id)?;
-
-            // 计算诊断信息
-            Some(lsp_features::diagnostics::compute_diagnostics(
-                &module.semantic_errors,
-                &file.line_index,
-            ))
-        })() else {
-            return;
+        // 更新文件内容，得到合并后的编辑范围，用于增量重解析
+        let before = self
+            .vfs
+            .get_file_by_file_id(&file_id)
+            .map(|f| f.text.clone());
+        let edit = self.apply_content_changes(file_id, params.content_changes);
+        let after = self
+            .vfs
+            .get_file_by_file_id(&file_id)
+            .map(|f| f.text.clone());
+
+        let hint = match (edit, before, after) {
+            (Some(edit), Some(before), Some(after)) => Some(EditHint {
+                file_id,
+                before,
+                after,
+                edit,
+            }),
+            _ => None,
         };
 
-        let current_version = self.debounce_version.fetch_add(1, Ordering::SeqCst) + 1;
-
-        let debounce_version = Arc::clone(&self.debounce_version);
-        let client = self.client.clone();
-        let uri_clone = uri.clone();
-
-        tokio::spawn(async move {
-            // 等待 500ms
-            tokio::time::sleep(tokio::time::Duration::from_millis(500)).await;
-            if debounce_version.load(Ordering::SeqCst) == current_version {
-                client
-                    .publish_diagnostics(uri_clone, diagnostics, None)
-                    .await;
-            }
-        });
+        // 在后台增量更新项目，连续输入时诊断延迟发布
+        self.analysis.file_changed(hint, true);
     }
 
     async fn did_save(&self, params: DidSaveTextDocumentParams) {
         let uri = params.text_document.uri;
 
         if self.get_file_id(&uri).is_some() {
-            // 重新分析整个项目
-            self.rebuild_project();
-
-            // 发布所有文件的诊断信息（因为跨文件依赖可能影响其他文件）
-            self.publish_all_diagnostics().await;
+            // 分析完成后发布所有文件的诊断信息（因为跨文件依赖可能影响其他文件）
+            self.analysis.file_changed(None, false);
         }
     }
 
@@ -342,21 +392,36 @@ impl LanguageServer for Backend {
             Some(id) => id,
             None => return Ok(None),
         };
+        let Some(file) = self.vfs.get_file_by_file_id(&file_id) else {
+            return Ok(None);
+        };
 
-        let project = self.project.read();
-        let module = match project.modules.get(&file_id) {
-            Some(m) => m,
-            None => return Ok(None),
+        let snapshot = self.analysis.snapshot();
+        let (Some(module), Some(snapshot_file)) = (
+            snapshot.project.modules.get(&file_id),
+            snapshot.vfs.get_file_by_file_id(&file_id),
+        ) else {
+            return Ok(None);
         };
 
-        Ok(lsp_features::goto_definition::goto_definition(
+        let mut response = lsp_features::goto_definition::goto_definition(
             uri,
-            position,
+            TextMap::new(&file, snapshot_file).position(&position),
             module,
-            &project,
-            &self.vfs,
+            &snapshot.project,
+            &snapshot.vfs,
             |file_id| self.get_uri_by_file_id(file_id),
-        ))
+        );
+        match &mut response {
+            Some(GotoDefinitionResponse::Scalar(location)) => {
+                self.live_locations(&snapshot, [location])
+            }
+            Some(GotoDefinitionResponse::Array(locations)) => {
+                self.live_locations(&snapshot, locations)
+            }
+            _ => {}
+        }
+        Ok(response)
     }
 
     async fn references(&self, params: ReferenceParams) -> Result<Option<Vec<Location>>> {
@@ -367,50 +432,84 @@ impl LanguageServer for Backend {
             Some(id) => id,
             None => return Ok(None),
         };
+        let Some(file) = self.vfs.get_file_by_file_id(&file_id) else {
+            return Ok(None);
+        };
 
-        let project = self.project.read();
-        let module = match project.modules.get(&file_id) {
-            Some(m) => m,
-            None => return Ok(None),
+        let snapshot = self.analysis.snapshot();
+        let (Some(module), Some(snapshot_file)) = (
+            snapshot.project.modules.get(&file_id),
+            snapshot.vfs.get_file_by_file_id(&file_id),
+        ) else {
+            return Ok(None);
         };
 
-        Ok(lsp_features::references::get_references(
+        let mut locations = lsp_features::references::get_references(
             uri,
-            position,
+            TextMap::new(&file, snapshot_file).position(&position),
             module,
-            &project,
-            &self.vfs,
+            &snapshot.project,
+            &snapshot.vfs,
             |file_id| self.get_uri_by_file_id(file_id),
-        ))
+        );
+        if let Some(locations) = &mut locations {
+            self.live_locations(&snapshot, locations);
+        }
+        Ok(locations)
     }
 
-    async fn completion(&self, _params: CompletionParams) -> Result<Option<CompletionResponse>> {
-        Ok(None)
-        // let uri = params.text_document_position.text_document.uri;
-        //
-        // let doc = match self.documents.get(&uri) {
-        //     Some(doc) => doc,
-        //     None => return Ok(None),
-        // };
-        //
-        // Ok(lsp_features::completion::completion(
-        //     params.text_document_position.position,
-        //     params.context,
-        //     &doc.line_index,
-        //     &doc.module,
-        //     &doc.text,
-        // ))
+    async fn completion(&self, params: CompletionParams) -> Result<Option<CompletionResponse>> {
+        let uri = params.text_document_position.text_document.uri;
+        let position = params.text_document_position.position;
+
+        let Some(file_id) = self.get_file_id(&uri) else {
+            return Ok(None);
+        };
+        // 正在输入的部分从最新的文本中读取，快照可能还没有包含最后几次输入
+        let Some(file) = self.vfs.get_file_by_file_id(&file_id) else {
+            return Ok(None);
+        };
+        let snapshot = self.analysis.snapshot();
+        let (Some(module), Some(snapshot_file)) = (
+            snapshot.project.modules.get(&file_id),
+            snapshot.vfs.get_file_by_file_id(&file_id),
+        ) else {
+            return Ok(None);
+        };
+
+        Ok(lsp_features::completion::completion(
+            position,
+            &file,
+            module,
+            snapshot_file,
+        ))
     }
 
     async fn hover(&self, params: HoverParams) -> Result<Option<Hover>> {
         let uri = params.text_document_position_params.text_document.uri;
         let position = params.text_document_position_params.position;
 
-        Ok(self
-            .with_module_and_line_index(&uri, |module, line_index| {
-                lsp_features::hover::hover(position, line_index, module)
-            })
-            .flatten())
+        let Some(file_id) = self.get_file_id(&uri) else {
+            return Ok(None);
+        };
+        let Some(file) = self.vfs.get_file_by_file_id(&file_id) else {
+            return Ok(None);
+        };
+        let snapshot = self.analysis.snapshot();
+        let (Some(module), Some(snapshot_file)) = (
+            snapshot.project.modules.get(&file_id),
+            snapshot.vfs.get_file_by_file_id(&file_id),
+        ) else {
+            return Ok(None);
+        };
+
+        // 快照可能还没有包含最后几次输入，位置在两份文本之间换算
+        let position = TextMap::new(&file, snapshot_file).position(&position);
+        let mut hover = lsp_features::hover::hover(position, &snapshot_file.line_index, module);
+        if let Some(range) = hover.as_mut().and_then(|hover| hover.range.as_mut()) {
+            *range = TextMap::new(snapshot_file, &file).range(range);
+        }
+        Ok(hover)
     }
 
     async fn document_symbol(
@@ -430,12 +529,12 @@ impl LanguageServer for Backend {
         &self,
         params: WorkspaceSymbolParams,
     ) -> Result<Option<WorkspaceSymbolResponse>> {
-        let project = self.project.read();
+        let snapshot = self.analysis.snapshot();
 
         Ok(lsp_features::workspace_symbols::search_workspace_symbols(
             &params.query,
-            &project,
-            &self.vfs,
+            &snapshot.project,
+            &snapshot.vfs,
             |file_id| self.get_uri_by_file_id(file_id),
         ))
     }
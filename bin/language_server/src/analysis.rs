@@ -0,0 +1,288 @@
+//! 后台分析
+//!
+//! 分析线程持有两份 [`Project`]：一份作为只读快照发布给请求处理，另一份在后台更新，
+//! 更新完成后两者交换。请求处理只在复制快照的 `Arc` 时短暂持有读锁，不会等待分析，
+//! 代价是内存中同时有两份项目。换下来的旧快照在下一轮分析开始时追上最新状态：
+//! 分析线程为两份快照分别合并它们之后的编辑，能够增量重解析
+//!
+//! 分析期间有了新的修改时取消这一轮，未完成的结果不发布，下一轮在它的基础上继续，
+//! 只重新分析被跳过的模块和新修改的模块
+
+use std::collections::{HashMap, HashSet};
+use std::ops::Deref;
+use std::sync::Arc;
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::thread;
+
+use analyzer::cancel::CancelToken;
+use analyzer::checker::RecursiveTypeChecker;
+use analyzer::project::Project;
+use parking_lot::{Condvar, Mutex, RwLock};
+use tools::TextEdit;
+use vfs::{FileID, Vfs, VfsSnapshot};
+
+/// 某一次分析完成时的项目，以及分析时的文件内容
+#[derive(Debug)]
+pub(crate) struct Snapshot {
+    pub project: Project,
+    /// 位置转换需要使用这里的 LineIndex，与 `project` 一致
+    pub vfs: VfsSnapshot,
+    /// 发布的序号，每次发布加一
+    pub revision: u64,
+}
+
+impl Snapshot {
+    fn new() -> Self {
+        Self {
+            project: Project::new().with_checker::<RecursiveTypeChecker>(),
+            vfs: VfsSnapshot::default(),
+            revision: 0,
+        }
+    }
+
+    /// 更新到 `vfs` 中的文件内容
+    ///
+    /// 文本没有变化的文件跳过；编辑前后的文本都与 `hints` 中记录的一致时使用记录的编辑，
+    /// 否则使用两段文本的差异，由 [`Project::update_file_with_edit`] 尝试增量重解析。
+    /// 文件增删时全量初始化。之前被取消的分析在这里补上
+    fn sync(&mut self, vfs: VfsSnapshot, hints: &HashMap<FileID, EditHint>) {
+        let file_ids = vfs.file_ids();
+        let old_ids: HashSet<_> = self.vfs.file_ids().into_iter().collect();
+        let live = Vfs::from(vfs.clone());
+
+        if file_ids.len() != old_ids.len() || file_ids.iter().any(|id| !old_ids.contains(id)) {
+            self.project.full_initialize(&live);
+        } else {
+            for file_id in file_ids {
+                let (Some(old), Some(new)) = (
+                    self.vfs.get_file_by_file_id(&file_id),
+                    vfs.get_file_by_file_id(&file_id),
+                ) else {
+                    continue;
+                };
+                if Arc::ptr_eq(&old.text, &new.text) {
+                    continue;
+                }
+                let edit = match hints.get(&file_id) {
+                    Some(hint)
+                        if Arc::ptr_eq(&hint.before, &old.text)
+                            && Arc::ptr_eq(&hint.after, &new.text) =>
+                    {
+                        Some(hint.edit.clone())
+                    }
+                    _ => TextEdit::diff(&old.text, &new.text),
+                };
+                match edit {
+                    Some(edit) => self.project.update_file_with_edit(&live, file_id, &edit),
+                    None => self.project.update_file(&live, file_id),
+                }
+            }
+        }
+        self.project.resume(&live);
+        self.vfs = vfs;
+    }
+}
+
+/// 文件的一次增量编辑，`before` 和 `after` 是 VFS 中编辑前后的文本
+#[derive(Debug, Clone)]
+pub(crate) struct EditHint {
+    pub file_id: FileID,
+    pub before: Arc<str>,
+    pub after: Arc<str>,
+    pub edit: TextEdit,
+}
+
+/// 把 `hint` 合并到 `hints` 中同一文件已有的编辑之后
+///
+/// 两次编辑不相接（中间有没有记录的修改）时只保留新的一次，`sync` 会退回到文本差异
+fn merge_hint(hints: &mut HashMap<FileID, EditHint>, hint: EditHint) {
+    let merged = match hints.remove(&hint.file_id) {
+        Some(prev) if Arc::ptr_eq(&prev.after, &hint.before) => {
+            match TextEdit::compose(&[prev.edit, hint.edit.clone()], &hint.after) {
+                Some(edit) => EditHint {
+                    before: prev.before,
+                    edit,
+                    ..hint
+                },
+                None => hint,
+            }
+        }
+        _ => hint,
+    };
+    hints.insert(merged.file_id, merged);
+}
+
+#[derive(Debug)]
+struct Task {
+    hint: Option<EditHint>,
+    /// 为 true 时诊断延迟发布，用于连续输入
+    debounce: bool,
+}
+
+/// 发布快照后的回调，不能持有快照
+type OnPublish = Box<dyn FnMut(&Snapshot, bool) + Send>;
+
+/// 请求处理持有的快照，释放时通知分析线程
+pub(crate) struct SnapshotRef {
+    snapshot: Option<Arc<Snapshot>>,
+    released: Arc<Released>,
+}
+
+impl Deref for SnapshotRef {
+    type Target = Snapshot;
+
+    fn deref(&self) -> &Snapshot {
+        self.snapshot
+            .as_ref()
+            .expect("snapshot is only taken on drop")
+    }
+}
+
+impl Drop for SnapshotRef {
+    fn drop(&mut self) {
+        drop(self.snapshot.take());
+        // 加锁后通知，分析线程检查引用计数和开始等待之间不会错过通知
+        let _lock = self.released.lock.lock();
+        self.released.condvar.notify_all();
+    }
+}
+
+/// 快照被请求处理释放的通知
+#[derive(Debug, Default)]
+struct Released {
+    lock: Mutex<()>,
+    condvar: Condvar,
+}
+
+/// 后台分析线程的句柄
+#[derive(Debug)]
+pub(crate) struct Analysis {
+    current: Arc<RwLock<Arc<Snapshot>>>,
+    sender: Sender<Task>,
+    released: Arc<Released>,
+    /// 正在进行的一轮分析的取消标记
+    cancel: Arc<Mutex<CancelToken>>,
+}
+
+impl Analysis {
+    /// 启动分析线程，每次发布快照后调用 `on_publish(快照, 是否延迟发布诊断)`
+    pub fn new(vfs: Arc<Vfs>, on_publish: impl FnMut(&Snapshot, bool) + Send + 'static) -> Self {
+        let current = Arc::new(RwLock::new(Arc::new(Snapshot::new())));
+        let released = Arc::new(Released::default());
+        let cancel = Arc::new(Mutex::new(CancelToken::new()));
+        let (sender, receiver) = mpsc::channel();
+
+        let worker = Worker {
+            vfs,
+            current: Arc::clone(&current),
+            released: Arc::clone(&released),
+            cancel: Arc::clone(&cancel),
+            receiver,
+            on_publish: Box::new(on_publish),
+        };
+        thread::Builder::new()
+            .name("analysis".to_string())
+            .spawn(move || worker.run())
+            .expect("failed to spawn analysis thread");
+
+        Self {
+            current,
+            sender,
+            released,
+            cancel,
+        }
+    }
+
+    /// 最近一次发布的快照
+    pub fn snapshot(&self) -> SnapshotRef {
+        SnapshotRef {
+            snapshot: Some(Arc::clone(&self.current.read())),
+            released: Arc::clone(&self.released),
+        }
+    }
+
+    /// 通知 VFS 中的文件发生了变化，取消正在进行的分析
+    pub fn file_changed(&self, hint: Option<EditHint>, debounce: bool) {
+        // 分析线程只在句柄析构后退出
+        let _ = self.sender.send(Task { hint, debounce });
+        self.cancel.lock().cancel();
+    }
+}
+
+struct Worker {
+    vfs: Arc<Vfs>,
+    current: Arc<RwLock<Arc<Snapshot>>>,
+    released: Arc<Released>,
+    cancel: Arc<Mutex<CancelToken>>,
+    receiver: Receiver<Task>,
+    on_publish: OnPublish,
+}
+
+impl Worker {
+    fn run(mut self) {
+        // 后台更新的一份，为 None 时它还作为旧快照被共享
+        let mut back = Some(Snapshot::new());
+        let mut retired = None;
+        // 两份快照各自之后的编辑
+        let mut back_hints = HashMap::new();
+        let mut front_hints = HashMap::new();
+        let mut debounce = true;
+
+        while let Ok(task) = self.receiver.recv() {
+            // 先换上这一轮的标记，取出排队的修改之后到来的修改会取消这一轮
+            let cancel = CancelToken::new();
+            *self.cancel.lock() = cancel.clone();
+
+            // 合并排队中的修改，只分析一次
+            for task in std::iter::once(task).chain(self.receiver.try_iter()) {
+                debounce &= task.debounce;
+                if let Some(hint) = task.hint {
+                    merge_hint(&mut front_hints, hint.clone());
+                    merge_hint(&mut back_hints, hint);
+                }
+            }
+
+            let mut snapshot = match back.take() {
+                Some(snapshot) => snapshot,
+                None => reclaim(
+                    retired.take().expect("no snapshot to update"),
+                    &self.released,
+                ),
+            };
+            snapshot.project.set_cancel_token(cancel);
+            snapshot.sync(self.vfs.snapshot(), &back_hints);
+            back_hints.clear();
+
+            // 被新的修改取消，不发布，下一轮继续更新这一份
+            if !snapshot.project.is_complete() {
+                back = Some(snapshot);
+                continue;
+            }
+
+            snapshot.revision = self.current.read().revision + 1;
+            let snapshot = Arc::new(snapshot);
+            let old = std::mem::replace(&mut *self.current.write(), Arc::clone(&snapshot));
+            (self.on_publish)(&snapshot, debounce);
+            drop(snapshot);
+            retired = Some(old);
+
+            // 换下来的快照落后于它发布之后的所有编辑
+            back_hints = std::mem::take(&mut front_hints);
+            debounce = true;
+        }
+    }
+}
+
+/// 等待请求处理释放旧快照后取回所有权
+fn reclaim(mut snapshot: Arc<Snapshot>, released: &Released) -> Snapshot {
+    let mut lock = released.lock.lock();
+    loop {
+        match Arc::try_unwrap(snapshot) {
+            Ok(snapshot) => return snapshot,
+            Err(shared) => {
+                snapshot = shared;
+                released.condvar.wait(&mut lock);
+            }
+        }
+    }
+}
@@ -1,31 +1,116 @@
-// pub(crate) mod keyword;
-//
-// use analyzer::module::Module;
-// use tools::LineIndex;
-// use tower_lsp_server::ls_types::{CompletionContext, CompletionItem, CompletionResponse, Position};
-//
-// pub(crate) fn completion(
-//     _pos: Position,
-//     context: Option<CompletionContext>,
-//     _line_index: &LineIndex,
-//     _module: &Module,
-//     _text: &str,
-// ) -> Option<CompletionResponse> {
-//     // let mut items: Vec<CompletionItem> = Vec::new();
-//
-//     // // 检查触发上下文
-//     // if let Some(ctx) = context {
-//     //     // 如果是触发字符触发（如 . 或 ->）
-//     //     if let Some(trigger_char) = &ctx.trigger_character {
-//     //         match trigger_char.as_str() {
-//     //             "." => {
-//     //                 // TODO: 结构体字段补全
-//     //             }
-//     //             "->" => {
-//     //                 // TODO: 指针解引用补全
-//     //             }
-//     //             _ => {}
-//     //         }
-//     //     }
-//     // }
-// }
+pub(crate) mod keyword;
+
+use std::collections::HashSet;
+
+use analyzer::module::{Module, ScopeID};
+use analyzer::symbol_index::match_score;
+use rowan::TextSize;
+use tower_lsp_server::ls_types::{
+    CompletionItem, CompletionItemKind, CompletionResponse, Position,
+};
+use vfs::VirtulFile;
+
+use crate::utils::position_trans::{TextMap, ls_position_to_offset};
+
+/// 标识符补全
+///
+/// 候选项为光标所在作用域链上的变量、模块中可见的函数、结构体和常量（包括导入的）以及关键字，
+/// 按与光标前已输入部分的匹配程度排序
+///
+/// `file` 是最新的文本，用于读取正在输入的部分；`module` 来自快照，
+/// 按 `snapshot_file` 中对应的位置查找作用域
+pub(crate) fn completion(
+    pos: Position,
+    file: &VirtulFile,
+    module: &Module,
+    snapshot_file: &VirtulFile,
+) -> Option<CompletionResponse> {
+    let live_offset = ls_position_to_offset(&file.line_index, &pos);
+    let prefix = identifier_prefix(&file.text, live_offset as usize);
+    let offset = TextMap::new(file, snapshot_file).offset(live_offset);
+
+    let mut items = Vec::new();
+    let mut seen = HashSet::new();
+    let mut push = |label: String, kind: CompletionItemKind, detail: Option<String>| {
+        if let Some(score) = match_score(&label, prefix)
+            && seen.insert(label.clone())
+        {
+            items.push(CompletionItem {
+                sort_text: Some(format!("{}{}", score, label)),
+                label,
+                kind: Some(kind),
+                detail,
+                ..Default::default()
+            });
+        }
+    };
+
+    // 内层作用域的变量遮蔽外层的同名变量
+    let mut scope = innermost_scope(module, offset);
+    while let Some(scope_id) = scope {
+        let Some(current) = module.scopes.get(*scope_id) else {
+            break;
+        };
+        for var_id in current.variables.values() {
+            let Some(variable) = module.variables.get(**var_id) else {
+                continue;
+            };
+            // 局部变量只在声明之后可见
+            if scope_id != module.global_scope && variable.range.start() > TextSize::from(offset) {
+                continue;
+            }
+            let kind = if variable.is_const() {
+                CompletionItemKind::CONSTANT
+            } else {
+                CompletionItemKind::VARIABLE
+            };
+            push(variable.name.clone(), kind, Some(variable.ty.to_string()));
+        }
+        scope = current.parent;
+    }
+
+    for name in module.function_map.keys() {
+        push(name.to_string(), CompletionItemKind::FUNCTION, None);
+    }
+    for name in module.struct_map.keys() {
+        push(name.to_string(), CompletionItemKind::STRUCT, None);
+    }
+    // 本模块的常量已经作为全局变量加入
+    for (name, const_id) in &module.constant_map {
+        if const_id.module != module.file_id {
+            let detail = module
+                .get_constant_by_id(*const_id)
+                .map(|constant| constant.ty.to_string());
+            push(name.to_string(), CompletionItemKind::CONSTANT, detail);
+        }
+    }
+    for item in keyword::complete_keywords() {
+        push(item.label, CompletionItemKind::KEYWORD, item.detail);
+    }
+
+    Some(CompletionResponse::Array(items))
+}
+
+/// 光标前正在输入的标识符
+fn identifier_prefix(text: &str, offset: usize) -> &str {
+    let Some(before) = text.get(..offset) else {
+        return "";
+    };
+    let start = before
+        .char_indices()
+        .rev()
+        .find(|(_, c)| !(c.is_alphanumeric() || *c == '_'))
+        .map_or(0, |(i, c)| i + c.len_utf8());
+    &before[start..]
+}
+
+/// 包含 `offset` 的最小作用域
+fn innermost_scope(module: &Module, offset: u32) -> Option<ScopeID> {
+    module
+        .scopes
+        .iter()
+        .filter(|(_, scope)| scope.range.contains_inclusive(TextSize::from(offset)))
+        .min_by_key(|(_, scope)| scope.range.len())
+        .map(|(index, _)| ScopeID::from(index))
+        .or(Some(module.global_scope))
+}
@@ -1,8 +1,53 @@
+use std::collections::HashMap;
+use std::hash::{DefaultHasher, Hash, Hasher};
+use std::sync::Arc;
+
 use crate::utils::position_trans::text_range_to_ls_range;
 use analyzer::error::AnalyzeError;
 use miette::Diagnostic as _;
 use tools::LineIndex;
 use tower_lsp_server::ls_types::*;
+use vfs::FileID;
+
+/// 记录每个文件上次计算诊断时的文本和错误指纹，跳过诊断没有变化的文件
+#[derive(Debug, Default)]
+pub struct DiagnosticCache {
+    files: HashMap<FileID, (Arc<str>, u64)>,
+}
+
+impl DiagnosticCache {
+    /// 与上次相比诊断是否可能变化，同时记录这一次的状态
+    ///
+    /// 错误相同但文本变化时，错误的行列位置可能改变，所以仍然需要重新计算；
+    /// 没有错误的文件不受文本变化影响。第一次出现且没有错误的文件不需要发布
+    pub fn changed(&mut self, file_id: FileID, text: &Arc<str>, errors: &[AnalyzeError]) -> bool {
+        let fingerprint = fingerprint(errors);
+        match self.files.insert(file_id, (text.clone(), fingerprint)) {
+            Some((old_text, old_fingerprint)) => {
+                old_fingerprint != fingerprint
+                    || (!errors.is_empty() && !Arc::ptr_eq(&old_text, text))
+            }
+            None => !errors.is_empty(),
+        }
+    }
+}
+
+/// 错误列表的指纹，包含 LSP Diagnostic 用到的所有信息
+fn fingerprint(errors: &[AnalyzeError]) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    errors.len().hash(&mut hasher);
+    for error in errors {
+        error.to_string().hash(&mut hasher);
+        error.help().map(|help| help.to_string()).hash(&mut hasher);
+        error.code().map(|code| code.to_string()).hash(&mut hasher);
+        error
+            .severity()
+            .map(|severity| severity as u8)
+            .hash(&mut hasher);
+        error.range().hash(&mut hasher);
+    }
+    hasher.finish()
+}
 
 /// 将所有错误转换为 LSP Diagnostic
 pub fn compute_diagnostics(errors: &[AnalyzeError], line_index: &LineIndex) -> Vec<Diagnostic> {
@@ -1,6 +1,6 @@
 use analyzer::{module::Module, project::Project};
 use tower_lsp_server::ls_types::{GotoDefinitionResponse, Location, Position, Uri};
-use vfs::{FileID, Vfs};
+use vfs::{FileID, VfsSnapshot};
 
 use crate::utils::get_at_position::{get_function_id_at_position, get_struct_id_at_position};
 use crate::utils::{
@@ -13,7 +13,7 @@ pub(crate) fn goto_definition<F>(
     pos: Position,
     module: &Module,
     _project: &Project,
-    vfs: &Vfs,
+    vfs: &VfsSnapshot,
     get_uri_by_file_id: F,
 ) -> Option<GotoDefinitionResponse>
 where
@@ -48,6 +48,13 @@ where
                     field_id.module,
                 )
             }
+            analyzer::module::ReferenceTag::ConstRead(constant_id) => {
+                // 导入的常量在其他文件，使用 constant_id.module
+                (
+                    module.get_constant_by_id(constant_id).map(|c| c.range),
+                    constant_id.module,
+                )
+            }
         };
 
         if let Some(range) = range {
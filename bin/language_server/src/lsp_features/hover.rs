@@ -23,6 +23,9 @@ pub(crate) fn hover(pos: Position, line_index: &LineIndex, module: &Module) -> O
             analyzer::module::ReferenceTag::FieldRead(field_id) => {
                 build_hover_for_field(module, field_id, line_index, refer.range)
             }
+            analyzer::module::ReferenceTag::ConstRead(constant_id) => {
+                build_hover_for_constant(module, constant_id, line_index, refer.range)
+            }
         };
     }
 
@@ -70,6 +73,25 @@ fn build_hover_for_variable(
     })
 }
 
+/// 为导入的全局常量构建 hover 信息
+fn build_hover_for_constant(
+    module: &Module,
+    const_id: analyzer::module::ConstantID,
+    line_index: &LineIndex,
+    range: tools::TextRange,
+) -> Option<Hover> {
+    let constant = module.get_constant_by_id(const_id)?;
+    let signature = format_value_signature(&constant.name, &constant.ty, constant.value.as_ref());
+
+    Some(Hover {
+        contents: HoverContents::Markup(MarkupContent {
+            kind: MarkupKind::Markdown,
+            value: format!("```rust\n{}\n```", signature),
+        }),
+        range: Some(text_range_to_ls_range(line_index, range)),
+    })
+}
+
 /// 为函数构建 hover 信息
 fn build_hover_for_function(
     module: &Module,
@@ -131,14 +153,23 @@ fn build_hover_for_field(
 fn format_variable_signature(
     variable: &analyzer::module::Variable,
     value: Option<&analyzer::value::Value>,
+) -> String {
+    format_value_signature(&variable.name, &variable.ty, value)
+}
+
+/// 有常量值时显示值，否则显示类型
+fn format_value_signature(
+    name: &str,
+    ty: &analyzer::r#type::Ty,
+    value: Option<&analyzer::value::Value>,
 ) -> String {
     let v = match value {
         Some(analyzer::value::Value::I32(x)) => x.to_string(),
         Some(analyzer::value::Value::I8(x)) => x.to_string(),
         Some(analyzer::value::Value::Bool(x)) => x.to_string(),
-        _ => variable.ty.to_string(),
+        _ => ty.to_string(),
     };
-    format!("{}: {}", variable.name, v)
+    format!("{}: {}", name, v)
 }
 
 /// 格式化函数签名
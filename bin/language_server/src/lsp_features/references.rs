@@ -1,6 +1,6 @@
 use analyzer::{module::Module, project::Project};
 use tower_lsp_server::ls_types::{Location, Position, Uri};
-use vfs::{FileID, Vfs};
+use vfs::{FileID, VfsSnapshot};
 
 use crate::utils::{
     get_at_position::{get_function_id_at_position, get_variable_id_at_position},
@@ -12,7 +12,7 @@ pub(crate) fn get_references<F>(
     pos: Position,
     module: &Module,
     _project: &Project,
-    vfs: &Vfs,
+    vfs: &VfsSnapshot,
     get_uri_by_file_id: F,
 ) -> Option<Vec<Location>>
 where
@@ -1,4 +1,5 @@
 mod airyc_ls;
+mod analysis;
 mod lsp_features;
 mod utils;
 
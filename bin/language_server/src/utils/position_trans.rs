@@ -1,20 +1,82 @@
 //! position <-> line_position
 
-use tools::{LineIndex, TextRange};
+use std::sync::Arc;
+
+use tools::{LineIndex, TextEdit, TextRange};
 use tower_lsp_server::ls_types::{Position, Range};
+use vfs::VirtulFile;
 
+/// LSP 的列号以 UTF-16 编码单元计
 pub(crate) fn ls_position_to_offset(line_index: &LineIndex, pos: &Position) -> u32 {
-    line_index.get_offset(pos.line, pos.character)
+    line_index.get_offset_utf16(pos.line, pos.character)
 }
 
 pub(crate) fn offset_to_ls_position(line_index: &LineIndex, offset: u32) -> Position {
-    let (r, c) = line_index.get_row_column(offset);
+    let (r, c) = line_index.get_row_column_utf16(offset);
     Position::new(r, c)
 }
 
+pub(crate) fn ls_range_to_text_range(line_index: &LineIndex, range: &Range) -> TextRange {
+    TextRange::new(
+        ls_position_to_offset(line_index, &range.start),
+        ls_position_to_offset(line_index, &range.end),
+    )
+}
+
 pub(crate) fn text_range_to_ls_range(line_index: &LineIndex, text_range: TextRange) -> Range {
     Range::new(
         offset_to_ls_position(line_index, text_range.start().into()),
         offset_to_ls_position(line_index, text_range.end().into()),
     )
 }
+
+/// 同一文件两个版本之间的位置换算，用于最新文本与快照之间
+///
+/// 两段文本按公共前缀和后缀看作一处编辑：编辑之前的位置不变，编辑之后的位置按长度变化平移，
+/// 编辑之中的位置对应编辑开始处
+pub(crate) struct TextMap<'a> {
+    from: &'a LineIndex,
+    to: &'a LineIndex,
+    /// 从 `from` 到 `to` 的编辑，文本相同时为 None
+    edit: Option<TextEdit>,
+}
+
+impl<'a> TextMap<'a> {
+    pub fn new(from: &'a VirtulFile, to: &'a VirtulFile) -> Self {
+        let edit = if Arc::ptr_eq(&from.text, &to.text) {
+            None
+        } else {
+            TextEdit::diff(&from.text, &to.text)
+        };
+        Self {
+            from: &from.line_index,
+            to: &to.line_index,
+            edit,
+        }
+    }
+
+    pub fn offset(&self, offset: u32) -> u32 {
+        let Some(edit) = &self.edit else {
+            return offset;
+        };
+        let (start, end) = (u32::from(edit.range.start()), u32::from(edit.range.end()));
+        if offset <= start {
+            offset
+        } else if offset >= end {
+            (offset as i64 + edit.delta()) as u32
+        } else {
+            start
+        }
+    }
+
+    pub fn position(&self, pos: &Position) -> Position {
+        if self.edit.is_none() {
+            return *pos;
+        }
+        offset_to_ls_position(self.to, self.offset(ls_position_to_offset(self.from, pos)))
+    }
+
+    pub fn range(&self, range: &Range) -> Range {
+        Range::new(self.position(&range.start), self.position(&range.end))
+    }
+}
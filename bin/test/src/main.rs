@@ -1,12 +1,16 @@
 use std::fs;
-use std::io::{self, Write};
+use std::io::{self, Read, Write};
 use std::path::{Path, PathBuf};
 use std::process::{Command, Stdio};
+use std::str::FromStr;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::mpsc;
 use std::thread;
 use std::time::{Duration, Instant};
 
 use anyhow::{Context, Result};
 use clap::Parser;
+use serde::Serialize;
 
 #[derive(Parser, Debug)]
 struct Args {
@@ -27,6 +31,65 @@ struct Args {
 
     #[arg(short, long)]
     verbose: bool,
+
+    /// number of test cases to run in parallel, 0 for the number of CPUs
+    #[arg(short, long, default_value = "1")]
+    jobs: usize,
+
+    /// only run the INDEX-th of COUNT shards, e.g. 0/4
+    #[arg(long)]
+    shard: Option<Shard>,
+
+    /// write per-case timing to this JSON file
+    #[arg(long)]
+    report: Option<PathBuf>,
+
+    /// benchmark the generated code instead of only checking its output
+    #[arg(long)]
+    bench: bool,
+
+    /// run each case in the compiler's JIT (`--emit run`) instead of linking an executable
+    #[arg(long, conflicts_with = "bench")]
+    jit: bool,
+
+    /// number of timed runs per case and optimization level in bench mode
+    #[arg(long, default_value = "5")]
+    repeat: usize,
+
+    /// optimization levels to benchmark
+    #[arg(
+        long,
+        value_delimiter = ',',
+        default_value = "none,less,default,aggressive"
+    )]
+    opt_levels: Vec<String>,
+}
+
+/// 测试用例分片 `INDEX/COUNT`
+#[derive(Debug, Clone, Copy)]
+struct Shard {
+    index: usize,
+    count: usize,
+}
+
+impl FromStr for Shard {
+    type Err = String;
+
+    fn from_str(s: &str) -> std::result::Result<Self, Self::Err> {
+        let (index, count) = s
+            .split_once('/')
+            .ok_or_else(|| format!("expected INDEX/COUNT, found {s}"))?;
+        let index: usize = index
+            .parse()
+            .map_err(|e| format!("invalid shard index: {e}"))?;
+        let count: usize = count
+            .parse()
+            .map_err(|e| format!("invalid shard count: {e}"))?;
+        if index >= count {
+            return Err(format!("shard index {index} out of range 0..{count}"));
+        }
+        Ok(Self { index, count })
+    }
 }
 
 #[derive(Clone)]
@@ -49,6 +112,68 @@ struct TestResult {
     case: TestCase,
     status: TestStatus,
     duration: Duration,
+    /// 编译耗时
+    compile_time: Duration,
+    /// 运行耗时，没有运行时为 None
+    run_time: Option<Duration>,
+    /// 可执行文件大小
+    binary_size: Option<u64>,
+}
+
+impl TestResult {
+    fn new(case: &TestCase, status: TestStatus, duration: Duration) -> Self {
+        Self {
+            case: case.clone(),
+            status,
+            duration,
+            compile_time: Duration::ZERO,
+            run_time: None,
+            binary_size: None,
+        }
+    }
+}
+
+/// JSON 报告中的单个用例
+#[derive(Serialize)]
+struct CaseReport<'a> {
+    level: &'a str,
+    name: &'a str,
+    status: &'static str,
+    compile_ms: f64,
+    run_ms: Option<f64>,
+    binary_size: Option<u64>,
+}
+
+/// 一个用例在一个优化级别下的基准测试结果
+struct BenchResult {
+    result: TestResult,
+    opt_level: String,
+    /// 每次运行的耗时，输出不正确时为空
+    runs: Vec<Duration>,
+    /// 用户态执行的指令数，没有 `perf` 时为 None
+    instructions: Option<u64>,
+}
+
+impl BenchResult {
+    fn median(&self) -> Option<Duration> {
+        let mut runs = self.runs.clone();
+        runs.sort();
+        runs.get(runs.len() / 2).copied()
+    }
+}
+
+/// JSON 报告中的单个基准测试结果
+#[derive(Serialize)]
+struct BenchReport<'a> {
+    level: &'a str,
+    name: &'a str,
+    opt_level: &'a str,
+    status: &'static str,
+    compile_ms: f64,
+    median_ms: Option<f64>,
+    runs_ms: Vec<f64>,
+    instructions: Option<u64>,
+    binary_size: Option<u64>,
 }
 
 fn collect_test_cases(dirs: &[PathBuf], excludes: &[String]) -> Result<Vec<TestCase>> {
@@ -105,38 +230,144 @@ fn run_with_timeout(
 ) -> io::Result<(Vec<u8>, i32, bool)> {
     cmd.stdin(Stdio::piped());
     cmd.stdout(Stdio::piped());
-    cmd.stderr(Stdio::piped());
+    cmd.stderr(Stdio::null());
 
     let mut child = cmd.spawn()?;
 
-    if let Some(mut stdin) = child.stdin.take() {
-        stdin.write_all(input.as_bytes())?;
-    }
+    // 输入和输出在单独的线程中读写，避免管道写满后子进程阻塞
+    let stdin = child.stdin.take().map(|mut stdin| {
+        let input = input.to_string();
+        thread::spawn(move || {
+            let _ = stdin.write_all(input.as_bytes());
+        })
+    });
+    let stdout = child.stdout.take().map(|mut stdout| {
+        thread::spawn(move || {
+            let mut buf = vec![];
+            let _ = stdout.read_to_end(&mut buf);
+            buf
+        })
+    });
 
     let start = Instant::now();
+    // 轮询间隔从 1ms 逐渐增加，运行很快的用例不会被固定的间隔拖慢
+    let mut interval = Duration::from_millis(1);
 
-    loop {
-        match child.try_wait() {
-            Ok(Some(status)) => {
-                let return_code = status.code().unwrap_or(-1);
-                let mut std_out = child.stdout.take().unwrap();
-                let mut buf = vec![];
-                let _ = std::io::Read::read_to_end(&mut std_out, &mut buf);
-                return Ok((buf, return_code, false));
-            }
-            Ok(None) => {
+    let status = loop {
+        match child.try_wait()? {
+            Some(status) => break status,
+            None => {
                 if start.elapsed() >= timeout {
                     child.kill()?;
+                    let _ = child.wait();
                     return Ok((vec![], -1, true));
                 }
-                thread::sleep(Duration::from_millis(100));
+                thread::sleep(interval);
+                interval = (interval * 2).min(Duration::from_millis(50));
             }
-            Err(e) => return Err(e),
         }
+    };
+
+    if let Some(stdin) = stdin {
+        let _ = stdin.join();
     }
+    let buf = stdout
+        .and_then(|stdout| stdout.join().ok())
+        .unwrap_or_default();
+    Ok((buf, status.code().unwrap_or(-1), false))
 }
 
-fn run_test(case: &TestCase, args: &Args, tmp_dir: &Path) -> Result<TestResult> {
+/// 逐行比较两段文本，输出 `diff` 风格的差异
+///
+/// 使用最长公共子序列对齐，输入过大时只报告第一处不同的行
+fn diff_lines(expected: &str, actual: &str) -> String {
+    const MAX_CELLS: usize = 4_000_000;
+
+    let expected: Vec<&str> = expected.lines().collect();
+    let actual: Vec<&str> = actual.lines().collect();
+    let (n, m) = (expected.len(), actual.len());
+
+    if (n + 1) * (m + 1) > MAX_CELLS {
+        let line = expected
+            .iter()
+            .zip(&actual)
+            .position(|(a, b)| a != b)
+            .unwrap_or(n.min(m));
+        return format!(
+            "first difference at line {}\n< {}\n---\n> {}\n",
+            line + 1,
+            expected.get(line).unwrap_or(&""),
+            actual.get(line).unwrap_or(&"")
+        );
+    }
+
+    // lcs[i][j]: expected[i..] 与 actual[j..] 的最长公共子序列长度
+    let mut lcs = vec![vec![0u32; m + 1]; n + 1];
+    for i in (0..n).rev() {
+        for j in (0..m).rev() {
+            lcs[i][j] = if expected[i] == actual[j] {
+                lcs[i + 1][j + 1] + 1
+            } else {
+                lcs[i + 1][j].max(lcs[i][j + 1])
+            };
+        }
+    }
+
+    let mut out = String::new();
+    let (mut i, mut j) = (0, 0);
+    while i < n || j < m {
+        if i < n && j < m && expected[i] == actual[j] {
+            i += 1;
+            j += 1;
+            continue;
+        }
+        // 收集一段连续的差异
+        let (start_i, start_j) = (i, j);
+        while (i < n || j < m) && !(i < n && j < m && expected[i] == actual[j]) {
+            if j >= m || (i < n && lcs[i + 1][j] >= lcs[i][j + 1]) {
+                i += 1;
+            } else {
+                j += 1;
+            }
+        }
+        out.push_str(&format!(
+            "{}{}{}\n",
+            hunk_range(start_i, i),
+            match (start_i == i, start_j == j) {
+                (true, _) => 'a',
+                (_, true) => 'd',
+                _ => 'c',
+            },
+            hunk_range(start_j, j)
+        ));
+        for line in &expected[start_i..i] {
+            out.push_str(&format!("< {}\n", line));
+        }
+        if start_i != i && start_j != j {
+            out.push_str("---\n");
+        }
+        for line in &actual[start_j..j] {
+            out.push_str(&format!("> {}\n", line));
+        }
+    }
+    out
+}
+
+/// `diff` 的行号范围（从 1 开始），空范围时为它之前的行号
+fn hunk_range(start: usize, end: usize) -> String {
+    match end - start {
+        0 => start.to_string(),
+        1 => end.to_string(),
+        _ => format!("{},{}", start + 1, end),
+    }
+}
+
+fn run_test(
+    case: &TestCase,
+    args: &Args,
+    tmp_dir: &Path,
+    opt_level: Option<&str>,
+) -> Result<TestResult> {
     let start = Instant::now();
 
     let input_file = case.path.with_extension("in");
@@ -153,80 +384,114 @@ fn run_test(case: &TestCase, args: &Args, tmp_dir: &Path) -> Result<TestResult>
     let std_content = match fs::read_to_string(&std_out) {
         Ok(content) => content,
         Err(_) => {
-            return Ok(TestResult {
-                case: case.clone(),
-                status: TestStatus::CompileError(format!("{} not found", std_out.display())),
-                duration: start.elapsed(),
-            });
+            return Ok(TestResult::new(
+                case,
+                TestStatus::CompileError(format!("{} not found", std_out.display())),
+                start.elapsed(),
+            ));
         }
     };
 
-    let my_out = tmp_dir.join("my_out.txt");
-
     let timeout = Duration::from_secs(args.timeout);
 
-    let compile_cmd = Command::new(compiler)
-        .arg(&case.path)
-        .arg("-o")
-        .arg(tmp_dir)
+    if args.jit {
+        return run_test_jit(case, args, &input, &std_content, opt_level, start);
+    }
+
+    let compile_start = Instant::now();
+    let mut compile_cmd = Command::new(compiler);
+    compile_cmd.arg(&case.path).arg("-o").arg(tmp_dir);
+    if let Some(opt_level) = opt_level {
+        compile_cmd.arg("-O").arg(opt_level);
+    }
+    let compile_cmd = compile_cmd
         .output()
         .context("airyc-compiler compile failed")?;
+    let compile_time = compile_start.elapsed();
 
     if !compile_cmd.status.success() {
-        return Ok(TestResult {
-            case: case.clone(),
-            status: TestStatus::CompileError(
-                String::from_utf8_lossy(&compile_cmd.stderr).to_string(),
-            ),
-            duration: start.elapsed(),
-        });
+        let mut result = TestResult::new(
+            case,
+            TestStatus::CompileError(String::from_utf8_lossy(&compile_cmd.stderr).to_string()),
+            start.elapsed(),
+        );
+        result.compile_time = compile_time;
+        return Ok(result);
     }
 
     let my_exec_path = tmp_dir.join(&case.name);
-    if !my_exec_path.exists() {
-        return Ok(TestResult {
-            case: case.clone(),
-            status: TestStatus::CompileError(format!("{my_exec_path:?} not found")),
-            duration: start.elapsed(),
-        });
-    }
+    let Ok(metadata) = fs::metadata(&my_exec_path) else {
+        let mut result = TestResult::new(
+            case,
+            TestStatus::CompileError(format!("{my_exec_path:?} not found")),
+            start.elapsed(),
+        );
+        result.compile_time = compile_time;
+        return Ok(result);
+    };
 
+    let run_start = Instant::now();
     let (my_output, my_return, timed_out) =
         run_with_timeout(&mut Command::new(&my_exec_path), &input, timeout)?;
+    let run_time = run_start.elapsed();
 
-    if timed_out {
-        return Ok(TestResult {
-            case: case.clone(),
-            status: TestStatus::Timeout,
-            duration: start.elapsed(),
-        });
-    }
-
-    let mut my_content = String::from_utf8_lossy(&my_output).to_string();
-    my_content.push_str(&format!("return: {}\n", my_return));
+    Ok(TestResult {
+        case: case.clone(),
+        status: check_output(&std_content, &my_output, my_return, timed_out),
+        duration: start.elapsed(),
+        compile_time,
+        run_time: Some(run_time),
+        binary_size: Some(metadata.len()),
+    })
+}
 
-    fs::write(&my_out, &my_content)?;
+/// 由编译器 JIT 编译并运行用例，不生成可执行文件
+///
+/// 编译和运行在同一个进程中，只统计总耗时。编译错误也会体现为输出不一致
+fn run_test_jit(
+    case: &TestCase,
+    args: &Args,
+    input: &str,
+    std_content: &str,
+    opt_level: Option<&str>,
+    start: Instant,
+) -> Result<TestResult> {
+    let mut run_cmd = Command::new(&args.compiler);
+    run_cmd.arg(&case.path).arg("--emit").arg("run");
+    if let Some(opt_level) = opt_level {
+        run_cmd.arg("-O").arg(opt_level);
+    }
 
-    let status = if std_content == my_content {
-        TestStatus::Passed
-    } else {
-        let diff_output = Command::new("diff")
-            .arg(&std_out)
-            .arg(&my_out)
-            .output()
-            .context("diff failed")?;
-
-        let diff = String::from_utf8_lossy(&diff_output.stdout).to_string();
-        TestStatus::Failed(diff)
-    };
+    let run_start = Instant::now();
+    let (my_output, my_return, timed_out) =
+        run_with_timeout(&mut run_cmd, input, Duration::from_secs(args.timeout))?;
+    let run_time = run_start.elapsed();
 
     Ok(TestResult {
         case: case.clone(),
-        status,
+        status: check_output(std_content, &my_output, my_return, timed_out),
         duration: start.elapsed(),
+        compile_time: Duration::ZERO,
+        run_time: Some(run_time),
+        binary_size: None,
     })
 }
 
+/// 比较程序的输出和返回值与 `.out` 文件
+fn check_output(std_content: &str, output: &[u8], ret: i32, timed_out: bool) -> TestStatus {
+    if timed_out {
+        return TestStatus::Timeout;
+    }
+    let mut my_content = String::from_utf8_lossy(output).to_string();
+    my_content.push_str(&format!("return: {}\n", ret));
+
+    if std_content == my_content {
+        TestStatus::Passed
+    } else {
+        TestStatus::Failed(diff_lines(std_content, &my_content))
+    }
+}
+
 fn print_result(result: &TestResult, verbose: bool) {
     let status = match &result.status {
         TestStatus::Passed => {
@@ -257,10 +522,9 @@ fn print_result(result: &TestResult, verbose: bool) {
     println!("  [{}] {}", result.case.level, status);
 }
 
-fn print_summary(results: &[TestResult], coverage: bool) {
+fn print_summary(results: &[TestResult], total_time: Duration, coverage: bool) {
     let mut passed = 0;
     let mut failed = 0;
-    let mut total_time = Duration::new(0, 0);
 
     for result in results {
         if matches!(result.status, TestStatus::Passed) {
@@ -268,7 +532,6 @@ fn print_summary(results: &[TestResult], coverage: bool) {
         } else {
             failed += 1;
         }
-        total_time += result.duration;
     }
 
     println!(
@@ -285,6 +548,197 @@ fn print_summary(results: &[TestResult], coverage: bool) {
     }
 }
 
+fn status_name(status: &TestStatus) -> &'static str {
+    match status {
+        TestStatus::Passed => "passed",
+        TestStatus::Failed(_) => "failed",
+        TestStatus::Timeout => "timeout",
+        TestStatus::CompileError(_) => "compile_error",
+    }
+}
+
+/// 写出每个用例的耗时报告
+fn write_report(results: &[TestResult], path: &Path) -> Result<()> {
+    let reports: Vec<_> = results
+        .iter()
+        .map(|result| CaseReport {
+            level: &result.case.level,
+            name: &result.case.name,
+            status: status_name(&result.status),
+            compile_ms: result.compile_time.as_secs_f64() * 1000.0,
+            run_ms: result.run_time.map(|t| t.as_secs_f64() * 1000.0),
+            binary_size: result.binary_size,
+        })
+        .collect();
+    let json = serde_json::to_string_pretty(&reports)?;
+    fs::write(path, json).with_context(|| format!("failed to write {}", path.display()))?;
+    Ok(())
+}
+
+/// 运行单个用例，使用独占的临时目录
+fn run_case(case: &TestCase, args: &Args, tmp_dir: &Path) -> TestResult {
+    let case_tmp_dir = tmp_dir.join(format!("{}-{}", case.level, case.name));
+    let result = fs::create_dir_all(&case_tmp_dir)
+        .map_err(anyhow::Error::from)
+        .and_then(|_| run_test(case, args, &case_tmp_dir, None));
+    let _ = fs::remove_dir_all(&case_tmp_dir);
+
+    match result {
+        Ok(result) => result,
+        Err(e) => {
+            eprintln!("Error running test {}: {}", case.name, e);
+            TestResult::new(
+                case,
+                TestStatus::Failed(format!("Error: {}", e)),
+                Duration::from_secs(0),
+            )
+        }
+    }
+}
+
+/// 用 `perf stat` 统计程序在用户态执行的指令数，`perf` 不可用时返回 None
+fn count_instructions(exec_path: &Path, input: &str) -> Option<u64> {
+    let mut child = Command::new("perf")
+        .args(["stat", "-x", ",", "-e", "instructions:u", "--"])
+        .arg(exec_path)
+        .stdin(Stdio::piped())
+        .stdout(Stdio::null())
+        .stderr(Stdio::piped())
+        .spawn()
+        .ok()?;
+    if let Some(mut stdin) = child.stdin.take() {
+        let _ = stdin.write_all(input.as_bytes());
+    }
+    let output = child.wait_with_output().ok()?;
+
+    // CSV 格式：`计数,单位,事件名,...`，不支持时计数为 `<not supported>`
+    let stderr = String::from_utf8_lossy(&output.stderr);
+    stderr
+        .lines()
+        .find(|line| line.contains("instructions"))
+        .and_then(|line| line.split(',').next())
+        .and_then(|count| count.trim().parse().ok())
+}
+
+/// 在一个优化级别下编译并检查用例，输出正确时再重复运行 `repeat` 次计时
+fn bench_case(case: &TestCase, args: &Args, tmp_dir: &Path, opt_level: &str) -> BenchResult {
+    let case_tmp_dir = tmp_dir.join(format!("{}-{}-{}", case.level, case.name, opt_level));
+    let result = fs::create_dir_all(&case_tmp_dir)
+        .map_err(anyhow::Error::from)
+        .and_then(|_| run_test(case, args, &case_tmp_dir, Some(opt_level)))
+        .unwrap_or_else(|e| {
+            TestResult::new(
+                case,
+                TestStatus::Failed(format!("Error: {}", e)),
+                Duration::from_secs(0),
+            )
+        });
+
+    let mut runs = Vec::new();
+    let mut instructions = None;
+    if matches!(result.status, TestStatus::Passed) {
+        let exec_path = case_tmp_dir.join(&case.name);
+        let input = fs::read_to_string(case.path.with_extension("in")).unwrap_or_default();
+        let timeout = Duration::from_secs(args.timeout);
+        for _ in 0..args.repeat {
+            let start = Instant::now();
+            match run_with_timeout(&mut Command::new(&exec_path), &input, timeout) {
+                Ok((_, _, false)) => runs.push(start.elapsed()),
+                _ => break,
+            }
+        }
+        instructions = count_instructions(&exec_path, &input);
+    }
+    let _ = fs::remove_dir_all(&case_tmp_dir);
+
+    BenchResult {
+        result,
+        opt_level: opt_level.to_string(),
+        runs,
+        instructions,
+    }
+}
+
+fn print_bench_result(bench: &BenchResult, verbose: bool) {
+    let result = &bench.result;
+    let Some(median) = bench.median() else {
+        println!("  -O {}:", bench.opt_level);
+        print_result(result, verbose);
+        return;
+    };
+
+    let instructions = bench
+        .instructions
+        .map_or_else(|| "-".to_string(), |n| n.to_string());
+    println!(
+        "  [{}] {} -O {:<10} compile {:>8.1}ms  median {:>9.2}ms  instructions {:>12}  size {:>8}",
+        result.case.level,
+        result.case.name,
+        bench.opt_level,
+        result.compile_time.as_secs_f64() * 1000.0,
+        median.as_secs_f64() * 1000.0,
+        instructions,
+        result.binary_size.unwrap_or(0)
+    );
+}
+
+fn write_bench_report(results: &[BenchResult], path: &Path) -> Result<()> {
+    let to_ms = |t: Duration| t.as_secs_f64() * 1000.0;
+    let reports: Vec<_> = results
+        .iter()
+        .map(|bench| BenchReport {
+            level: &bench.result.case.level,
+            name: &bench.result.case.name,
+            opt_level: &bench.opt_level,
+            status: status_name(&bench.result.status),
+            compile_ms: to_ms(bench.result.compile_time),
+            median_ms: bench.median().map(to_ms),
+            runs_ms: bench.runs.iter().copied().map(to_ms).collect(),
+            instructions: bench.instructions,
+            binary_size: bench.result.binary_size,
+        })
+        .collect();
+    let json = serde_json::to_string_pretty(&reports)?;
+    fs::write(path, json).with_context(|| format!("failed to write {}", path.display()))?;
+    Ok(())
+}
+
+/// 基准测试模式：依次在每个优化级别下运行用例
+///
+/// 始终串行运行，避免用例之间互相干扰计时。返回是否所有用例都通过
+fn run_bench(cases: &[TestCase], args: &Args, tmp_dir: &Path) -> Result<bool> {
+    println!(
+        "Benchmarking {} tests at -O {}, {} runs each...",
+        cases.len(),
+        args.opt_levels.join(","),
+        args.repeat
+    );
+
+    let mut results = Vec::new();
+    let mut current_level = String::new();
+    for case in cases {
+        if current_level != case.level {
+            current_level = case.level.clone();
+            println!("\n{}:", current_level);
+        }
+        for opt_level in &args.opt_levels {
+            let bench = bench_case(case, args, tmp_dir, opt_level);
+            print_bench_result(&bench, args.verbose);
+            results.push(bench);
+        }
+    }
+    println!();
+
+    if let Some(report) = &args.report {
+        write_bench_report(&results, report)?;
+        println!("Report written to {}", report.display());
+    }
+
+    Ok(results
+        .iter()
+        .all(|bench| matches!(bench.result.status, TestStatus::Passed)))
+}
+
 fn run_coverage() -> Result<()> {
     let status = Command::new("cargo")
         .args(["llvm-cov", "--workspace"])
@@ -300,55 +754,94 @@ fn run_coverage() -> Result<()> {
 
 fn main() -> Result<()> {
     let args = Args::parse();
-    let cases = collect_test_cases(&args.test_dir, &args.exclude)?;
+    let mut cases = collect_test_cases(&args.test_dir, &args.exclude)?;
+
+    if let Some(shard) = args.shard {
+        cases = cases
+            .into_iter()
+            .enumerate()
+            .filter(|(index, _)| index % shard.count == shard.index)
+            .map(|(_, case)| case)
+            .collect();
+    }
 
     if cases.is_empty() {
         println!("No test cases found");
         return Ok(());
     }
 
-    println!("Running {} tests...\n", cases.len());
-
-    let tmp_dir = std::env::temp_dir().join("airyc-test");
+    // 每个测试进程使用独立的临时目录，可以同时运行多个测试进程
+    let tmp_dir = std::env::temp_dir().join(format!("airyc-test-{}", std::process::id()));
     fs::create_dir_all(&tmp_dir)?;
 
-    let mut results = Vec::new();
+    if args.bench {
+        let passed = run_bench(&cases, &args, &tmp_dir);
+        let _ = fs::remove_dir_all(&tmp_dir);
+        if !passed? {
+            std::process::exit(1);
+        }
+        return Ok(());
+    }
+
+    let jobs = match args.jobs {
+        0 => thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n,
+    }
+    .min(cases.len());
+
+    println!("Running {} tests with {} jobs...\n", cases.len(), jobs);
+
+    let start = Instant::now();
+    let mut results: Vec<Option<TestResult>> = (0..cases.len()).map(|_| None).collect();
+    let mut printed = 0;
     let mut current_level = String::new();
 
-    for (index, case) in cases.iter().enumerate() {
-        if current_level != case.level {
-            current_level = case.level.clone();
-            println!("\n{}:", current_level);
+    // 工作线程按顺序领取用例，结果按原顺序输出
+    let next = AtomicUsize::new(0);
+    let (sender, receiver) = mpsc::channel();
+    thread::scope(|scope| {
+        for _ in 0..jobs {
+            let sender = sender.clone();
+            let (next, cases, args, tmp_dir) = (&next, &cases, &args, &tmp_dir);
+            scope.spawn(move || {
+                loop {
+                    let index = next.fetch_add(1, Ordering::Relaxed);
+                    let Some(case) = cases.get(index) else {
+                        break;
+                    };
+                    if sender.send((index, run_case(case, args, tmp_dir))).is_err() {
+                        break;
+                    }
+                }
+            });
         }
+        drop(sender);
 
-        let case_tmp_dir = tmp_dir.join(&case.name);
-        fs::create_dir_all(&case_tmp_dir)?;
-
-        let result = match run_test(case, &args, &case_tmp_dir) {
-            Ok(result) => result,
-            Err(e) => {
-                eprintln!("Error running test {}: {}", case.name, e);
-                TestResult {
-                    case: case.clone(),
-                    status: TestStatus::Failed(format!("Error: {}", e)),
-                    duration: Duration::from_secs(0),
+        for (index, result) in receiver {
+            results[index] = Some(result);
+
+            while let Some(Some(result)) = results.get(printed) {
+                if current_level != result.case.level {
+                    current_level = result.case.level.clone();
+                    println!("\n{}:", current_level);
                 }
+                print_result(result, args.verbose);
+                printed += 1;
             }
-        };
-
-        print_result(&result, args.verbose);
-        results.push(result);
-
-        let _ = fs::remove_dir_all(&case_tmp_dir);
+        }
+    });
 
-        let progress = index + 1;
-        print!("  [{}/{}]\r", progress, cases.len());
-        io::stdout().flush()?;
-    }
+    let _ = fs::remove_dir_all(&tmp_dir);
+    let results: Vec<TestResult> = results.into_iter().flatten().collect();
 
     println!();
 
-    print_summary(&results, args.coverage);
+    print_summary(&results, start.elapsed(), args.coverage);
+
+    if let Some(report) = &args.report {
+        write_report(&results, report)?;
+        println!("Report written to {}", report.display());
+    }
 
     if args.coverage {
         run_coverage()?;
@@ -0,0 +1,58 @@
+//! 基准测试共用的合成项目：N 个模块组成一条导入链，每个模块调用上一个模块的函数
+
+use std::path::PathBuf;
+
+use vfs::Vfs;
+
+const FUNCTIONS_PER_MODULE: usize = 5;
+
+/// 第 `index` 个模块的源码，导入并调用第 `index - 1` 个模块
+fn module_source(index: usize) -> String {
+    let mut text = String::new();
+    if index > 0 {
+        text.push_str(&format!("import \"m{}.airy\"\n", index - 1));
+    }
+    for j in 0..FUNCTIONS_PER_MODULE {
+        let call = match index {
+            0 => "0".to_string(),
+            _ => format!("m{}_f{}(a - 1, b)", index - 1, j),
+        };
+        text.push_str(&format!(
+            r#"
+struct P{index}_{j} {{ x: i32, y: i32 }}
+
+fn m{index}_f{j}(a: i32, b: *mut i32) -> i32 {{
+    let arr: [i32; 16] = {{1, 2, 3, {j}}};
+    let p: struct P{index}_{j} = {{a, {j}}};
+    let sum: i32 = p.x * p.y;
+    let k: i32 = 0;
+    while (k < 16) {{
+        if (arr[k] % 2 == 0 && a > k) {{
+            sum = sum + arr[k] * a;
+        }} else {{
+            sum = sum - b[k % 4];
+        }}
+        k = k + 1;
+    }}
+    return sum + {call};
+}}
+"#
+        ));
+    }
+    text
+}
+
+/// 把 `modules` 个模块写入临时目录（import 按磁盘路径解析）并加入 vfs
+pub fn setup_project(modules: usize) -> (Vfs, PathBuf) {
+    let dir = std::env::temp_dir().join(format!("airyc-bench-{}-{}", modules, std::process::id()));
+    std::fs::create_dir_all(&dir).unwrap();
+
+    let vfs = Vfs::default();
+    for index in 0..modules {
+        let text = module_source(index);
+        let path = dir.join(format!("m{}.airy", index));
+        std::fs::write(&path, &text).unwrap();
+        vfs.new_file(path.canonicalize().unwrap(), text);
+    }
+    (vfs, dir)
+}
@@ -0,0 +1,95 @@
+//! 全量分析的堆内存：峰值、分析完成后仍在使用的字节数，以及模块与 `ThinModule` 不共享
+//! 符号 arena 时（每个模块的符号复制一份到元数据中）多出的字节数
+//!
+//! 不是计时基准，直接运行并打印结果：`cargo bench -p analyzer --bench memory`
+
+mod common;
+
+use std::{
+    alloc::{GlobalAlloc, Layout, System},
+    sync::{
+        Arc,
+        atomic::{AtomicUsize, Ordering},
+    },
+};
+
+use analyzer::{checker::RecursiveTypeChecker, module::ThinModule, project::Project};
+
+use common::setup_project;
+
+/// 统计当前和峰值堆内存的分配器
+struct CountingAlloc;
+
+static CURRENT: AtomicUsize = AtomicUsize::new(0);
+static PEAK: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAlloc {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        let ptr = unsafe { System.alloc(layout) };
+        if !ptr.is_null() {
+            let current = CURRENT.fetch_add(layout.size(), Ordering::Relaxed) + layout.size();
+            PEAK.fetch_max(current, Ordering::Relaxed);
+        }
+        ptr
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        unsafe { System.dealloc(ptr, layout) };
+        CURRENT.fetch_sub(layout.size(), Ordering::Relaxed);
+    }
+}
+
+#[global_allocator]
+static ALLOC: CountingAlloc = CountingAlloc;
+
+/// 复制每个模块的符号 arena，即共享之前 `ThinModule::new` 的行为
+fn unshared_metadata(project: &Project) -> Vec<ThinModule> {
+    project
+        .metadata
+        .values()
+        .map(|thin| ThinModule {
+            functions: Arc::new((*thin.functions).clone()),
+            structs: Arc::new((*thin.structs).clone()),
+            fields: Arc::new((*thin.fields).clone()),
+            constants: Arc::new((*thin.constants).clone()),
+        })
+        .collect()
+}
+
+fn mib(bytes: usize) -> f64 {
+    bytes as f64 / (1024.0 * 1024.0)
+}
+
+fn main() {
+    println!(
+        "{:>8} {:>12} {:>12} {:>12} {:>12}",
+        "modules", "peak MiB", "live MiB", "unshared MiB", "saved"
+    );
+    for modules in [100, 1000, 5000] {
+        let (vfs, dir) = setup_project(modules);
+
+        let base = CURRENT.load(Ordering::Relaxed);
+        PEAK.store(base, Ordering::Relaxed);
+        let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
+        project.full_initialize(&vfs);
+        let peak = PEAK.load(Ordering::Relaxed) - base;
+        let live = CURRENT.load(Ordering::Relaxed) - base;
+
+        // 不共享时元数据持有自己的一份符号
+        let copies = unshared_metadata(&project);
+        let unshared = CURRENT.load(Ordering::Relaxed) - base;
+        drop(copies);
+
+        println!(
+            "{:>8} {:>12.2} {:>12.2} {:>12.2} {:>11.1}%",
+            modules,
+            mib(peak),
+            mib(live),
+            mib(unshared),
+            100.0 * (unshared - live) as f64 / unshared as f64
+        );
+
+        drop(project);
+        let _ = std::fs::remove_dir_all(dir);
+    }
+}
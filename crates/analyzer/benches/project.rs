@@ -0,0 +1,41 @@
+//! 合成项目的全量分析：N 个模块组成一条导入链，每个模块调用上一个模块的函数
+
+mod common;
+
+use analyzer::{checker::RecursiveTypeChecker, project::Project};
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+
+use common::setup_project;
+
+fn bench_full_initialize(c: &mut Criterion) {
+    let mut group = c.benchmark_group("full_initialize");
+    group.sample_size(10);
+    for modules in [10, 100, 1000] {
+        let (vfs, dir) = setup_project(modules);
+
+        // 确认合成项目没有错误，避免测到错误处理路径
+        let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
+        project.full_initialize(&vfs);
+        assert!(
+            project
+                .modules
+                .values()
+                .all(|module| module.semantic_errors.is_empty())
+        );
+
+        group.throughput(Throughput::Elements(modules as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(modules), &vfs, |b, vfs| {
+            b.iter(|| {
+                let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
+                project.full_initialize(vfs);
+                project
+            })
+        });
+
+        let _ = std::fs::remove_dir_all(dir);
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_full_initialize);
+criterion_main!(benches);
@@ -158,7 +158,7 @@ impl DeclVisitor for Module {
             };
             if var_type.is_array() {
                 let (array_tree, is_const_list) =
-                    match ArrayTree::new(self, &var_type, init_val_node) {
+                    match ArrayTree::new(self, &var_type, init_val_node.clone()) {
                         Ok(s) => s,
                         Err(e) => {
                             self.new_error(AnalyzeError::ArrayError {
@@ -169,10 +169,10 @@ impl DeclVisitor for Module {
                         }
                     };
                 if is_const_list {
-                    self.value_table
-                        .insert(init_range, Value::Array(array_tree.clone()));
+                    self.insert_const_array(&init_val_node, &var_type, array_tree);
+                } else {
+                    self.expand_array.insert(init_range, array_tree);
                 }
-                self.expand_array.insert(init_range, array_tree);
             } else if var_type.is_struct() {
                 let struct_id = var_type.as_struct_id().unwrap();
                 match self.process_struct_init_value(struct_id, init_val_node) {
@@ -237,6 +237,25 @@ impl DeclVisitor for Module {
             return;
         }
 
+        // 全局常量的类型和值写入导出符号，供导入它的模块使用
+        if is_global
+            && is_const
+            && let Some(const_id) = self.get_constant_id_by_name(&var_name)
+            && const_id.module == self.file_id
+        {
+            let value = self
+                .value_table
+                .get(&var_range)
+                .filter(|v| v.is_portable())
+                .cloned();
+            if let Some(constant) = self.get_constant_mut_by_id(const_id)
+                && constant.range == var_range
+            {
+                constant.ty = var_type.clone();
+                constant.value = value;
+            }
+        }
+
         let scope = self.scopes.get_mut(*self.analyzing.current_scope).unwrap();
         let _ = scope.new_variable(
             &mut self.variables,
@@ -4,7 +4,6 @@ use syntax::SyntaxKind;
 use syntax::ast::*;
 use syntax::visitor::ExprVisitor;
 
-use crate::array::ArrayTreeValue;
 use crate::error::AnalyzeError;
 use crate::module::{Module, ReferenceTag};
 use crate::r#type::{Ty, UnaryOpError};
@@ -289,8 +288,14 @@ impl ExprVisitor for Module {
             return;
         };
 
-        // 查找变量定义
+        // 查找变量定义，局部变量和本模块的全局变量遮蔽导入的常量
         let Some(var_id) = self.find_variable_def(&var_name) else {
+            if let Some(const_id) = self.get_constant_id_by_name(&var_name)
+                && const_id.module != self.file_id
+            {
+                self.leave_imported_constant(node, var_range, const_id);
+                return;
+            }
             self.new_error(AnalyzeError::VariableUndefined {
                 name: var_name.to_string(),
                 range: var_range,
@@ -321,59 +326,17 @@ impl ExprVisitor for Module {
         if !is_const {
             return;
         }
-        let Some(mut value) = self.value_table.get(&var_range) else {
+        let Some(value) = self.value_table.get(&var_range) else {
             return;
         };
 
-        if let Value::Array(tree) = value {
-            let mut indices = Vec::new();
-            for indice in node.indices() {
-                let range = indice.text_range();
-                let Some(v) = self.get_value_by_range(range) else {
-                    return;
-                };
-
-                let Some(index) = v.get_array_size() else {
-                    self.new_error(AnalyzeError::TypeMismatch {
-                        expected: Ty::I32,
-                        found: v.get_type(self),
-                        range: utils::trim_node_text_range(&indice),
-                    });
-                    return;
-                };
-                indices.push(index);
+        match self.index_const_value(&node, value, const_zero) {
+            Ok(Some(value)) => {
+                self.value_table.insert(node.text_range(), value);
             }
-            let leaf = match tree.get_leaf(&indices) {
-                Ok(s) => s,
-                Err(e) => {
-                    self.new_error(AnalyzeError::ArrayError {
-                        message: Box::new(e),
-                        range: utils::trim_node_text_range(&node),
-                    });
-                    return;
-                }
-            };
-            value = match leaf {
-                ArrayTreeValue::Expr(expr_range) => {
-                    let Some(v) = self.value_table.get(&expr_range) else {
-                        return;
-                    };
-                    v
-                }
-                ArrayTreeValue::Struct {
-                    init_list: init_val_node_range,
-                    ..
-                } => {
-                    let Some(v) = self.value_table.get(&init_val_node_range) else {
-                        return;
-                    };
-                    v
-                }
-                ArrayTreeValue::Empty => &const_zero,
-            };
+            Ok(None) => {}
+            Err(e) => self.new_error(e),
         }
-        let range = node.text_range();
-        self.value_table.insert(range, value.clone());
     }
 
     fn leave_postfix_expr(&mut self, node: PostfixExpr) {
@@ -480,7 +443,7 @@ impl ExprVisitor for Module {
             {
                 if indices.is_empty() {
                     self.value_table.insert(range, field_value.clone());
-                } else if let Value::Array(tree) = field_value {
+                } else if let Value::Array(_) | Value::FlatArray(_) = field_value {
                     // 处理数组索引
                     let mut idx_values = Vec::new();
                     for idx_expr in field_access_node.indices() {
@@ -492,10 +455,16 @@ impl ExprVisitor for Module {
                         };
                         idx_values.push(idx);
                     }
-                    if let Ok(leaf) = tree.get_leaf(&idx_values)
-                        && let Some(v) = leaf.get_const_value(&self.value_table)
-                    {
-                        self.value_table.insert(range, v.clone());
+                    let leaf = match field_value {
+                        Value::FlatArray(flat) => flat.get(&idx_values).ok(),
+                        Value::Array(tree) => tree
+                            .get_leaf(&idx_values)
+                            .ok()
+                            .and_then(|leaf| leaf.get_const_value(&self.value_table).cloned()),
+                        _ => unreachable!(),
+                    };
+                    if let Some(v) = leaf {
+                        self.value_table.insert(range, v);
                     }
                 }
             }
@@ -3,6 +3,7 @@
 use syntax::visitor::FuncVisitor;
 
 use syntax::ast::*;
+use tools::Name;
 
 use crate::error::AnalyzeError;
 use crate::module::Module;
@@ -87,7 +88,7 @@ impl FuncVisitor for Module {
             .and_then(|x| x.block())
             .is_some();
 
-        if let Some(&func_id) = self.function_map.get(&name) {
+        if let Some(func_id) = self.get_function_id_by_name(&name) {
             // 更新现有的 Function，填充参数
             if let Some(func_data) = self.get_function_mut_by_id(func_id) {
                 func_data.params = param_list;
@@ -178,7 +179,7 @@ impl FuncVisitor for Module {
             return;
         }
 
-        let Some(func) = self.functions.get_mut(func_id.index) else {
+        let Some(func) = self.get_function_mut_by_id(func_id) else {
             return;
         };
 
@@ -194,7 +195,7 @@ impl FuncVisitor for Module {
 
         let scope = self.scopes.get_mut(*self.analyzing.current_scope).unwrap();
         for (var_id, var_name) in func.params.iter().zip(func.meta_types.iter().map(|f| &f.0)) {
-            scope.variables.insert(var_name.clone(), *var_id);
+            scope.variables.insert(Name::new(var_name), *var_id);
         }
 
         self.analyzing.current_function_ret_type = Some(func.ret_type.clone());
@@ -1,13 +1,11 @@
 #![allow(unused_assignments)] // FIXME: https://github.com/zkat/miette/pull/459
 //! array 的初始化
 
-use std::collections::HashMap;
-
 use miette::Diagnostic;
 use syntax::ast::{Expr, InitVal};
 use syntax::{AirycLanguage, AstNode};
 use thiserror::Error;
-use tools::TextRange;
+use tools::{TextRange, hash::FxHashMap};
 
 use crate::{
     error::AnalyzeError,
@@ -16,7 +14,7 @@ use crate::{
     value::Value,
 };
 
-#[derive(Clone, Debug, PartialEq)]
+#[derive(Clone, Debug, PartialEq, Hash)]
 pub enum ArrayTreeValue {
     Expr(TextRange),
     Struct {
@@ -29,7 +27,7 @@ pub enum ArrayTreeValue {
 impl ArrayTreeValue {
     pub fn get_const_value<'a>(
         &self,
-        value_table: &'a HashMap<TextRange, Value>,
+        value_table: &'a FxHashMap<TextRange, Value>,
     ) -> Option<&'a Value> {
         match self {
             Self::Expr(r) => value_table.get(r),
@@ -39,12 +37,237 @@ impl ArrayTreeValue {
     }
 }
 
-#[derive(Clone, PartialEq, Debug)]
+#[derive(Clone, PartialEq, Debug, Hash)]
 pub enum ArrayTree {
     Children(Vec<ArrayTree>),
     Val(ArrayTreeValue),
 }
 
+/// 整数或布尔数组常量的扁平表示
+///
+/// 元素按行优先顺序编号，只保存非零段，段之外的元素都是零。`[[i32; 256]; 256]` 这样的
+/// 查找表只占连续的缓冲区，取值和生成 LLVM 常量都不需要逐个叶子查常量表
+#[derive(Clone, PartialEq, Debug, Hash)]
+pub struct FlatArray {
+    /// 各维长度，最外层在前
+    pub shape: Vec<u32>,
+    /// 元素类型，只能是整数或布尔类型
+    pub elem: Ty,
+    /// 非零段，按起始下标递增且互不重叠
+    runs: Vec<FlatRun>,
+}
+
+#[derive(Clone, PartialEq, Debug, Hash)]
+struct FlatRun {
+    start: usize,
+    /// 元素的位模式，有符号数按符号扩展保存
+    data: Vec<u64>,
+}
+
+impl FlatRun {
+    fn end(&self) -> usize {
+        self.start + self.data.len()
+    }
+}
+
+impl FlatArray {
+    /// 两个非零元素之间至少有这么多个零时才分段，避免段过碎
+    const MIN_ZERO_GAP: usize = 8;
+
+    /// 从常量初始化列表构建，元素不是整数或布尔值时返回 `None`
+    pub fn new(
+        tree: &ArrayTree,
+        ty: &Ty,
+        value_table: &FxHashMap<TextRange, Value>,
+    ) -> Option<Self> {
+        let mut shape = Vec::new();
+        let mut elem = ty;
+        loop {
+            match elem {
+                Ty::Const(inner) => elem = inner.as_ref(),
+                Ty::Array(inner, Some(count)) => {
+                    shape.push(u32::try_from(*count).ok()?);
+                    elem = inner.as_ref();
+                }
+                _ => break,
+            }
+        }
+        let is_scalar = matches!(
+            elem,
+            Ty::I32 | Ty::I8 | Ty::U8 | Ty::U32 | Ty::I64 | Ty::U64 | Ty::Bool
+        );
+        if shape.is_empty() || !is_scalar {
+            return None;
+        }
+
+        let mut flat = Self {
+            shape,
+            elem: elem.clone(),
+            runs: Vec::new(),
+        };
+        flat.collect(tree, 0, 0, value_table)?;
+        Some(flat)
+    }
+
+    /// 由 [`FlatArray::nonzeros`] 的结果还原
+    ///
+    /// 下标必须严格递增且不越界，元素类型必须是整数或布尔类型，否则返回 `None`
+    pub fn from_nonzeros(
+        shape: Vec<u32>,
+        elem: Ty,
+        nonzeros: impl IntoIterator<Item = (usize, u64)>,
+    ) -> Option<Self> {
+        let is_scalar = matches!(
+            elem,
+            Ty::I32 | Ty::I8 | Ty::U8 | Ty::U32 | Ty::I64 | Ty::U64 | Ty::Bool
+        );
+        if shape.is_empty() || !is_scalar {
+            return None;
+        }
+
+        let mut flat = Self {
+            shape,
+            elem,
+            runs: Vec::new(),
+        };
+        let len = flat.len();
+        let mut next = 0;
+        for (offset, bits) in nonzeros {
+            if offset < next || offset >= len {
+                return None;
+            }
+            flat.push(offset, bits);
+            next = offset + 1;
+        }
+        Some(flat)
+    }
+
+    /// 元素总数
+    pub fn len(&self) -> usize {
+        self.stride(0) * self.shape.first().map_or(0, |&n| n as usize)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 第 `dim` 维下标加一时跨过的元素个数
+    pub fn stride(&self, dim: usize) -> usize {
+        self.shape[dim + 1..].iter().map(|&n| n as usize).product()
+    }
+
+    /// 按下标取元素，与 [`ArrayTree::get_leaf`] 一致，越界的元素视为零
+    pub fn get(&self, indices: &[i32]) -> Result<Value, ArrayInitError> {
+        if indices.len() != self.shape.len() {
+            return Err(ArrayInitError::MisMatchIndexAndType);
+        }
+        let mut offset = 0;
+        for (dim, (&index, &len)) in indices.iter().zip(&self.shape).enumerate() {
+            match u32::try_from(index) {
+                Ok(index) if index < len => offset += index as usize * self.stride(dim),
+                _ => return Ok(self.value_of(0)),
+            }
+        }
+        Ok(self.value_of(self.row(offset, 1)[0]))
+    }
+
+    /// `[start, start + len)` 范围内的元素是否都是零
+    pub fn is_zero(&self, start: usize, len: usize) -> bool {
+        let first = self.runs.partition_point(|run| run.end() <= start);
+        self.runs
+            .get(first)
+            .is_none_or(|run| run.start >= start + len)
+    }
+
+    /// `[start, start + len)` 范围内元素的位模式
+    pub fn row(&self, start: usize, len: usize) -> Vec<u64> {
+        let end = start + len;
+        let mut row = vec![0; len];
+        let first = self.runs.partition_point(|run| run.end() <= start);
+        for run in self.runs[first..].iter().take_while(|run| run.start < end) {
+            let (from, to) = (run.start.max(start), run.end().min(end));
+            row[from - start..to - start]
+                .copy_from_slice(&run.data[from - run.start..to - run.start]);
+        }
+        row
+    }
+
+    /// 非零元素的下标和位模式，按下标递增
+    pub fn nonzeros(&self) -> impl Iterator<Item = (usize, u64)> + '_ {
+        self.runs.iter().flat_map(|run| {
+            (run.start..)
+                .zip(run.data.iter().copied())
+                .filter(|&(_, bits)| bits != 0)
+        })
+    }
+
+    /// 把位模式还原为元素类型的值
+    pub fn value_of(&self, bits: u64) -> Value {
+        match self.elem {
+            Ty::I32 => Value::I32(bits as i32),
+            Ty::I8 => Value::I8(bits as i8),
+            Ty::U8 => Value::U8(bits as u8),
+            Ty::U32 => Value::U32(bits as u32),
+            Ty::I64 => Value::I64(bits as i64),
+            Ty::U64 => Value::U64(bits),
+            Ty::Bool => Value::Bool(bits != 0),
+            _ => unreachable!("flat array element must be an integer or bool"),
+        }
+    }
+
+    /// 按行优先顺序收集叶子，`offset` 是当前子树第一个元素的下标
+    fn collect(
+        &mut self,
+        tree: &ArrayTree,
+        dim: usize,
+        offset: usize,
+        value_table: &FxHashMap<TextRange, Value>,
+    ) -> Option<()> {
+        match tree {
+            ArrayTree::Children(children) => {
+                let len = *self.shape.get(dim)? as usize;
+                let stride = self.stride(dim);
+                for (i, child) in children.iter().take(len).enumerate() {
+                    self.collect(child, dim + 1, offset + i * stride, value_table)?;
+                }
+            }
+            ArrayTree::Val(ArrayTreeValue::Empty) => {}
+            ArrayTree::Val(ArrayTreeValue::Expr(range)) if dim == self.shape.len() => {
+                let bits = match *value_table.get(range)? {
+                    Value::I32(v) => v as i64 as u64,
+                    Value::I8(v) => v as i64 as u64,
+                    Value::U8(v) => v as u64,
+                    Value::U32(v) => v as u64,
+                    Value::I64(v) => v as u64,
+                    Value::U64(v) => v,
+                    Value::Bool(v) => v as u64,
+                    _ => return None,
+                };
+                self.push(offset, bits);
+            }
+            ArrayTree::Val(_) => return None,
+        }
+        Some(())
+    }
+
+    /// 追加下标为 `offset` 的元素，下标必须递增
+    fn push(&mut self, offset: usize, bits: u64) {
+        if bits == 0 {
+            return;
+        }
+        match self.runs.last_mut() {
+            Some(run) if offset - run.end() < Self::MIN_ZERO_GAP => {
+                run.data.resize(offset - run.start, 0);
+                run.data.push(bits);
+            }
+            _ => self.runs.push(FlatRun {
+                start: offset,
+                data: vec![bits],
+            }),
+        }
+    }
+}
+
 pub trait ArrayTreeTrait: AstNode<Language = AirycLanguage> + Sized {
     /// Node -> Expr
     fn try_expr(&self) -> Option<ArrayTreeValue>;
@@ -0,0 +1,27 @@
+//! 取消正在进行的分析
+//!
+//! 语言服务器收到新的修改后取消还在进行的分析。取消只在模块之间检查：已经开始的模块会分析完，
+//! 剩下的模块跳过，由 [`Project`](crate::project::Project) 记录下来，下一次更新时重新分析
+
+use std::sync::{
+    Arc,
+    atomic::{AtomicBool, Ordering},
+};
+
+/// 可以从其他线程触发的取消标记，复制出的标记共享状态，触发后不能复位
+#[derive(Debug, Clone, Default)]
+pub struct CancelToken(Arc<AtomicBool>);
+
+impl CancelToken {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn cancel(&self) {
+        self.0.store(true, Ordering::Relaxed);
+    }
+
+    pub fn is_cancelled(&self) -> bool {
+        self.0.load(Ordering::Relaxed)
+    }
+}
@@ -2,7 +2,10 @@
 
 mod recursive_type;
 
-use std::{collections::HashMap, fmt::Debug};
+use std::{
+    collections::{HashMap, HashSet},
+    fmt::Debug,
+};
 
 use vfs::FileID;
 
@@ -11,9 +14,24 @@ use crate::{error::AnalyzeError, module::Module};
 pub use recursive_type::RecursiveTypeChecker;
 
 /// Project 级别的检查
+///
+/// 不同的 checker 互相独立，在各自的线程上并行运行
 pub trait ProjectChecker: Send + Sync + Debug {
+    /// 检查是否关心这个模块的变化
+    ///
+    /// 增量更新时只把关心的模块交给 [`ProjectChecker::check_project`]，没有关心的模块发生变化时
+    /// 跳过本次检查。上次为其产生过错误的模块必须返回 true。默认关心所有模块
+    fn needs_module(&self, _module: &Module) -> bool {
+        true
+    }
+
+    /// `changed` 为上次检查之后重新分析过的模块，为 None 时检查整个项目
+    ///
+    /// 返回的模块的错误替换该 checker 上次为这些模块产生的错误，其余模块保持不变。
+    /// 重新分析过的模块没有保留之前的错误，返回值必须包含 `changed` 中所有有错误的模块
     fn check_project(
         &mut self,
         modules: &HashMap<FileID, Module>,
+        changed: Option<&HashSet<FileID>>,
     ) -> HashMap<FileID, Vec<AnalyzeError>>;
 }
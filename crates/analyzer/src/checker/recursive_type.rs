@@ -1,10 +1,31 @@
-use std::collections::{HashMap, HashSet};
+use std::collections::{BTreeMap, HashMap, HashSet};
 
-use crate::{checker::ProjectChecker, error::AnalyzeError, module::StructID, r#type::Ty};
+use vfs::FileID;
 
+use crate::{
+    checker::ProjectChecker,
+    error::AnalyzeError,
+    module::{Module, StructID},
+    r#type::Ty,
+};
+
+/// 检查结构体之间按值嵌套形成的环
+///
+/// 结构体是图的节点，字段（穿过 const 和数组）按值包含另一个结构体时连一条边，指针不连边。
+/// 强连通分量的大小大于 1 或者有自环时就是递归类型。
+///
+/// 增量检查时只重建变化模块的边：环内的边都没有变化的强连通分量保持不变，只需从边发生
+/// 变化的节点和失效的环上的节点重新运行 Tarjan 算法
 #[derive(Debug, Default)]
 pub struct RecursiveTypeChecker {
     pub edge: HashMap<StructID, Vec<StructID>>,
+    /// 每个模块中有出边的节点
+    nodes: HashMap<FileID, Vec<StructID>>,
+    /// 当前所有的环，按发现顺序编号，生成错误时按编号排序
+    cycles: BTreeMap<usize, Vec<StructID>>,
+    /// 节点所在的环
+    cycle_of: HashMap<StructID, usize>,
+    next_cycle: usize,
 
     dfn: HashMap<StructID, usize>,
     low: HashMap<StructID, usize>,
@@ -14,59 +35,164 @@ pub struct RecursiveTypeChecker {
 }
 
 impl ProjectChecker for RecursiveTypeChecker {
+    fn needs_module(&self, module: &Module) -> bool {
+        !module.structs.is_empty() || self.nodes.contains_key(&module.file_id)
+    }
+
     fn check_project(
         &mut self,
-        modules: &HashMap<vfs::FileID, crate::module::Module>,
-    ) -> HashMap<vfs::FileID, Vec<AnalyzeError>> {
-        // 构建图
-        self.build_graph(modules);
+        modules: &HashMap<FileID, Module>,
+        changed: Option<&HashSet<FileID>>,
+    ) -> HashMap<FileID, Vec<AnalyzeError>> {
+        let changed: HashSet<FileID> = match changed {
+            Some(changed) => changed.clone(),
+            None => {
+                self.edge.clear();
+                self.nodes.clear();
+                self.cycles.clear();
+                self.cycle_of.clear();
+                modules.keys().copied().collect()
+            }
+        };
+
+        // 重建变化模块的边，得到出边发生变化的节点
+        let changed_nodes = self.update_graph(modules, &changed);
+
+        // 包含变化节点的环失效；其余涉及变化模块的环保持不变，但错误中的名字需要重新生成
+        let mut affected = changed.clone();
+        let mut roots = changed_nodes.clone();
+        let stale: Vec<usize> = self
+            .cycles
+            .iter()
+            .filter(|(_, scc)| scc.iter().any(|u| changed_nodes.contains(u)))
+            .map(|(id, _)| *id)
+            .collect();
+        for id in stale {
+            let scc = self.remove_cycle(id);
+            affected.extend(scc.iter().map(|u| u.module));
+            roots.extend(scc);
+        }
+        for scc in self.cycles.values() {
+            if scc.iter().any(|u| changed.contains(&u.module)) {
+                affected.extend(scc.iter().map(|u| u.module));
+            }
+        }
 
-        // 使用 Tarjan 算法找出所有强连通分量
-        let sccs = self.tarjan();
+        // 使用 Tarjan 算法找出从这些节点可达的强连通分量
+        for scc in self.tarjan(roots) {
+            let overlapping: HashSet<usize> = scc
+                .iter()
+                .filter_map(|u| self.cycle_of.get(u).copied())
+                .collect();
+            for id in overlapping {
+                let old = self.remove_cycle(id);
+                affected.extend(old.iter().map(|u| u.module));
+            }
+            affected.extend(scc.iter().map(|u| u.module));
+            self.insert_cycle(scc);
+        }
 
         // 生成错误信息
-        self.generate_errors(sccs, modules)
+        self.generate_errors(&affected, modules)
     }
 }
 
 impl RecursiveTypeChecker {
-    fn build_graph(&mut self, modules: &HashMap<vfs::FileID, crate::module::Module>) {
-        self.edge.clear();
-
-        for (file_id, module) in modules {
-            for (sc_id, sc) in module.structs.iter() {
-                let from = StructID::new(*file_id, sc_id);
-                let mut targets = Vec::new();
-
-                for field_id in &sc.fields {
-                    let Some(field) = module.get_field_by_id(*field_id) else {
-                        continue;
-                    };
-
-                    let mut ty = &field.ty;
-                    let to = loop {
-                        match ty {
-                            Ty::Const(inner) => ty = inner,
-                            Ty::Pointer { .. } => break None,
-                            Ty::Struct { id, .. } => break Some(id),
-                            Ty::Array(inner, _) => ty = inner,
-                            _ => break None,
-                        }
-                    };
-
-                    if let Some(to) = to {
-                        targets.push(*to);
-                    }
+    /// 重建 `changed` 中模块的出边，返回出边发生变化（包括新增和删除）的节点
+    fn update_graph(
+        &mut self,
+        modules: &HashMap<FileID, Module>,
+        changed: &HashSet<FileID>,
+    ) -> HashSet<StructID> {
+        let mut changed_nodes = HashSet::new();
+
+        for file_id in changed {
+            let mut old_edges: HashMap<StructID, Vec<StructID>> = HashMap::new();
+            for u in self.nodes.remove(file_id).unwrap_or_default() {
+                if let Some(targets) = self.edge.remove(&u) {
+                    old_edges.insert(u, targets);
                 }
+            }
 
-                if !targets.is_empty() {
+            let mut nodes = Vec::new();
+            if let Some(module) = modules.get(file_id) {
+                for (from, targets) in Self::struct_edges(*file_id, module) {
+                    if old_edges.remove(&from).as_ref() != Some(&targets) {
+                        changed_nodes.insert(from);
+                    }
+                    nodes.push(from);
                     self.edge.insert(from, targets);
                 }
             }
+            // 剩下的是失去所有出边的节点
+            changed_nodes.extend(old_edges.into_keys());
+
+            if !nodes.is_empty() {
+                self.nodes.insert(*file_id, nodes);
+            }
+        }
+
+        changed_nodes
+    }
+
+    /// 模块中每个有出边的结构体及其按值包含的结构体
+    fn struct_edges(file_id: FileID, module: &Module) -> Vec<(StructID, Vec<StructID>)> {
+        let mut edges = Vec::new();
+
+        for (sc_id, sc) in module.structs.iter() {
+            let from = StructID::new(file_id, sc_id);
+            let mut targets = Vec::new();
+
+            for field_id in &sc.fields {
+                let Some(field) = module.get_field_by_id(*field_id) else {
+                    continue;
+                };
+
+                let mut ty = &field.ty;
+                let to = loop {
+                    match ty {
+                        Ty::Const(inner) => ty = inner,
+                        Ty::Pointer { .. } => break None,
+                        Ty::Struct { id, .. } => break Some(id),
+                        Ty::Array(inner, _) => ty = inner,
+                        _ => break None,
+                    }
+                };
+
+                if let Some(to) = to {
+                    targets.push(*to);
+                }
+            }
+
+            if !targets.is_empty() {
+                edges.push((from, targets));
+            }
+        }
+
+        edges
+    }
+
+    fn insert_cycle(&mut self, scc: Vec<StructID>) {
+        let id = self.next_cycle;
+        self.next_cycle += 1;
+        for u in &scc {
+            self.cycle_of.insert(*u, id);
         }
+        self.cycles.insert(id, scc);
     }
 
-    fn tarjan(&mut self) -> Vec<Vec<StructID>> {
+    fn remove_cycle(&mut self, id: usize) -> Vec<StructID> {
+        let scc = self.cycles.remove(&id).unwrap_or_default();
+        for u in &scc {
+            self.cycle_of.remove(u);
+        }
+        scc
+    }
+
+    /// 从 `roots` 出发运行 Tarjan 算法，返回其中构成环的强连通分量
+    ///
+    /// 可达的子图对后继封闭，得到的强连通分量与在整张图上运行的结果相同
+    fn tarjan(&mut self, roots: HashSet<StructID>) -> Vec<Vec<StructID>> {
         self.dfn.clear();
         self.low.clear();
         self.in_stack.clear();
@@ -74,29 +200,17 @@ impl RecursiveTypeChecker {
         self.timestamp = 0;
 
         let mut sccs = Vec::new();
-        let mut self_loop = HashSet::new();
 
-        let nodes: Vec<StructID> = self.edge.keys().copied().collect();
-
-        for node in nodes {
-            if !self.dfn.contains_key(&node) {
-                self.dfs(node, &mut sccs, &mut self_loop);
+        for node in roots {
+            if self.edge.contains_key(&node) && !self.dfn.contains_key(&node) {
+                self.dfs(node, &mut sccs);
             }
         }
 
-        for u in self_loop {
-            sccs.push(vec![u]);
-        }
-
         sccs
     }
 
-    fn dfs(
-        &mut self,
-        u: StructID,
-        sccs: &mut Vec<Vec<StructID>>,
-        self_loop: &mut HashSet<StructID>,
-    ) {
+    fn dfs(&mut self, u: StructID, sccs: &mut Vec<Vec<StructID>>) {
         self.timestamp += 1;
         self.dfn.insert(u, self.timestamp);
         self.low.insert(u, self.timestamp);
@@ -104,14 +218,15 @@ impl RecursiveTypeChecker {
         self.stack.push(u);
         self.in_stack.insert(u);
 
+        let mut self_loop = false;
         if let Some(neighbors) = self.edge.get(&u).cloned() {
             for v in neighbors {
                 if u == v {
-                    self_loop.insert(u);
+                    self_loop = true;
                 }
                 if !self.dfn.contains_key(&v) {
                     // 未访问过，递归访问
-                    self.dfs(v, sccs, self_loop);
+                    self.dfs(v, sccs);
                     // 更新 low[u]
                     let low_v = *self.low.get(&v).unwrap();
                     let low_u = self.low.get_mut(&u).unwrap();
@@ -138,23 +253,32 @@ impl RecursiveTypeChecker {
                 }
             }
 
-            if scc.len() > 1 {
+            if scc.len() > 1 || self_loop {
                 sccs.push(scc);
             }
         }
     }
 
+    /// 为 `affected` 中的模块重新生成错误，没有错误的模块返回空列表
     fn generate_errors(
         &self,
-        sccs: Vec<Vec<StructID>>,
-        modules: &HashMap<vfs::FileID, crate::module::Module>,
-    ) -> HashMap<vfs::FileID, Vec<AnalyzeError>> {
-        let mut errors: HashMap<vfs::FileID, Vec<AnalyzeError>> = HashMap::new();
+        affected: &HashSet<FileID>,
+        modules: &HashMap<FileID, Module>,
+    ) -> HashMap<FileID, Vec<AnalyzeError>> {
+        let mut errors: HashMap<FileID, Vec<AnalyzeError>> = affected
+            .iter()
+            .filter(|file_id| modules.contains_key(file_id))
+            .map(|file_id| (*file_id, Vec::new()))
+            .collect();
+
+        for scc in self.cycles.values() {
+            if !scc.iter().any(|u| errors.contains_key(&u.module)) {
+                continue;
+            }
 
-        for scc in sccs {
             // 构建环的路径（struct 名字列表）
             let mut cycle_names = Vec::new();
-            for struct_id in &scc {
+            for struct_id in scc {
                 if let Some(module) = modules.get(&struct_id.module)
                     && let Some(struct_def) = module.structs.get(struct_id.index)
                 {
@@ -168,17 +292,16 @@ impl RecursiveTypeChecker {
             }
 
             // 为环中的每个 struct 生成一个错误
-            for struct_id in &scc {
-                if let Some(module) = modules.get(&struct_id.module)
+            for struct_id in scc {
+                if let Some(errors) = errors.get_mut(&struct_id.module)
+                    && let Some(module) = modules.get(&struct_id.module)
                     && let Some(struct_def) = module.structs.get(struct_id.index)
                 {
-                    let error = AnalyzeError::RecursiveType {
+                    errors.push(AnalyzeError::RecursiveType {
                         struct_name: struct_def.name.clone(),
                         cycle: cycle_names.clone(),
                         range: struct_def.range,
-                    };
-
-                    errors.entry(struct_id.module).or_default().push(error);
+                    });
                 }
             }
         }
@@ -0,0 +1,88 @@
+//! 模块依赖图：记录 import 关系，用于跨模块的增量失效
+
+use std::collections::{HashMap, HashSet};
+
+use vfs::FileID;
+
+/// 模块间的 import 依赖图
+#[derive(Debug, Default)]
+pub struct DependencyGraph {
+    /// 模块 -> 它导入的模块
+    imports: HashMap<FileID, Vec<FileID>>,
+    /// 模块 -> 导入它的模块
+    dependents: HashMap<FileID, HashSet<FileID>>,
+}
+
+impl DependencyGraph {
+    pub fn clear(&mut self) {
+        self.imports.clear();
+        self.dependents.clear();
+    }
+
+    /// 设置模块的 import 列表，替换之前记录的边
+    pub fn set_imports(&mut self, file_id: FileID, targets: Vec<FileID>) {
+        self.remove_imports(file_id);
+        for target in &targets {
+            self.dependents.entry(*target).or_default().insert(file_id);
+        }
+        self.imports.insert(file_id, targets);
+    }
+
+    /// 删除模块作为导入方的所有边
+    pub fn remove_imports(&mut self, file_id: FileID) {
+        for target in self.imports.remove(&file_id).unwrap_or_default() {
+            if let Some(dependents) = self.dependents.get_mut(&target) {
+                dependents.remove(&file_id);
+                if dependents.is_empty() {
+                    self.dependents.remove(&target);
+                }
+            }
+        }
+    }
+
+    /// 模块直接导入的模块
+    pub fn imports_of(&self, file_id: FileID) -> &[FileID] {
+        self.imports.get(&file_id).map_or(&[], Vec::as_slice)
+    }
+
+    /// 直接导入该模块的模块
+    pub fn dependents_of(&self, file_id: FileID) -> impl Iterator<Item = FileID> + '_ {
+        self.dependents.get(&file_id).into_iter().flatten().copied()
+    }
+
+    /// 该模块直接或间接导入的所有模块（不包含自身）
+    ///
+    /// 代码生成会用到导入链上所有结构体的布局，编译结果依赖整个闭包
+    pub fn import_closure(&self, file_id: FileID) -> Vec<FileID> {
+        let mut visited = HashSet::from([file_id]);
+        let mut stack = vec![file_id];
+        let mut result = Vec::new();
+        while let Some(u) = stack.pop() {
+            for &v in self.imports_of(u) {
+                if visited.insert(v) {
+                    result.push(v);
+                    stack.push(v);
+                }
+            }
+        }
+        result
+    }
+
+    /// 直接或间接导入该模块的所有模块（不包含自身）
+    ///
+    /// 结构体字段类型会沿 import 链传递，所以接口变化需要让整个反向依赖闭包失效
+    pub fn reverse_closure(&self, file_id: FileID) -> Vec<FileID> {
+        let mut visited = HashSet::from([file_id]);
+        let mut stack = vec![file_id];
+        let mut result = Vec::new();
+        while let Some(u) = stack.pop() {
+            for v in self.dependents_of(u) {
+                if visited.insert(v) {
+                    result.push(v);
+                    stack.push(v);
+                }
+            }
+        }
+        result
+    }
+}
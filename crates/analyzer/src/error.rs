@@ -301,6 +301,16 @@ pub enum AnalyzeError {
         range: TextRange,
     },
 
+    #[error(
+        "imported constant '{name}' is not evaluated: its module has errors or imports this one"
+    )]
+    #[diagnostic(code(semantic::imported_constant_unavailable))]
+    ImportedConstantUnavailable {
+        name: String,
+        #[label("here")]
+        range: TextRange,
+    },
+
     #[error("recursive type `{struct_name}` has infinite size")]
     #[diagnostic(
         code(semantic::recursive_type),
@@ -379,6 +389,7 @@ impl AnalyzeError {
             | Self::ImportPathNotFound { range, .. }
             | Self::ImportSymbolNotFound { range, .. }
             | Self::ImportSymbolConflict { range, .. }
+            | Self::ImportedConstantUnavailable { range, .. }
             | Self::RecursiveType { range, .. }
             | Self::InitializerMismatch { range, .. }
             | Self::BinaryOpTypeMismatch { range, .. }
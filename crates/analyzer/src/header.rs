@@ -1,26 +1,30 @@
 //! 头文件分析器：解析 import 语句，导入符号
 
 use std::{
-    collections::HashMap,
+    collections::{HashMap, HashSet},
     path::{Path, PathBuf},
 };
 
-use syntax::{AstNode as _, SyntaxNode, ast::CompUnit};
-use tools::TextRange;
-use vfs::{FileID, Vfs};
+use lexer::Lexer;
+use rayon::prelude::*;
+use syntax::{AstNode as _, SyntaxKind, SyntaxNode, ast::CompUnit};
+use tools::{Name, TextRange};
+use vfs::{FileID, Vfs, VfsSnapshot, VirtulFile};
 
 use crate::{
     error::AnalyzeError,
-    module::{FunctionID, Module, StructID},
+    module::{ConstantID, FunctionID, Module, StructID, ThinModule},
 };
 
 /// 导入信息
 #[derive(Debug, Clone)]
 pub struct ImportInfo {
     /// 要导入的函数：(名称, FunctionID)
-    pub functions: Vec<(String, FunctionID)>,
+    pub functions: Vec<(Name, FunctionID)>,
     /// 要导入的结构体：(名称, StructID)
-    pub structs: Vec<(String, StructID)>,
+    pub structs: Vec<(Name, StructID)>,
+    /// 要导入的全局常量：(名称, ConstantID)
+    pub constants: Vec<(Name, ConstantID)>,
 }
 
 /// 单个模块的所有导入信息
@@ -28,6 +32,8 @@ pub struct ImportInfo {
 pub struct ModuleImports {
     pub file_id: FileID,
     pub imports: Vec<(ImportInfo, TextRange)>,
+    /// 成功解析路径的导入目标模块（去重）
+    pub targets: Vec<FileID>,
     pub errors: Vec<AnalyzeError>,
 }
 
@@ -36,13 +42,17 @@ pub struct HeaderAnalyzer;
 
 impl HeaderAnalyzer {
     /// 收集单个模块的导入信息
+    ///
+    /// 导入目标不在 `modules` 中时，从 `cached` 中缓存的元数据收集符号
     pub fn collect_module_imports(
         module: &Module,
         current_file_id: FileID,
-        vfs: &Vfs,
+        vfs: &VfsSnapshot,
         modules: &HashMap<FileID, Module>,
+        cached: &HashMap<FileID, ThinModule>,
     ) -> ModuleImports {
         let mut imports = Vec::new();
+        let mut targets = Vec::new();
         let mut errors = Vec::new();
         let root = SyntaxNode::new_root(module.green_tree.clone());
         let current_dir = if let Some(current_path) = vfs
@@ -55,6 +65,7 @@ impl HeaderAnalyzer {
             return ModuleImports {
                 file_id: current_file_id,
                 imports: vec![],
+                targets: vec![],
                 errors: vec![],
             };
         };
@@ -65,11 +76,15 @@ impl HeaderAnalyzer {
                     let path_node_range_trimmed = utils::trim_node_text_range(&path_node);
                     match Self::resolve_import_path(&path_node, &current_dir, vfs) {
                         Ok((target_file_id, symbol_name)) => {
+                            if !targets.contains(&target_file_id) {
+                                targets.push(target_file_id);
+                            }
                             match Self::collect_import_info(
                                 target_file_id,
                                 symbol_name.as_deref(),
                                 path_node_range_trimmed,
                                 modules,
+                                cached,
                             ) {
                                 Ok(import_info) => {
                                     imports.push((import_info, path_node_range_trimmed));
@@ -86,10 +101,78 @@ impl HeaderAnalyzer {
         ModuleImports {
             file_id: current_file_id,
             imports,
+            targets,
             errors,
         }
     }
 
+    /// 从入口文件开始，把它们直接或间接导入的文件从磁盘读入 `vfs`
+    ///
+    /// 只做词法分析找出 import 路径，不构建语法树；已在 `vfs` 中的文件不会重新读取。
+    /// 读取失败的文件被跳过，之后由语义分析报告 [`AnalyzeError::ImportPathNotFound`]
+    pub fn load_imports(vfs: &Vfs, entries: &[FileID]) {
+        let mut visited: HashSet<FileID> = entries.iter().copied().collect();
+        let mut frontier = entries.to_vec();
+
+        while !frontier.is_empty() {
+            let snapshot = vfs.snapshot();
+            let paths: HashSet<PathBuf> = frontier
+                .par_iter()
+                .filter_map(|file_id| snapshot.get_file_by_file_id(file_id))
+                .flat_map_iter(Self::scan_import_paths)
+                .collect();
+
+            let mut next = Vec::new();
+            let mut missing = Vec::new();
+            for path in paths {
+                match snapshot.get_file_id_by_path(&path) {
+                    Some(file_id) => {
+                        if visited.insert(file_id) {
+                            next.push(file_id);
+                        }
+                    }
+                    None => missing.push(path),
+                }
+            }
+
+            let files: Vec<_> = missing
+                .into_par_iter()
+                .filter_map(|path| {
+                    let text = vfs::load::read_text(&path).ok()?;
+                    Some(VirtulFile::new(path, text))
+                })
+                .collect();
+            for file_id in vfs.new_files(files) {
+                visited.insert(file_id);
+                next.push(file_id);
+            }
+            frontier = next;
+        }
+    }
+
+    /// 文件中 import 语句指向的、存在的文件的规范路径
+    fn scan_import_paths(file: &VirtulFile) -> Vec<PathBuf> {
+        let Some(current_dir) = file.path.parent() else {
+            return Vec::new();
+        };
+        let lexer = Lexer::new(&file.text);
+        let tokens: Vec<_> = lexer
+            .get_tokens()
+            .iter()
+            .filter(|(kind, _, _)| !kind.is_trivia())
+            .collect();
+        tokens
+            .windows(2)
+            .filter(|pair| {
+                pair[0].0 == SyntaxKind::IMPORT_KW && pair[1].0 == SyntaxKind::STRING_LITERAL
+            })
+            .filter_map(|pair| {
+                let header_path = snailquote::unescape(pair[1].1).ok()?;
+                Self::canonical_import_path(header_path.into(), current_dir).ok()
+            })
+            .collect()
+    }
+
     /// 将单个模块的导入信息应用到该模块（写入操作）
     pub fn apply_module_imports(module: &mut Module, module_imports: ModuleImports) {
         module.semantic_errors.extend(module_imports.errors);
@@ -105,7 +188,7 @@ impl HeaderAnalyzer {
     fn resolve_import_path(
         path_node: &syntax::ast::Path,
         current_dir: &Path,
-        vfs: &Vfs,
+        vfs: &VfsSnapshot,
     ) -> Result<(FileID, Option<String>), AnalyzeError> {
         let path_node_range_trimmed = utils::trim_node_text_range(path_node);
         let path_token =
@@ -125,17 +208,12 @@ impl HeaderAnalyzer {
 
         let symbol_name = path_node.symbol().map(|s| s.text().to_string());
 
-        let mut target_path: PathBuf = current_dir.into();
-        target_path.push(header_path);
-        if target_path.extension().is_none() {
-            target_path.set_extension("airy");
-        }
-        target_path = target_path
-            .canonicalize()
-            .map_err(|e| AnalyzeError::ImportPathNotFound {
+        let target_path = Self::canonical_import_path(header_path, current_dir).map_err(|e| {
+            AnalyzeError::ImportPathNotFound {
                 path: format!("{:?}", e),
                 range: path_node_range_trimmed,
-            })?;
+            }
+        })?;
 
         let target_file_id = vfs.get_file_id_by_path(&target_path).ok_or_else(|| {
             AnalyzeError::ImportPathNotFound {
@@ -147,20 +225,34 @@ impl HeaderAnalyzer {
         Ok((target_file_id, symbol_name))
     }
 
+    /// import 路径相对于当前文件所在目录，省略扩展名时为 `.airy`
+    fn canonical_import_path(header_path: PathBuf, current_dir: &Path) -> std::io::Result<PathBuf> {
+        let mut target_path: PathBuf = current_dir.into();
+        target_path.push(header_path);
+        if target_path.extension().is_none() {
+            target_path.set_extension("airy");
+        }
+        target_path.canonicalize()
+    }
+
     /// 从目标模块收集需要导入的符号信息
     fn collect_import_info(
         target_file_id: FileID,
         symbol_name: Option<&str>,
         range: TextRange,
         modules: &HashMap<FileID, Module>,
+        cached: &HashMap<FileID, ThinModule>,
     ) -> Result<ImportInfo, AnalyzeError> {
-        let target_module =
-            modules
-                .get(&target_file_id)
-                .ok_or_else(|| AnalyzeError::ImportPathNotFound {
-                    path: format!("{:?}", target_file_id),
-                    range,
-                })?;
+        let Some(target_module) = modules.get(&target_file_id) else {
+            let thin =
+                cached
+                    .get(&target_file_id)
+                    .ok_or_else(|| AnalyzeError::ImportPathNotFound {
+                        path: format!("{:?}", target_file_id),
+                        range,
+                    })?;
+            return Self::collect_cached_symbols(target_file_id, thin, symbol_name, range);
+        };
 
         if let Some(symbol) = symbol_name {
             Self::collect_specific_symbol(target_module, symbol, range)
@@ -169,7 +261,59 @@ impl HeaderAnalyzer {
         }
     }
 
+    /// 从缓存的元数据收集符号
+    ///
+    /// 元数据中的函数、结构体和常量都是目标模块本地定义的，导出规则与完整模块相同
+    fn collect_cached_symbols(
+        target_file_id: FileID,
+        thin: &ThinModule,
+        symbol_name: Option<&str>,
+        range: TextRange,
+    ) -> Result<ImportInfo, AnalyzeError> {
+        let matches = |name: &str| symbol_name.is_none_or(|s| s == name);
+        let mut import_info = ImportInfo {
+            functions: thin
+                .functions
+                .iter()
+                .filter(|(_, f)| matches(&f.name))
+                .map(|(idx, f)| (Name::new(&f.name), FunctionID::new(target_file_id, idx)))
+                .collect(),
+            structs: thin
+                .structs
+                .iter()
+                .filter(|(_, s)| matches(&s.name))
+                .map(|(idx, s)| (Name::new(&s.name), StructID::new(target_file_id, idx)))
+                .collect(),
+            constants: thin
+                .constants
+                .iter()
+                .filter(|(_, c)| matches(&c.name))
+                .map(|(idx, c)| (Name::new(&c.name), ConstantID::new(target_file_id, idx)))
+                .collect(),
+        };
+
+        if let Some(symbol) = symbol_name {
+            // 与 collect_specific_symbol 一致，同名时依次优先导入函数、结构体
+            if !import_info.functions.is_empty() {
+                import_info.structs.clear();
+                import_info.constants.clear();
+            } else if !import_info.structs.is_empty() {
+                import_info.constants.clear();
+            } else if import_info.constants.is_empty() {
+                return Err(AnalyzeError::ImportSymbolNotFound {
+                    symbol: symbol.to_string(),
+                    module_path: format!("{:?}", target_file_id),
+                    range,
+                });
+            }
+        }
+
+        Ok(import_info)
+    }
+
     /// 收集特定符号
+    ///
+    /// 只导出目标模块本地定义的符号，目标模块自身的导入不会被再次导出
     fn collect_specific_symbol(
         target_module: &Module,
         symbol_name: &str,
@@ -178,19 +322,33 @@ impl HeaderAnalyzer {
         let mut import_info = ImportInfo {
             functions: Vec::new(),
             structs: Vec::new(),
+            constants: Vec::new(),
         };
 
-        if let Some(&func_id) = target_module.function_map.get(symbol_name) {
+        if let Some(func_id) = target_module.get_function_id_by_name(symbol_name)
+            && func_id.module == target_module.file_id
+        {
             import_info
                 .functions
-                .push((symbol_name.to_string(), func_id));
+                .push((Name::new(symbol_name), func_id));
             return Ok(import_info);
         }
 
-        if let Some(&struct_id) = target_module.struct_map.get(symbol_name) {
+        if let Some(struct_id) = target_module.get_struct_id_by_name(symbol_name)
+            && struct_id.module == target_module.file_id
+        {
             import_info
                 .structs
-                .push((symbol_name.to_string(), struct_id));
+                .push((Name::new(symbol_name), struct_id));
+            return Ok(import_info);
+        }
+
+        if let Some(const_id) = target_module.get_constant_id_by_name(symbol_name)
+            && const_id.module == target_module.file_id
+        {
+            import_info
+                .constants
+                .push((Name::new(symbol_name), const_id));
             return Ok(import_info);
         }
 
@@ -206,14 +364,25 @@ impl HeaderAnalyzer {
         let mut import_info = ImportInfo {
             functions: Vec::new(),
             structs: Vec::new(),
+            constants: Vec::new(),
         };
 
         for (name, &func_id) in &target_module.function_map {
-            import_info.functions.push((name.clone(), func_id));
+            if func_id.module == target_module.file_id {
+                import_info.functions.push((*name, func_id));
+            }
         }
 
         for (name, &struct_id) in &target_module.struct_map {
-            import_info.structs.push((name.clone(), struct_id));
+            if struct_id.module == target_module.file_id {
+                import_info.structs.push((*name, struct_id));
+            }
+        }
+
+        for (name, &const_id) in &target_module.constant_map {
+            if const_id.module == target_module.file_id {
+                import_info.constants.push((*name, const_id));
+            }
         }
 
         Ok(import_info)
@@ -228,7 +397,7 @@ impl HeaderAnalyzer {
         for (name, func_id) in import_info.functions {
             if module.function_map.contains_key(&name) {
                 return Err(AnalyzeError::ImportSymbolConflict {
-                    symbol: name,
+                    symbol: name.to_string(),
                     range,
                 });
             }
@@ -238,13 +407,23 @@ impl HeaderAnalyzer {
         for (name, struct_id) in import_info.structs {
             if module.struct_map.contains_key(&name) {
                 return Err(AnalyzeError::ImportSymbolConflict {
-                    symbol: name,
+                    symbol: name.to_string(),
                     range,
                 });
             }
             module.struct_map.insert(name, struct_id);
         }
 
+        for (name, const_id) in import_info.constants {
+            if module.constant_map.contains_key(&name) {
+                return Err(AnalyzeError::ImportSymbolConflict {
+                    symbol: name.to_string(),
+                    range,
+                });
+            }
+            module.constant_map.insert(name, const_id);
+        }
+
         Ok(())
     }
 }
@@ -1,10 +1,13 @@
 pub mod analyze;
 pub mod array;
+pub mod cancel;
 pub mod checker;
+pub mod dependency;
 pub mod error;
 pub mod header;
 pub mod module;
 pub mod project;
+pub mod symbol_index;
 pub mod r#type;
 pub(crate) mod utils;
 pub mod value;
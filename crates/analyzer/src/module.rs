@@ -1,5 +1,6 @@
 use std::{
     collections::{BTreeMap, HashMap},
+    hash::{DefaultHasher, Hash, Hasher},
     ops::Deref,
     sync::Arc,
 };
@@ -8,7 +9,7 @@ use rowan::GreenNode;
 use syntax::SyntaxNode;
 use syntax::Visitor;
 use thunderdome::Arena;
-use tools::TextRange;
+use tools::{Name, TextRange, hash::FxHashMap};
 use utils::{define_id_type, define_module_id_type};
 use vfs::FileID;
 
@@ -20,9 +21,11 @@ pub struct Module {
 
     pub variables: Arena<Variable>,
     pub reference: Arena<Reference>,
-    pub functions: Arena<Function>,
-    pub structs: Arena<Struct>,
-    pub fields: Arena<Field>,
+    /// 对外暴露的符号与 [`ThinModule`] 共享，写入时才复制
+    pub functions: Arc<Arena<Function>>,
+    pub structs: Arc<Arena<Struct>>,
+    pub fields: Arc<Arena<Field>>,
+    pub constants: Arc<Arena<Constant>>,
     pub scopes: Arena<Scope>,
 
     pub global_scope: ScopeID,
@@ -30,10 +33,10 @@ pub struct Module {
     pub green_tree: GreenNode,
 
     /// 存储编译时能计算的表达式
-    pub value_table: HashMap<TextRange, Value>,
+    pub value_table: FxHashMap<TextRange, Value>,
 
     /// 存储展开的数组
-    pub expand_array: HashMap<TextRange, ArrayTree>,
+    pub expand_array: FxHashMap<TextRange, ArrayTree>,
 
     /// 变量索引：TextRange -> VariableID
     pub variable_map: BTreeMap<TextRange, VariableID>,
@@ -42,13 +45,16 @@ pub struct Module {
     pub reference_map: BTreeMap<TextRange, ReferenceID>,
 
     /// Struct 索引：Name -> StructID
-    pub struct_map: HashMap<String, StructID>,
+    pub struct_map: FxHashMap<Name, StructID>,
 
     /// Function 索引
-    pub function_map: HashMap<String, FunctionID>,
+    pub function_map: FxHashMap<Name, FunctionID>,
+
+    /// 全局常量索引，包括导入的常量
+    pub constant_map: FxHashMap<Name, ConstantID>,
 
     /// 表达式类型表：TextRange -> NType
-    pub type_table: HashMap<TextRange, Ty>,
+    pub type_table: FxHashMap<TextRange, Ty>,
 
     /// 错误
     pub semantic_errors: Vec<AnalyzeError>,
@@ -63,21 +69,61 @@ pub struct Module {
     pub metadata: Option<Arc<HashMap<FileID, ThinModule>>>,
 }
 
+/// 模块对外暴露的符号，与 [`Module`] 共享同一份 arena
 #[derive(Debug, Clone, Default)]
 pub struct ThinModule {
-    pub functions: Arena<Function>,
-    pub structs: Arena<Struct>,
-    pub fields: Arena<Field>,
+    pub functions: Arc<Arena<Function>>,
+    pub structs: Arc<Arena<Struct>>,
+    pub fields: Arc<Arena<Field>>,
+    pub constants: Arc<Arena<Constant>>,
 }
 
 impl ThinModule {
+    /// 只增加引用计数，不复制符号
     pub fn new(module: &Module) -> Self {
         Self {
-            functions: module.functions.clone(),
-            structs: module.structs.clone(),
-            fields: module.fields.clone(),
+            functions: Arc::clone(&module.functions),
+            structs: Arc::clone(&module.structs),
+            fields: Arc::clone(&module.fields),
+            constants: Arc::clone(&module.constants),
         }
     }
+
+    /// 计算模块对外暴露接口的指纹
+    ///
+    /// 只包含依赖方会使用的部分（ID、名称、类型、常量的值），忽略定义位置等信息，
+    /// 指纹不变时依赖方无需重新分析
+    pub fn interface_fingerprint(&self) -> u64 {
+        let mut hasher = DefaultHasher::new();
+        self.functions.len().hash(&mut hasher);
+        for (idx, function) in self.functions.iter() {
+            idx.hash(&mut hasher);
+            function.name.hash(&mut hasher);
+            function.meta_types.hash(&mut hasher);
+            function.ret_type.hash(&mut hasher);
+            function.is_variadic.hash(&mut hasher);
+        }
+        self.structs.len().hash(&mut hasher);
+        for (idx, struct_def) in self.structs.iter() {
+            idx.hash(&mut hasher);
+            struct_def.name.hash(&mut hasher);
+            struct_def.fields.hash(&mut hasher);
+        }
+        self.fields.len().hash(&mut hasher);
+        for (idx, field) in self.fields.iter() {
+            idx.hash(&mut hasher);
+            field.name.hash(&mut hasher);
+            field.ty.hash(&mut hasher);
+        }
+        self.constants.len().hash(&mut hasher);
+        for (idx, constant) in self.constants.iter() {
+            idx.hash(&mut hasher);
+            constant.name.hash(&mut hasher);
+            constant.ty.hash(&mut hasher);
+            constant.value.hash(&mut hasher);
+        }
+        hasher.finish()
+    }
 }
 
 #[derive(Debug, Default)]
@@ -93,9 +139,32 @@ pub struct ModuleIndex {
     pub variable_reference: HashMap<VariableID, Vec<CiterInfo>>,
     pub function_reference: HashMap<FunctionID, Vec<CiterInfo>>,
     pub field_reference: HashMap<FieldID, Vec<CiterInfo>>,
+    pub constant_reference: HashMap<ConstantID, Vec<CiterInfo>>,
     pub scope_tree: HashMap<ScopeID, Vec<ScopeID>>,
 }
 
+impl ModuleIndex {
+    /// 只保留满足条件的引用信息，删除因此变空的条目
+    pub fn retain_citers(&mut self, f: impl Fn(&CiterInfo) -> bool) {
+        self.variable_reference.retain(|_, citers| {
+            citers.retain(&f);
+            !citers.is_empty()
+        });
+        self.function_reference.retain(|_, citers| {
+            citers.retain(&f);
+            !citers.is_empty()
+        });
+        self.field_reference.retain(|_, citers| {
+            citers.retain(&f);
+            !citers.is_empty()
+        });
+        self.constant_reference.retain(|_, citers| {
+            citers.retain(&f);
+            !citers.is_empty()
+        });
+    }
+}
+
 #[derive(Debug)]
 pub struct CiterInfo {
     pub file_id: FileID,
@@ -118,6 +187,7 @@ impl Module {
             functions: Default::default(),
             structs: Default::default(),
             fields: Default::default(),
+            constants: Default::default(),
             scopes: Default::default(),
             global_scope: Default::default(),
             value_table: Default::default(),
@@ -126,6 +196,7 @@ impl Module {
             reference_map: Default::default(),
             struct_map: Default::default(),
             function_map: Default::default(),
+            constant_map: Default::default(),
             type_table: Default::default(),
             semantic_errors: Default::default(),
             analyzing: Default::default(),
@@ -178,7 +249,7 @@ impl Module {
     pub fn new_scope(&mut self, parent: Option<ScopeID>, range: TextRange) -> ScopeID {
         let scope = Scope {
             parent,
-            variables: HashMap::new(),
+            variables: FxHashMap::default(),
             range,
         };
         let id = ScopeID(self.scopes.insert(scope));
@@ -210,7 +281,7 @@ impl Module {
             is_variadic,
             range,
         };
-        let id = self.functions.insert(function);
+        let id = Arc::make_mut(&mut self.functions).insert(function);
         FunctionID::new(self.file_id, id)
     }
 
@@ -256,17 +327,17 @@ impl Module {
             id.module, self.file_id,
             "Cannot get mutable reference to struct in another module"
         );
-        self.structs.get_mut(id.index)
+        Arc::make_mut(&mut self.structs).get_mut(id.index)
     }
 
     /// 根据名称查找 struct
     pub fn get_struct_id_by_name(&self, name: &str) -> Option<StructID> {
-        self.struct_map.get(name).copied()
+        self.struct_map.get(&Name::lookup(name)?).copied()
     }
 
     /// 根据名称查找函数
     pub fn get_function_id_by_name(&self, name: &str) -> Option<FunctionID> {
-        self.function_map.get(name).copied()
+        self.function_map.get(&Name::lookup(name)?).copied()
     }
 
     /// 获取函数定义
@@ -291,7 +362,7 @@ impl Module {
             id.module, self.file_id,
             "Cannot get mutable reference to function in another module"
         );
-        self.functions.get_mut(id.index)
+        Arc::make_mut(&mut self.functions).get_mut(id.index)
     }
 
     /// 添加新的 struct 定义
@@ -301,13 +372,13 @@ impl Module {
             fields,
             range,
         };
-        let id = self.structs.insert(struct_def);
+        let id = Arc::make_mut(&mut self.structs).insert(struct_def);
         StructID::new(self.file_id, id)
     }
 
     pub fn new_field(&mut self, name: String, ty: Ty, range: TextRange) -> FieldID {
         let field = Field { name, ty, range };
-        let id = self.fields.insert(field);
+        let id = Arc::make_mut(&mut self.fields).insert(field);
         FieldID::new(self.file_id, id)
     }
 
@@ -325,6 +396,46 @@ impl Module {
         }
     }
 
+    /// 添加新的全局常量，类型和值在分析时填写
+    pub fn new_constant(&mut self, name: String, range: TextRange) -> ConstantID {
+        let constant = Constant {
+            name,
+            ty: Ty::Void,
+            value: None,
+            range,
+        };
+        let id = Arc::make_mut(&mut self.constants).insert(constant);
+        ConstantID::new(self.file_id, id)
+    }
+
+    /// 根据名称查找全局常量
+    pub fn get_constant_id_by_name(&self, name: &str) -> Option<ConstantID> {
+        self.constant_map.get(&Name::lookup(name)?).copied()
+    }
+
+    /// 获取全局常量（支持跨模块访问）
+    pub fn get_constant_by_id(&self, id: ConstantID) -> Option<&Constant> {
+        if id.module == self.file_id {
+            self.constants.get(id.index)
+        } else {
+            self.metadata
+                .as_ref()?
+                .get(&id.module)?
+                .constants
+                .get(id.index)
+        }
+    }
+
+    /// 获取全局常量（可变引用）
+    /// 注意：只能获取本地模块的常量
+    pub fn get_constant_mut_by_id(&mut self, id: ConstantID) -> Option<&mut Constant> {
+        debug_assert_eq!(
+            id.module, self.file_id,
+            "Cannot get mutable reference to constant in another module"
+        );
+        Arc::make_mut(&mut self.constants).get_mut(id.index)
+    }
+
     /// 获取变量定义
     pub fn get_variable_by_id(&self, id: VariableID) -> Option<&Variable> {
         self.variables.get(*id)
@@ -361,6 +472,7 @@ define_id_type!(ReferenceID);
 define_module_id_type!(StructID);
 define_module_id_type!(FunctionID);
 define_module_id_type!(FieldID);
+define_module_id_type!(ConstantID);
 
 impl Default for ScopeID {
     fn default() -> Self {
@@ -393,6 +505,8 @@ pub enum ReferenceTag {
     VarRead(VariableID),
     FieldRead(FieldID),
     FuncCall(FunctionID),
+    /// 读取导入的全局常量
+    ConstRead(ConstantID),
 }
 #[derive(Debug, Clone)]
 pub struct Function {
@@ -419,6 +533,18 @@ pub struct Field {
     pub range: TextRange,
 }
 
+/// 可被其他模块导入的全局常量
+///
+/// 常量只在定义它的模块分析时求值一次，依赖方通过元数据直接使用求出的值
+#[derive(Debug, Clone)]
+pub struct Constant {
+    pub name: String,
+    pub ty: Ty,
+    /// 只保存不依赖模块常量表的值（见 [`Value::is_portable`]），求值失败时为 None
+    pub value: Option<Value>,
+    pub range: TextRange,
+}
+
 impl Struct {
     /// 根据字段名查找字段索引
     pub fn field_index(&self, module: &Module, name: &str) -> Option<u32> {
@@ -455,7 +581,7 @@ impl Struct {
 #[derive(Debug)]
 pub struct Scope {
     pub parent: Option<ScopeID>,
-    pub variables: HashMap<String, VariableID>,
+    pub variables: FxHashMap<Name, VariableID>,
     pub range: TextRange,
 }
 
@@ -468,22 +594,20 @@ impl Scope {
         ty: Ty,
         range: TextRange,
     ) -> VariableID {
-        let idx = variables.insert(Variable {
-            name: name.clone(),
-            ty,
-            range,
-        });
+        let key = Name::new(&name);
+        let idx = variables.insert(Variable { name, ty, range });
         let var_id = VariableID(idx);
-        self.variables.insert(name, var_id);
+        self.variables.insert(key, var_id);
         variable_map.insert(range, var_id);
         var_id
     }
 
     /// 查找变量
     pub fn look_up_variable(&self, m: &Module, var_name: &str) -> Option<VariableID> {
+        let var_name = Name::lookup(var_name)?;
         let mut u_opt = Some(self);
         while let Some(u) = u_opt {
-            if let Some(idx) = u.variables.get(var_name) {
+            if let Some(idx) = u.variables.get(&var_name) {
                 return Some(*idx);
             }
             u_opt = u.parent.map(|x| m.scopes.get(*x).unwrap());
@@ -493,6 +617,6 @@ impl Scope {
 
     /// 检查当前作用域是否存在变量定义
     pub fn have_variable_def(&self, var_name: &str) -> bool {
-        self.variables.contains_key(var_name)
+        Name::lookup(var_name).is_some_and(|name| self.variables.contains_key(&name))
     }
 }
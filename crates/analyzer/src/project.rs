@@ -1,29 +1,53 @@
 use std::{
-    collections::HashMap,
-    sync::{Arc, RwLock},
+    collections::{HashMap, HashSet},
+    sync::Arc,
 };
 
-use parser::parse::Parser;
+use parser::parse::{Parser, ParserError};
 use rayon::prelude::*;
+use rowan::{GreenNode, NodeOrToken, WalkEvent};
 use syntax::{
     AstNode as _, SyntaxNode,
-    ast::{FuncDef, StructDef},
+    ast::{FuncDef, StructDef, Type, VarDef},
 };
+use tools::{Name, TextEdit, profile};
 use utils::extract_name_and_range;
-use vfs::{FileID, Vfs};
+use vfs::{FileID, Vfs, VfsSnapshot};
 
 use crate::{
+    cancel::CancelToken,
     checker::ProjectChecker,
+    dependency::DependencyGraph,
+    error::AnalyzeError,
     header::HeaderAnalyzer,
-    module::{CiterInfo, Field, FieldID, Module, ModuleIndex, ThinModule},
+    module::{CiterInfo, Module, ModuleIndex, ReferenceTag, ThinModule},
+    symbol_index::SymbolIndex,
     r#type::Ty,
 };
 
+/// 语法树以及对应的解析错误
+type ParseResult = (GreenNode, Vec<ParserError>);
+
 #[derive(Default, Debug)]
 pub struct Project {
     pub modules: HashMap<FileID, Module>,
     pub metadata: Arc<HashMap<FileID, ThinModule>>,
     pub(crate) checker: Vec<Box<dyn ProjectChecker>>,
+    /// 模块间的 import 依赖图
+    pub dependency: DependencyGraph,
+    /// 每个模块对外接口的指纹，见 [`ThinModule::interface_fingerprint`]
+    pub fingerprints: HashMap<FileID, u64>,
+    /// 所有模块的全局符号，用于工作区符号搜索
+    pub symbols: SymbolIndex,
+    /// 每个模块 `semantic_errors` 末尾依次由各个 checker 产生的错误数量，增量更新时替换
+    checker_errors: HashMap<FileID, Vec<usize>>,
+    /// 上次运行 checker 之后重新分析过的模块，为 None 时需要检查整个项目
+    unchecked: Option<HashSet<FileID>>,
+    /// 触发后跳过剩下的模块分析，见 [`Project::set_cancel_token`]
+    cancel: CancelToken,
+    /// 因为取消而没有完成分析的模块，以及它们第一次被取消之前的接口指纹：
+    /// 依赖方是按那时的接口分析的。它们的语法树已经是最新的
+    stale: HashMap<FileID, Option<u64>>,
 }
 
 impl Project {
@@ -36,170 +60,768 @@ impl Project {
         self
     }
 
+    /// 设置之后的分析使用的取消标记
+    ///
+    /// 标记触发后，正在进行的更新跳过剩下的模块并尽快返回，项目停在未完成的状态
+    /// （[`Project::is_complete`] 为 false）。下一次更新或者 [`Project::resume`] 会先重新分析
+    /// 这些模块
+    pub fn set_cancel_token(&mut self, cancel: CancelToken) {
+        self.cancel = cancel;
+    }
+
+    /// 上一次更新是否完整地完成，没有被取消
+    pub fn is_complete(&self) -> bool {
+        self.stale.is_empty()
+    }
+
+    /// 完成被取消的分析
+    pub fn resume(&mut self, vfs: &Vfs) {
+        if !self.is_complete() {
+            self.update_modules(vfs, Vec::new(), HashMap::new());
+        }
+    }
+
     /// 全量初始化
     pub fn full_initialize(&mut self, vfs: &Vfs) {
+        self.initialize_with_cache(vfs, HashMap::new());
+    }
+
+    /// 全量初始化，`cached` 中的模块直接使用缓存的元数据，不再解析和分析
+    ///
+    /// 缓存模块不会出现在 `modules` 中，也不参与 checker 检查；它们的 import 依赖由调用方
+    /// 写入 `dependency`。需要完整模块时使用 [`Project::materialize`]
+    pub fn initialize_with_cache(&mut self, vfs: &Vfs, cached: HashMap<FileID, ThinModule>) {
         self.modules.clear();
         self.metadata = Default::default();
+        self.dependency.clear();
+        self.fingerprints.clear();
+        self.symbols.clear();
+        self.checker_errors.clear();
+        self.unchecked = None;
+        self.stale.clear();
 
-        // 初始化所有 module，语法分析
-        let file_ids = vfs.file_ids();
-        let modules = RwLock::new(HashMap::new());
-
-        file_ids.par_iter().for_each(|&file_id| {
-            if let Some(file) = vfs.get_file_by_file_id(&file_id) {
-                let parser = Parser::new(&file.text);
-                let (green_tree, errors) = parser.parse();
-
-                let mut module = Module::new(green_tree.clone());
-                module.file_id = file_id;
-                errors.into_iter().for_each(|e| {
-                    module
-                        .semantic_errors
-                        .push(crate::error::AnalyzeError::ParserError(Box::new(e)))
-                });
-
-                // 收集符号并分配 ID
-                Self::allocate_module_symbols(&mut module);
+        // 并行阶段只读取快照，不竞争 vfs 的锁
+        let vfs = &vfs.snapshot();
 
-                modules.write().unwrap().insert(file_id, module);
-            }
-        });
+        // 初始化所有 module，语法分析
+        let file_ids: Vec<_> = vfs
+            .file_ids()
+            .into_iter()
+            .filter(|file_id| !cached.contains_key(file_id))
+            .collect();
 
-        self.modules = modules.into_inner().unwrap();
+        let span = profile::span("parse");
+        self.modules = file_ids
+            .par_iter()
+            .filter_map(|&file_id| Some((file_id, Self::parse_module(vfs, file_id)?)))
+            .collect();
+        drop(span);
 
         // 分析头文件
+        let span = profile::span("header analysis");
         let all_imports: Vec<_> = self
             .modules
             .par_iter()
             .map(|(file_id, module)| {
-                let module_imports =
-                    HeaderAnalyzer::collect_module_imports(module, *file_id, vfs, &self.modules);
+                let module_imports = HeaderAnalyzer::collect_module_imports(
+                    module,
+                    *file_id,
+                    vfs,
+                    &self.modules,
+                    &cached,
+                );
                 (*file_id, module_imports)
             })
             .collect();
-        for (file_id, module_imports) in all_imports {
+        for (file_id, mut module_imports) in all_imports {
+            self.dependency
+                .set_imports(file_id, std::mem::take(&mut module_imports.targets));
             if let Some(module) = self.modules.get_mut(&file_id) {
                 HeaderAnalyzer::apply_module_imports(module, module_imports);
             }
         }
+        drop(span);
 
         // 预处理元数据，跨文件使用
+        let span = profile::span("fill definitions");
         self.modules.par_iter_mut().for_each(|(_, module)| {
             Self::fill_definitions(module);
         });
+        drop(span);
+
+        // ThinModule 与模块共享符号，分析中修改的模块在写入时复制一份
+        let mut metadata = cached;
+        metadata.par_extend(
+            self.modules
+                .par_iter()
+                .map(|(file_id, module)| (*file_id, ThinModule::new(module))),
+        );
+
+        // 语义分析，分析完成的符号写回元数据，缓存模块的元数据保持不变
+        let span = profile::span("semantic analysis");
+        let mut metadata_rc = Arc::new(metadata);
+        let file_ids: Vec<_> = self.modules.keys().copied().collect();
+        Self::analyze_modules(
+            &mut self.modules,
+            &file_ids,
+            &mut metadata_rc,
+            vfs,
+            &self.cancel,
+        );
+        drop(span);
+
+        let metadata = Arc::try_unwrap(metadata_rc).unwrap_or_else(|rc| (*rc).clone());
+        self.fingerprints = metadata
+            .par_iter()
+            .map(|(file_id, thin)| (*file_id, thin.interface_fingerprint()))
+            .collect();
+        for (file_id, thin) in &metadata {
+            match self.modules.get(file_id) {
+                Some(module) => self.symbols.update_module(module),
+                None => self.symbols.update_thin(*file_id, thin),
+            }
+        }
+        self.metadata = Arc::new(metadata);
 
-        let metadata: HashMap<FileID, ThinModule> = self
+        // 构建索引（并行收集 + 串行合并）
+        let span = profile::span("index");
+        let local_indices: Vec<_> = self
             .modules
             .par_iter()
-            .map(|(file_id, module)| (*file_id, ThinModule::new(module)))
+            .map(|(_, module)| Self::collect_module_references(module))
             .collect();
 
-        // 语义分析
-        let metadata_rc = Arc::new(metadata);
-        self.modules.par_iter_mut().for_each(|(_, module)| {
-            module.metadata = Some(Arc::clone(&metadata_rc));
-            module.analyze();
-            module.metadata = None;
-        });
+        // 串行合并所有本地索引
+        for local_temp in local_indices {
+            self.merge_references(local_temp);
+        }
 
-        // 重新拷贝分析完成的元数据
-        let metadata: HashMap<FileID, ThinModule> = self
-            .modules
-            .par_iter()
-            .map(|(file_id, module)| (*file_id, ThinModule::new(module)))
+        for module in self.modules.values_mut() {
+            module.metadata = Some(Arc::clone(&self.metadata));
+        }
+        drop(span);
+
+        if profile::is_enabled() {
+            for module in self.modules.values() {
+                profile::count("functions", module.functions.len() as u64);
+                profile::count("structs", module.structs.len() as u64);
+                profile::count("variables", module.variables.len() as u64);
+                profile::count("references", module.reference.len() as u64);
+            }
+        }
+
+        // 被取消时所有模块都需要重新分析，checker 留到那时运行
+        if self.cancel.is_cancelled() {
+            self.stale = self
+                .modules
+                .keys()
+                .map(|file_id| (*file_id, None))
+                .collect();
+            return;
+        }
+        self.run_checkers();
+    }
+
+    /// 增量更新：文件 `file_id` 的内容发生了变化
+    ///
+    /// 只重新解析和分析该文件；如果它对外暴露的接口（函数签名、结构体字段）发生了变化，
+    /// 再重新分析所有直接或间接导入它的模块。新文件可能改变其他模块的 import 解析结果，
+    /// 此时退化为全量初始化
+    pub fn update_file(&mut self, vfs: &Vfs, file_id: FileID) {
+        self.update_module(vfs, file_id, None);
+    }
+
+    /// 增量更新：已知文件 `file_id` 的变化为 `edit`（`vfs` 中已是编辑后的文本）
+    ///
+    /// 与 [`Project::update_file`] 相同，但会复用旧语法树，只重新解析编辑所在的节点
+    pub fn update_file_with_edit(&mut self, vfs: &Vfs, file_id: FileID, edit: &TextEdit) {
+        let parsed = if let Some(module) = self.modules.get(&file_id)
+            && let Some(file) = vfs.get_file_by_file_id(&file_id)
+        {
+            let (green_tree, old_errors) = Self::parse_result(module);
+            Some(Parser::parse_incremental(
+                &green_tree,
+                &old_errors,
+                edit,
+                &file.text,
+            ))
+        } else {
+            None
+        };
+        self.update_module(vfs, file_id, parsed);
+    }
+
+    fn update_module(&mut self, vfs: &Vfs, file_id: FileID, parsed: Option<ParseResult>) {
+        if !self.modules.contains_key(&file_id) || vfs.get_file_by_file_id(&file_id).is_none() {
+            self.full_initialize(vfs);
+            return;
+        }
+
+        let parsed = parsed.map(|p| (file_id, p)).into_iter().collect();
+        self.update_modules(vfs, vec![file_id], parsed);
+    }
+
+    /// 重新分析 `roots` 和之前被取消的模块；它们的接口发生变化时，再重新分析所有直接或间接
+    /// 导入它们的模块
+    ///
+    /// `parsed` 中给出语法树的模块不再重新解析。被取消时没有完成分析的模块记录在 `stale` 中
+    fn update_modules(
+        &mut self,
+        vfs: &Vfs,
+        mut roots: Vec<FileID>,
+        mut parsed: HashMap<FileID, ParseResult>,
+    ) {
+        // 被取消的模块已经换上了新的语法树，只需要重新分析
+        let stale = std::mem::take(&mut self.stale);
+        for file_id in stale.keys() {
+            if !roots.contains(file_id)
+                && let Some(module) = self.modules.get(file_id)
+            {
+                roots.push(*file_id);
+                parsed.insert(*file_id, Self::parse_result(module));
+            }
+        }
+        let old_fingerprints: HashMap<FileID, Option<u64>> = roots
+            .iter()
+            .map(|file_id| {
+                let old = match stale.get(file_id) {
+                    Some(old) => *old,
+                    None => self.fingerprints.get(file_id).copied(),
+                };
+                (*file_id, old)
+            })
             .collect();
-        self.metadata = Arc::new(metadata);
 
-        // 构建索引（并行收集 + 串行合并）
+        self.rebuild_modules(vfs, &roots, &parsed);
+        if self.cancel.is_cancelled() {
+            self.stale = old_fingerprints;
+            return;
+        }
+
+        let mut dependents = HashSet::new();
+        for (file_id, old_fingerprint) in &old_fingerprints {
+            if self.fingerprints.get(file_id) != old_fingerprint.as_ref() {
+                dependents.extend(
+                    self.dependency
+                        .reverse_closure(*file_id)
+                        .into_iter()
+                        .filter(|id| !old_fingerprints.contains_key(id)),
+                );
+            }
+        }
+        if !dependents.is_empty() {
+            // 依赖方的文本没有变化，复用原有的语法树
+            let dependents: Vec<_> = dependents.into_iter().collect();
+            let parsed = dependents
+                .iter()
+                .filter_map(|id| Some((*id, Self::parse_result(self.modules.get(id)?))))
+                .collect();
+            let old_fingerprints = dependents
+                .iter()
+                .map(|id| (*id, self.fingerprints.get(id).copied()))
+                .collect();
+            self.rebuild_modules(vfs, &dependents, &parsed);
+            if self.cancel.is_cancelled() {
+                self.stale = old_fingerprints;
+                return;
+            }
+        }
+
+        self.run_checkers();
+    }
+
+    /// 把缓存模块转为完整模块：重新解析和分析
+    ///
+    /// 用于缓存的元数据失效（例如导入模块的接口发生了变化）的情况。已有模块对这些模块的引用
+    /// 会补充到它们的索引中。重新分析后接口发生变化时，导入它们的完整模块之前是按旧的元数据
+    /// 分析的，需要重新分析；导入它们的缓存模块由调用方判断是否失效
+    ///
+    /// 只用于编译时的缓存，不能被取消
+    pub fn materialize(&mut self, vfs: &Vfs, file_ids: &[FileID]) {
+        let cancel = std::mem::take(&mut self.cancel);
+        self.materialize_modules(vfs, file_ids);
+        self.cancel = cancel;
+    }
+
+    fn materialize_modules(&mut self, vfs: &Vfs, file_ids: &[FileID]) {
+        let file_ids: Vec<_> = file_ids
+            .iter()
+            .copied()
+            .filter(|file_id| !self.modules.contains_key(file_id))
+            .collect();
+        if file_ids.is_empty() {
+            return;
+        }
+        let old_fingerprints: Vec<_> = file_ids
+            .iter()
+            .map(|file_id| self.fingerprints.get(file_id).copied())
+            .collect();
+        self.rebuild_modules(vfs, &file_ids, &HashMap::new());
+
+        // 之前合并索引时这些模块还不存在，其余模块对它们的引用被跳过了
+        let targets: HashSet<FileID> = file_ids.iter().copied().collect();
         let local_indices: Vec<_> = self
             .modules
             .par_iter()
-            .map(|(_file_id, module)| {
-                let mut local_temp: HashMap<FileID, ModuleIndex> = HashMap::new();
-
-                for (_, refer) in &module.reference {
-                    match refer.tag {
-                        crate::module::ReferenceTag::VarRead(variable_id) => {
-                            let target_file_id = module.file_id;
-                            let index = local_temp.entry(target_file_id).or_default();
-                            index
-                                .variable_reference
-                                .entry(variable_id)
-                                .or_default()
-                                .push(CiterInfo::new(module.file_id, refer.range));
-                        }
-                        crate::module::ReferenceTag::FieldRead(field_id) => {
-                            let target_file_id = field_id.module;
-                            let index = local_temp.entry(target_file_id).or_default();
-                            index
-                                .field_reference
-                                .entry(field_id)
-                                .or_default()
-                                .push(CiterInfo::new(module.file_id, refer.range));
-                        }
-                        crate::module::ReferenceTag::FuncCall(function_id) => {
-                            let target_file_id = function_id.module;
-                            let index = local_temp.entry(target_file_id).or_default();
-                            index
-                                .function_reference
-                                .entry(function_id)
-                                .or_default()
-                                .push(CiterInfo::new(module.file_id, refer.range));
-                        }
+            .filter(|(file_id, _)| !targets.contains(file_id))
+            .map(|(_, module)| {
+                let mut local_temp = Self::collect_module_references(module);
+                local_temp.retain(|file_id, _| targets.contains(file_id));
+                local_temp
+            })
+            .collect();
+        for local_temp in local_indices {
+            self.merge_references(local_temp);
+        }
+
+        let mut dependents = HashSet::new();
+        for (file_id, old_fingerprint) in file_ids.iter().zip(old_fingerprints) {
+            if self.fingerprints.get(file_id).copied() != old_fingerprint {
+                dependents.extend(
+                    self.dependency
+                        .reverse_closure(*file_id)
+                        .into_iter()
+                        .filter(|id| !targets.contains(id) && self.modules.contains_key(id)),
+                );
+            }
+        }
+        if !dependents.is_empty() {
+            // 依赖方的文本没有变化，复用原有的语法树
+            let dependents: Vec<_> = dependents.into_iter().collect();
+            let parsed = dependents
+                .iter()
+                .filter_map(|id| Some((*id, Self::parse_result(self.modules.get(id)?))))
+                .collect();
+            self.rebuild_modules(vfs, &dependents, &parsed);
+        }
+
+        self.run_checkers();
+    }
+
+    /// 读取并解析单个文件，收集符号并分配 ID
+    fn parse_module(vfs: &VfsSnapshot, file_id: FileID) -> Option<Module> {
+        let file = vfs.get_file_by_file_id(&file_id)?;
+        let span = profile::span_with("parse", || path_file_name(&file.path));
+        let parser = Parser::new(&file.text);
+        let (green_tree, errors) = parser.parse();
+        drop(span);
+
+        if profile::is_enabled() {
+            count_syntax_tree(&green_tree);
+        }
+        Some(Self::build_module(file_id, green_tree, errors))
+    }
+
+    /// 由语法树创建模块，收集符号并分配 ID
+    fn build_module(file_id: FileID, green_tree: GreenNode, errors: Vec<ParserError>) -> Module {
+        let mut module = Module::new(green_tree);
+        module.file_id = file_id;
+        errors.into_iter().for_each(|e| {
+            module
+                .semantic_errors
+                .push(crate::error::AnalyzeError::ParserError(Box::new(e)))
+        });
+
+        // 收集符号并分配 ID
+        Self::allocate_module_symbols(&mut module);
+
+        module
+    }
+
+    /// 取出模块的语法树和解析错误
+    fn parse_result(module: &Module) -> ParseResult {
+        let errors = module
+            .semantic_errors
+            .iter()
+            .filter_map(|e| match e {
+                AnalyzeError::ParserError(e) => Some((**e).clone()),
+                _ => None,
+            })
+            .collect();
+        (module.green_tree.clone(), errors)
+    }
+
+    /// 重新解析并分析给定的模块，其余模块保持不变
+    ///
+    /// 其余模块对这些模块的引用索引会被原地修补
+    ///
+    /// `parsed` 中给出语法树的模块不再重新解析
+    fn rebuild_modules(
+        &mut self,
+        vfs: &Vfs,
+        file_ids: &[FileID],
+        parsed: &HashMap<FileID, ParseResult>,
+    ) {
+        let rebuilt: HashSet<FileID> = file_ids.iter().copied().collect();
+        let vfs = &vfs.snapshot();
+
+        // 先解除所有模块对元数据的持有，之后可以原地修改元数据
+        for module in self.modules.values_mut() {
+            module.metadata = None;
+        }
+
+        let new_modules: Vec<_> = file_ids
+            .par_iter()
+            .filter_map(|&file_id| {
+                let module = match parsed.get(&file_id) {
+                    Some((green_tree, errors)) => {
+                        Self::build_module(file_id, green_tree.clone(), errors.clone())
                     }
-                }
+                    None => Self::parse_module(vfs, file_id)?,
+                };
+                Some((file_id, module))
+            })
+            .collect();
 
-                local_temp
+        let mut old_modules = HashMap::new();
+        for (file_id, module) in new_modules {
+            self.checker_errors.remove(&file_id);
+            if let Some(unchecked) = &mut self.unchecked {
+                unchecked.insert(file_id);
+            }
+            if let Some(old) = self.modules.insert(file_id, module) {
+                old_modules.insert(file_id, old);
+            }
+        }
+
+        // 分析头文件
+        let all_imports: Vec<_> = file_ids
+            .par_iter()
+            .filter_map(|file_id| {
+                let module = self.modules.get(file_id)?;
+                let module_imports = HeaderAnalyzer::collect_module_imports(
+                    module,
+                    *file_id,
+                    vfs,
+                    &self.modules,
+                    &self.metadata,
+                );
+                Some((*file_id, module_imports))
             })
             .collect();
+        for (file_id, mut module_imports) in all_imports {
+            self.dependency
+                .set_imports(file_id, std::mem::take(&mut module_imports.targets));
+            if let Some(module) = self.modules.get_mut(&file_id) {
+                HeaderAnalyzer::apply_module_imports(module, module_imports);
+            }
+        }
 
-        // 串行合并所有本地索引
-        let mut temp: HashMap<FileID, ModuleIndex> = HashMap::new();
+        self.modules
+            .par_iter_mut()
+            .filter(|(file_id, _)| rebuilt.contains(file_id))
+            .for_each(|(_, module)| Self::fill_definitions(module));
+
+        // 语义分析，未重建的模块使用已有的元数据
+        {
+            let metadata = Arc::make_mut(&mut self.metadata);
+            for file_id in file_ids {
+                if let Some(module) = self.modules.get(file_id) {
+                    metadata.insert(*file_id, ThinModule::new(module));
+                }
+            }
+        }
+        Self::analyze_modules(
+            &mut self.modules,
+            file_ids,
+            &mut self.metadata,
+            vfs,
+            &self.cancel,
+        );
+
+        // 换成分析完成的符号
+        {
+            let metadata = Arc::make_mut(&mut self.metadata);
+            for file_id in file_ids {
+                if let Some(module) = self.modules.get(file_id) {
+                    let thin = ThinModule::new(module);
+                    self.fingerprints
+                        .insert(*file_id, thin.interface_fingerprint());
+                    metadata.insert(*file_id, thin);
+                    self.symbols.update_module(module);
+                }
+            }
+        }
+
+        // 修补索引：去掉旧模块产生的引用，保留其他模块对重建模块的引用
+        for (file_id, old) in &old_modules {
+            for target in Self::reference_targets(old) {
+                if rebuilt.contains(&target) {
+                    continue;
+                }
+                if let Some(module) = self.modules.get_mut(&target) {
+                    module.index.retain_citers(|c| c.file_id != *file_id);
+                }
+            }
+        }
+        for (file_id, mut old) in old_modules {
+            old.index.retain_citers(|c| !rebuilt.contains(&c.file_id));
+            if let Some(module) = self.modules.get_mut(&file_id) {
+                module.index.function_reference = old.index.function_reference;
+                module.index.field_reference = old.index.field_reference;
+                module.index.constant_reference = old.index.constant_reference;
+            }
+        }
+
+        let local_indices: Vec<_> = file_ids
+            .par_iter()
+            .filter_map(|file_id| self.modules.get(file_id))
+            .map(Self::collect_module_references)
+            .collect();
         for local_temp in local_indices {
-            for (file_id, local_index) in local_temp {
-                let index = temp.entry(file_id).or_default();
+            self.merge_references(local_temp);
+        }
+
+        for module in self.modules.values_mut() {
+            module.metadata = Some(Arc::clone(&self.metadata));
+        }
+    }
+
+    /// 语义分析给定的模块，分析完成的符号写入 `metadata`
+    ///
+    /// 导入的常量直接使用元数据中已经求出的值，不在使用处重新求值，所以导入常量的模块要在
+    /// 常量所在的模块之后分析。模块按这一关系分批，同一批内并行分析，每批完成后更新元数据；
+    /// 不导入常量的模块都在第一批
+    ///
+    /// `cancel` 触发后剩下的模块不再分析，由调用方记录
+    fn analyze_modules(
+        modules: &mut HashMap<FileID, Module>,
+        file_ids: &[FileID],
+        metadata: &mut Arc<HashMap<FileID, ThinModule>>,
+        vfs: &VfsSnapshot,
+        cancel: &CancelToken,
+    ) {
+        for batch in Self::constant_batches(modules, file_ids) {
+            if cancel.is_cancelled() {
+                return;
+            }
+            let metadata_rc = Arc::clone(metadata);
+            modules
+                .par_iter_mut()
+                .filter(|(file_id, _)| batch.contains(file_id))
+                .for_each(|(file_id, module)| {
+                    if cancel.is_cancelled() {
+                        return;
+                    }
+                    let _span = profile::span_with("analyze", || file_name(vfs, file_id));
+                    module.metadata = Some(Arc::clone(&metadata_rc));
+                    module.analyze();
+                    module.metadata = None;
+                });
+            drop(metadata_rc);
+
+            // 分析中修改过的符号已经写时复制，换成新的一份
+            let metadata = Arc::make_mut(metadata);
+            for file_id in &batch {
+                if let Some(module) = modules.get(file_id) {
+                    metadata.insert(*file_id, ThinModule::new(module));
+                }
+            }
+        }
+    }
+
+    /// 按常量的导入关系把模块分批，模块导入的常量都在更早的批次中求值
+    ///
+    /// 常量循环导入时剩下的模块放在同一批，读取还没有求值的常量会报告错误
+    fn constant_batches(
+        modules: &HashMap<FileID, Module>,
+        file_ids: &[FileID],
+    ) -> Vec<HashSet<FileID>> {
+        let pending: HashSet<FileID> = file_ids
+            .iter()
+            .copied()
+            .filter(|file_id| modules.contains_key(file_id))
+            .collect();
+        // 模块 -> 它从中导入常量、且还没有分析的模块
+        let mut waiting: HashMap<FileID, HashSet<FileID>> = pending
+            .iter()
+            .map(|file_id| {
+                let targets = modules[file_id]
+                    .constant_map
+                    .values()
+                    .map(|const_id| const_id.module)
+                    .filter(|target| target != file_id && pending.contains(target))
+                    .collect();
+                (*file_id, targets)
+            })
+            .collect();
 
-                // 合并 variable_reference
-                for (var_id, citers) in local_index.variable_reference {
+        let mut batches = Vec::new();
+        while !waiting.is_empty() {
+            let mut ready: HashSet<FileID> = waiting
+                .iter()
+                .filter(|(_, targets)| targets.is_empty())
+                .map(|(file_id, _)| *file_id)
+                .collect();
+            if ready.is_empty() {
+                ready = waiting.keys().copied().collect();
+            }
+            waiting.retain(|file_id, _| !ready.contains(file_id));
+            for targets in waiting.values_mut() {
+                targets.retain(|target| !ready.contains(target));
+            }
+            batches.push(ready);
+        }
+        batches
+    }
+
+    /// 模块中的引用所指向的模块
+    fn reference_targets(module: &Module) -> HashSet<FileID> {
+        module
+            .reference
+            .iter()
+            .map(|(_, refer)| match refer.tag {
+                ReferenceTag::VarRead(_) => module.file_id,
+                ReferenceTag::FieldRead(field_id) => field_id.module,
+                ReferenceTag::FuncCall(function_id) => function_id.module,
+                ReferenceTag::ConstRead(constant_id) => constant_id.module,
+            })
+            .collect()
+    }
+
+    /// 按被引用的模块分组收集单个模块中的引用
+    fn collect_module_references(module: &Module) -> HashMap<FileID, ModuleIndex> {
+        let mut local_temp: HashMap<FileID, ModuleIndex> = HashMap::new();
+
+        for (_, refer) in &module.reference {
+            match refer.tag {
+                ReferenceTag::VarRead(variable_id) => {
+                    let target_file_id = module.file_id;
+                    let index = local_temp.entry(target_file_id).or_default();
                     index
                         .variable_reference
-                        .entry(var_id)
+                        .entry(variable_id)
                         .or_default()
-                        .extend(citers);
+                        .push(CiterInfo::new(module.file_id, refer.range));
                 }
-
-                // 合并 field_reference
-                for (field_id, citers) in local_index.field_reference {
+                ReferenceTag::FieldRead(field_id) => {
+                    let target_file_id = field_id.module;
+                    let index = local_temp.entry(target_file_id).or_default();
                     index
                         .field_reference
                         .entry(field_id)
                         .or_default()
-                        .extend(citers);
+                        .push(CiterInfo::new(module.file_id, refer.range));
                 }
-
-                // 合并 function_reference
-                for (func_id, citers) in local_index.function_reference {
+                ReferenceTag::FuncCall(function_id) => {
+                    let target_file_id = function_id.module;
+                    let index = local_temp.entry(target_file_id).or_default();
                     index
                         .function_reference
-                        .entry(func_id)
+                        .entry(function_id)
+                        .or_default()
+                        .push(CiterInfo::new(module.file_id, refer.range));
+                }
+                ReferenceTag::ConstRead(constant_id) => {
+                    let target_file_id = constant_id.module;
+                    let index = local_temp.entry(target_file_id).or_default();
+                    index
+                        .constant_reference
+                        .entry(constant_id)
                         .or_default()
-                        .extend(citers);
+                        .push(CiterInfo::new(module.file_id, refer.range));
                 }
             }
         }
 
-        for (file_id, module) in &mut self.modules {
-            module.index = temp.remove(file_id).unwrap_or_default();
-            module.metadata = Some(Arc::clone(&self.metadata));
+        local_temp
+    }
+
+    /// 将收集到的引用合并到被引用模块的索引中
+    fn merge_references(&mut self, local_temp: HashMap<FileID, ModuleIndex>) {
+        for (file_id, local_index) in local_temp {
+            let Some(module) = self.modules.get_mut(&file_id) else {
+                continue;
+            };
+            let index = &mut module.index;
+
+            // 合并 variable_reference
+            for (var_id, citers) in local_index.variable_reference {
+                index
+                    .variable_reference
+                    .entry(var_id)
+                    .or_default()
+                    .extend(citers);
+            }
+
+            // 合并 field_reference
+            for (field_id, citers) in local_index.field_reference {
+                index
+                    .field_reference
+                    .entry(field_id)
+                    .or_default()
+                    .extend(citers);
+            }
+
+            // 合并 function_reference
+            for (func_id, citers) in local_index.function_reference {
+                index
+                    .function_reference
+                    .entry(func_id)
+                    .or_default()
+                    .extend(citers);
+            }
+
+            // 合并 constant_reference
+            for (const_id, citers) in local_index.constant_reference {
+                index
+                    .constant_reference
+                    .entry(const_id)
+                    .or_default()
+                    .extend(citers);
+            }
         }
+    }
 
-        // checker
-        for check in &mut self.checker {
-            let result = check.check_project(&self.modules);
-            for (file_id, errors) in result {
-                if let Some(module) = self.modules.get_mut(&file_id) {
-                    module.semantic_errors.extend(errors);
+    /// 运行所有 project 级别的检查
+    ///
+    /// 各个 checker 并行运行，只检查它们关心的、上次检查之后重新分析过的模块；
+    /// 返回的错误替换该 checker 上次为这些模块产生的错误
+    fn run_checkers(&mut self) {
+        let changed = self.unchecked.replace(HashSet::new());
+        if changed.as_ref().is_some_and(|changed| changed.is_empty()) {
+            return;
+        }
+
+        let _span = profile::span("checkers");
+        let modules = &self.modules;
+        let results: Vec<_> = self
+            .checker
+            .par_iter_mut()
+            .map(|check| {
+                let Some(changed) = &changed else {
+                    return check.check_project(modules, None);
+                };
+                // 已经不存在的模块也交给 checker，让它清理之前的状态
+                let needed: HashSet<FileID> = changed
+                    .iter()
+                    .copied()
+                    .filter(|file_id| modules.get(file_id).is_none_or(|m| check.needs_module(m)))
+                    .collect();
+                if needed.is_empty() {
+                    return HashMap::new();
                 }
+                check.check_project(modules, Some(&needed))
+            })
+            .collect();
+
+        let checker_count = self.checker.len();
+        for (i, result) in results.into_iter().enumerate() {
+            for (file_id, errors) in result {
+                let Some(module) = self.modules.get_mut(&file_id) else {
+                    continue;
+                };
+                let counts = self
+                    .checker_errors
+                    .entry(file_id)
+                    .or_insert_with(|| vec![0; checker_count]);
+                // 第 i 个 checker 的错误位于末尾的第 i 段
+                let total: usize = counts.iter().sum();
+                let start =
+                    module.semantic_errors.len() - total + counts[..i].iter().sum::<usize>();
+                let end = start + counts[i];
+                counts[i] = errors.len();
+                module.semantic_errors.splice(start..end, errors);
             }
         }
     }
@@ -214,34 +836,43 @@ impl Project {
                     .and_then(|n| n.name())
                     .and_then(|n| utils::extract_name_and_range(&n))
                 {
-                    if module.function_map.contains_key(&name) {
+                    let key = Name::new(&name);
+                    if module.function_map.contains_key(&key) {
                         module
                             .new_error(crate::error::AnalyzeError::FunctionDefined { name, range });
                         continue;
                     }
 
-                    let func_id = module.new_function(
-                        name.clone(),
-                        vec![],
-                        vec![],
-                        Ty::Void,
-                        false,
-                        false,
-                        range,
-                    );
-                    module.function_map.insert(name, func_id);
+                    let func_id =
+                        module.new_function(name, vec![], vec![], Ty::Void, false, false, range);
+                    module.function_map.insert(key, func_id);
+                }
+            } else if let Some(struct_def) = StructDef::cast(ele.clone()) {
+                if let Some((name, range)) = struct_def
+                    .name()
+                    .and_then(|n| utils::extract_name_and_range(&n))
+                {
+                    let key = Name::new(&name);
+                    if module.struct_map.contains_key(&key) {
+                        module.new_error(crate::error::AnalyzeError::StructDefined { name, range });
+                        continue;
+                    }
+                    let struct_id = module.new_struct(name, vec![], range);
+                    module.struct_map.insert(key, struct_id);
                 }
-            } else if let Some(struct_def) = StructDef::cast(ele)
-                && let Some((name, range)) = struct_def
+            } else if let Some(var_def) = VarDef::cast(ele)
+                && var_def.ty().is_some_and(|ty| is_const_type_node(&ty))
+                && let Some((name, range)) = var_def
                     .name()
                     .and_then(|n| utils::extract_name_and_range(&n))
             {
-                if module.struct_map.contains_key(&name) {
-                    module.new_error(crate::error::AnalyzeError::StructDefined { name, range });
+                // 重复定义由语义分析报告，这里只导出第一个
+                let key = Name::new(&name);
+                if module.constant_map.contains_key(&key) {
                     continue;
                 }
-                let struct_id = module.new_struct(name.clone(), vec![], range);
-                module.struct_map.insert(name, struct_id);
+                let const_id = module.new_constant(name, range);
+                module.constant_map.insert(key, const_id);
             }
         }
     }
@@ -256,7 +887,7 @@ impl Project {
 
         for struct_def in struct_defs {
             if let Some(name) = struct_def.name().and_then(|n| n.var_name()) {
-                let Some(&struct_id) = module.struct_map.get(&name) else {
+                let Some(struct_id) = module.get_struct_id_by_name(&name) else {
                     continue;
                 };
 
@@ -268,14 +899,7 @@ impl Project {
                     {
                         match crate::utils::parse_type_node(module, &ty_node, None) {
                             Ok(Some(field_ty)) => {
-                                let field = Field {
-                                    name: field_name,
-                                    ty: field_ty,
-                                    range: field_range,
-                                };
-
-                                let idx = module.fields.insert(field);
-                                let field_id = FieldID::new(module.file_id, idx);
+                                let field_id = module.new_field(field_name, field_ty, field_range);
                                 field_ids.push(field_id);
                             }
                             Ok(None) => {}
@@ -298,7 +922,7 @@ impl Project {
             if let Some(sign) = func_def.sign()
                 && let Some(name) = sign.name().and_then(|n| n.var_name())
             {
-                let Some(&func_id) = module.function_map.get(&name) else {
+                let Some(func_id) = module.get_function_id_by_name(&name) else {
                     continue;
                 };
 
@@ -357,3 +981,42 @@ impl Project {
         }
     }
 }
+
+/// 类型节点是否表示 const 类型，与 [`Ty::is_const`] 一致
+fn is_const_type_node(ty: &Type) -> bool {
+    if ty.l_brack_token().is_some() {
+        ty.inner_type()
+            .is_some_and(|inner| is_const_type_node(&inner))
+    } else if let Some(pointer) = ty.pointer() {
+        pointer.is_const()
+    } else {
+        ty.const_token().is_some()
+    }
+}
+
+/// 计时中使用的模块名：文件名去掉扩展名，与代码生成的模块名一致
+fn file_name(vfs: &VfsSnapshot, file_id: &FileID) -> String {
+    vfs.get_file_by_file_id(file_id)
+        .map(|file| path_file_name(&file.path))
+        .unwrap_or_default()
+}
+
+fn path_file_name(path: &std::path::Path) -> String {
+    path.file_stem()
+        .map(|name| name.to_string_lossy().into_owned())
+        .unwrap_or_default()
+}
+
+/// 统计语法树中的节点和 token 数量
+fn count_syntax_tree(green_tree: &GreenNode) {
+    let (mut nodes, mut tokens) = (0, 0);
+    for event in SyntaxNode::new_root(green_tree.clone()).preorder_with_tokens() {
+        match event {
+            WalkEvent::Enter(NodeOrToken::Node(_)) => nodes += 1,
+            WalkEvent::Enter(NodeOrToken::Token(_)) => tokens += 1,
+            WalkEvent::Leave(_) => {}
+        }
+    }
+    profile::count("syntax nodes", nodes);
+    profile::count("tokens", tokens);
+}
@@ -0,0 +1,232 @@
+//! 工作区符号索引
+//!
+//! 记录所有模块的全局变量、函数和结构体，按名称的小写三元组（trigram）建立倒排表。
+//! 长度不小于 3 的查询只需检查最短的一张倒排表，较短的查询扫描所有名称。
+//! 模块重新分析后只替换该模块的符号
+
+use std::collections::HashMap;
+
+use tools::{TextRange, hash::FxHashMap};
+use vfs::FileID;
+
+use crate::module::{Module, ThinModule};
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SymbolKind {
+    Variable,
+    Constant,
+    Function,
+    Struct,
+}
+
+#[derive(Debug, Clone)]
+pub struct Symbol {
+    pub name: String,
+    pub kind: SymbolKind,
+    pub file_id: FileID,
+    pub range: TextRange,
+}
+
+#[derive(Debug, Default)]
+pub struct SymbolIndex {
+    /// 符号及其小写名称，删除后的位置为 None，由 `free` 复用
+    symbols: Vec<Option<(Symbol, String)>>,
+    free: Vec<usize>,
+    by_file: HashMap<FileID, Vec<usize>>,
+    trigrams: FxHashMap<[char; 3], Vec<usize>>,
+}
+
+impl SymbolIndex {
+    pub fn clear(&mut self) {
+        *self = Self::default();
+    }
+
+    /// 用模块分析后的全局符号替换该模块原有的符号
+    pub fn update_module(&mut self, module: &Module) {
+        self.remove_file(module.file_id);
+
+        if let Some(global_scope) = module.scopes.get(*module.global_scope) {
+            for var_id in global_scope.variables.values() {
+                if let Some(variable) = module.variables.get(**var_id) {
+                    let kind = if variable.is_const() {
+                        SymbolKind::Constant
+                    } else {
+                        SymbolKind::Variable
+                    };
+                    self.insert(Symbol {
+                        name: variable.name.clone(),
+                        kind,
+                        file_id: module.file_id,
+                        range: variable.range,
+                    });
+                }
+            }
+        }
+        self.insert_definitions(module.file_id, &ThinModule::new(module));
+    }
+
+    /// 用缓存的元数据替换模块的符号，缓存模块只有全局常量，没有其他全局变量的信息
+    pub fn update_thin(&mut self, file_id: FileID, thin: &ThinModule) {
+        self.remove_file(file_id);
+        for (_, constant) in thin.constants.iter() {
+            self.insert(Symbol {
+                name: constant.name.clone(),
+                kind: SymbolKind::Constant,
+                file_id,
+                range: constant.range,
+            });
+        }
+        self.insert_definitions(file_id, thin);
+    }
+
+    pub fn remove_file(&mut self, file_id: FileID) {
+        for slot in self.by_file.remove(&file_id).unwrap_or_default() {
+            let Some((_, lower)) = self.symbols[slot].take() else {
+                continue;
+            };
+            for trigram in trigrams(&lower) {
+                if let Some(postings) = self.trigrams.get_mut(&trigram) {
+                    postings.retain(|&s| s != slot);
+                    if postings.is_empty() {
+                        self.trigrams.remove(&trigram);
+                    }
+                }
+            }
+            self.free.push(slot);
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.symbols.len() - self.free.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// 搜索名称包含 `query`（不区分大小写）的符号，按 [`match_score`] 排序
+    ///
+    /// 空查询返回所有符号
+    pub fn search(&self, query: &str) -> Vec<&Symbol> {
+        let query = query.to_lowercase();
+        let mut matches: Vec<_> = match self.candidates(&query) {
+            Some(slots) => slots
+                .iter()
+                .filter_map(|&slot| self.symbols[slot].as_ref())
+                .filter_map(|(symbol, lower)| Some((score(&symbol.name, lower, &query)?, symbol)))
+                .collect(),
+            None => self
+                .symbols
+                .iter()
+                .flatten()
+                .filter_map(|(symbol, lower)| Some((score(&symbol.name, lower, &query)?, symbol)))
+                .collect(),
+        };
+        matches.sort_by(|(a_score, a), (b_score, b)| {
+            (a_score, a.name.len(), &a.name).cmp(&(b_score, b.name.len(), &b.name))
+        });
+        matches.into_iter().map(|(_, symbol)| symbol).collect()
+    }
+
+    /// 可能匹配 `query` 的符号。查询太短没有三元组时返回 None，表示需要检查所有符号
+    fn candidates(&self, query: &str) -> Option<&[usize]> {
+        let mut shortest: Option<&[usize]> = None;
+        for trigram in trigrams(query) {
+            let postings = self.trigrams.get(&trigram).map_or(&[][..], Vec::as_slice);
+            if shortest.is_none_or(|s| postings.len() < s.len()) {
+                shortest = Some(postings);
+            }
+        }
+        shortest
+    }
+
+    fn insert_definitions(&mut self, file_id: FileID, thin: &ThinModule) {
+        for (_, function) in thin.functions.iter() {
+            self.insert(Symbol {
+                name: function.name.clone(),
+                kind: SymbolKind::Function,
+                file_id,
+                range: function.range,
+            });
+        }
+        for (_, struct_def) in thin.structs.iter() {
+            self.insert(Symbol {
+                name: struct_def.name.clone(),
+                kind: SymbolKind::Struct,
+                file_id,
+                range: struct_def.range,
+            });
+        }
+    }
+
+    fn insert(&mut self, symbol: Symbol) {
+        let lower = symbol.name.to_lowercase();
+        let file_id = symbol.file_id;
+        let entry = Some((symbol, lower.clone()));
+        let slot = match self.free.pop() {
+            Some(slot) => {
+                self.symbols[slot] = entry;
+                slot
+            }
+            None => {
+                self.symbols.push(entry);
+                self.symbols.len() - 1
+            }
+        };
+        for trigram in trigrams(&lower) {
+            self.trigrams.entry(trigram).or_default().push(slot);
+        }
+        self.by_file.entry(file_id).or_default().push(slot);
+    }
+}
+
+/// 名称与查询的匹配程度，越小越好；不包含查询（不区分大小写）时返回 None
+///
+/// 完全相同为 0，前缀为 1，从单词边界（`_` 之后或大写字母）开始为 2，其余位置为 3
+pub fn match_score(name: &str, query: &str) -> Option<u32> {
+    score(name, &name.to_lowercase(), &query.to_lowercase())
+}
+
+/// `name_lower` 和 `query` 已转为小写
+fn score(name: &str, name_lower: &str, query: &str) -> Option<u32> {
+    match score_lower(name_lower, query)? {
+        3 if is_camel_boundary(name, name_lower, query) => Some(2),
+        other => Some(other),
+    }
+}
+
+/// 只比较小写形式，不识别大写字母开始的单词
+fn score_lower(name: &str, query: &str) -> Option<u32> {
+    if name == query {
+        return Some(0);
+    }
+    if name.starts_with(query) {
+        return Some(1);
+    }
+    let mut score = None;
+    for (start, _) in name.match_indices(query) {
+        if name[..start].ends_with('_') {
+            return Some(2);
+        }
+        score = Some(3);
+    }
+    score
+}
+
+fn is_camel_boundary(name: &str, name_lower: &str, query: &str) -> bool {
+    // 小写转换可能改变字节长度，此时不判断大小写边界
+    name.len() == name_lower.len()
+        && name_lower.match_indices(query).any(|(start, _)| {
+            name.get(start..)
+                .is_some_and(|rest| rest.starts_with(char::is_uppercase))
+        })
+}
+
+/// 字符串中所有不重复的三元组
+fn trigrams(text: &str) -> Vec<[char; 3]> {
+    let chars: Vec<char> = text.chars().collect();
+    let mut trigrams: Vec<_> = chars.windows(3).map(|w| [w[0], w[1], w[2]]).collect();
+    trigrams.sort_unstable();
+    trigrams.dedup();
+    trigrams
+}
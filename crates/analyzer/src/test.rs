@@ -1279,3 +1279,640 @@ fn test_function_params_new_types() {
     let module = analyze(source);
     assert!(module.semantic_errors.is_empty());
 }
+
+/// 在临时目录中创建多文件项目，返回 Vfs 以及各文件的 FileID（顺序与 `files` 一致）
+fn setup_project(name: &str, files: &[(&str, &str)]) -> (Vfs, Vec<vfs::FileID>) {
+    let dir = std::env::temp_dir().join(format!("airyc-analyzer-{}-{}", name, std::process::id()));
+    std::fs::create_dir_all(&dir).unwrap();
+
+    let vfs = Vfs::default();
+    let file_ids = files
+        .iter()
+        .map(|(file_name, text)| {
+            let path = dir.join(file_name);
+            std::fs::write(&path, text).unwrap();
+            vfs.new_file(path.canonicalize().unwrap(), text.to_string())
+        })
+        .collect();
+    (vfs, file_ids)
+}
+
+#[test]
+fn test_incremental_update_body_only() {
+    let lib = "fn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 { return add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("body-only", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+    let main_tree = project.modules[&main_id].green_tree.clone();
+
+    vfs.update_file(
+        &lib_id,
+        "fn add(x: i32, y: i32) -> i32 { return x - y; }".to_string(),
+    );
+    project.update_file(&vfs, lib_id);
+
+    // 接口未变化，依赖方不需要重新分析
+    assert!(std::ptr::eq::<rowan::GreenNodeData>(
+        &*main_tree,
+        &*project.modules[&main_id].green_tree
+    ));
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+
+    // 依赖方对被修改模块的引用仍然保留
+    let lib_module = &project.modules[&lib_id];
+    let add_id = lib_module.get_function_id_by_name("add").unwrap();
+    let citers = &lib_module.index.function_reference[&add_id];
+    assert_eq!(citers.len(), 1);
+    assert_eq!(citers[0].file_id, main_id);
+}
+
+#[test]
+fn test_incremental_update_signature_change() {
+    let lib = "fn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 { return add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("signature", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+
+    vfs.update_file(&lib_id, "fn add(x: i32) -> i32 { return x; }".to_string());
+    project.update_file(&vfs, lib_id);
+    assert!(
+        project.modules[&main_id]
+            .semantic_errors
+            .iter()
+            .any(|e| matches!(e, AnalyzeError::ArgumentCountMismatch { .. }))
+    );
+
+    vfs.update_file(&lib_id, lib.to_string());
+    project.update_file(&vfs, lib_id);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+    assert_eq!(
+        project.modules[&lib_id]
+            .index
+            .function_reference
+            .values()
+            .map(Vec::len)
+            .sum::<usize>(),
+        1
+    );
+}
+
+#[test]
+fn test_dependency_graph_and_fingerprint() {
+    let base = "struct Point { x: i32, y: i32 }\nfn zero() -> i32 { return 0; }";
+    let mid = r#"
+        import "base.airy"
+        fn origin_x(p: *mut struct Point) -> i32 { return zero(); }
+    "#;
+    let top = r#"
+        import "mid.airy"
+        fn main() -> i32 { return 0; }
+    "#;
+    let (vfs, ids) = setup_project(
+        "dependency",
+        &[("base.airy", base), ("mid.airy", mid), ("top.airy", top)],
+    );
+    let (base_id, mid_id, top_id) = (ids[0], ids[1], ids[2]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+
+    assert_eq!(project.dependency.imports_of(mid_id), &[base_id]);
+    let closure = project.dependency.reverse_closure(base_id);
+    assert_eq!(closure.len(), 2);
+    assert!(closure.contains(&mid_id) && closure.contains(&top_id));
+    let closure = project.dependency.import_closure(top_id);
+    assert_eq!(closure.len(), 2);
+    assert!(closure.contains(&mid_id) && closure.contains(&base_id));
+
+    // 修改函数体不改变接口指纹
+    let fingerprint = project.fingerprints[&base_id];
+    vfs.update_file(
+        &base_id,
+        "struct Point { x: i32, y: i32 }\nfn zero() -> i32 { return 1 - 1; }".to_string(),
+    );
+    project.update_file(&vfs, base_id);
+    assert_eq!(project.fingerprints[&base_id], fingerprint);
+
+    // 修改结构体字段改变接口指纹
+    vfs.update_file(
+        &base_id,
+        "struct Point { x: i64, y: i32 }\nfn zero() -> i32 { return 0; }".to_string(),
+    );
+    project.update_file(&vfs, base_id);
+    assert_ne!(project.fingerprints[&base_id], fingerprint);
+    assert_eq!(project.dependency.imports_of(top_id), &[mid_id]);
+}
+
+#[test]
+fn test_incremental_update_with_edit() {
+    let main = "fn main() -> i32 {\n    let a: i32 = 1;\n    return a;\n}\n";
+    let (vfs, ids) = setup_project("edit", &[("main.airy", main)]);
+    let main_id = ids[0];
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+
+    let new_text = main.replace("return a;", "return b;");
+    let edit = tools::TextEdit::diff(main, &new_text).unwrap();
+    vfs.update_file(&main_id, new_text);
+    project.update_file_with_edit(&vfs, main_id, &edit);
+    assert!(
+        project.modules[&main_id]
+            .semantic_errors
+            .iter()
+            .any(|e| matches!(e, AnalyzeError::VariableUndefined { .. }))
+    );
+
+    let edit = tools::TextEdit::diff(&main.replace("return a;", "return b;"), main).unwrap();
+    vfs.update_file(&main_id, main.to_string());
+    project.update_file_with_edit(&vfs, main_id, &edit);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+}
+
+#[test]
+fn test_initialize_with_cache() {
+    let lib = "struct Point { x: i32, y: i32 }\nfn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 {
+            let p: struct Point = {1, 2};
+            return add(p.x, p.y);
+        }
+    "#;
+    let (vfs, ids) = setup_project("cache", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    let lib_thin = project.metadata[&lib_id].clone();
+    let fingerprint = project.fingerprints[&lib_id];
+
+    // 缓存模块不再解析，依赖方从缓存的元数据导入符号
+    let mut cached = Project::new();
+    cached.initialize_with_cache(&vfs, std::collections::HashMap::from([(lib_id, lib_thin)]));
+    assert!(!cached.modules.contains_key(&lib_id));
+    assert!(cached.modules[&main_id].semantic_errors.is_empty());
+    assert_eq!(cached.fingerprints[&lib_id], fingerprint);
+    assert_eq!(
+        cached.modules[&main_id].get_function_id_by_name("add"),
+        project.modules[&main_id].get_function_id_by_name("add")
+    );
+
+    // 转为完整模块后补上依赖方的引用
+    cached.materialize(&vfs, &[lib_id]);
+    let lib_module = &cached.modules[&lib_id];
+    assert!(lib_module.semantic_errors.is_empty());
+    let add_id = lib_module.get_function_id_by_name("add").unwrap();
+    assert_eq!(lib_module.index.function_reference[&add_id].len(), 1);
+    assert_eq!(cached.fingerprints[&lib_id], fingerprint);
+}
+
+#[test]
+fn test_materialize_rebuilds_dependents() {
+    let lib = "fn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 { return add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("materialize", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    let lib_thin = project.metadata[&lib_id].clone();
+
+    // 缓存的元数据已经过期，依赖方按旧的签名分析
+    vfs.update_file(&lib_id, "fn add(x: i32) -> i32 { return x; }".to_string());
+    let mut cached = Project::new();
+    cached.initialize_with_cache(&vfs, std::collections::HashMap::from([(lib_id, lib_thin)]));
+    assert!(cached.modules[&main_id].semantic_errors.is_empty());
+
+    // 重新分析后接口变化，依赖方也重新分析
+    cached.materialize(&vfs, &[lib_id]);
+    assert!(!cached.modules[&main_id].semantic_errors.is_empty());
+    let lib_module = &cached.modules[&lib_id];
+    let add_id = lib_module.get_function_id_by_name("add").unwrap();
+    assert_eq!(lib_module.index.function_reference[&add_id].len(), 1);
+}
+
+#[test]
+fn test_cancelled_update_resumes() {
+    let lib = "fn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 { return add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("cancel", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(project.is_complete());
+
+    // 取消后修改的模块没有分析，依赖方也还没有重新分析
+    let cancel = crate::cancel::CancelToken::new();
+    cancel.cancel();
+    project.set_cancel_token(cancel);
+    vfs.update_file(&lib_id, "fn add(x: i32) -> i32 { return x; }".to_string());
+    project.update_file(&vfs, lib_id);
+    assert!(!project.is_complete());
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+
+    // 换上新的标记后完成分析，接口变化传播到依赖方
+    project.set_cancel_token(crate::cancel::CancelToken::new());
+    project.resume(&vfs);
+    assert!(project.is_complete());
+    assert!(!project.modules[&main_id].semantic_errors.is_empty());
+    assert!(
+        project.metadata[&lib_id]
+            .functions
+            .iter()
+            .any(|(_, f)| f.params.len() == 1)
+    );
+}
+
+#[test]
+fn test_metadata_shares_module_symbols() {
+    let lib = "struct Point { x: i32, y: i32 }\nfn add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 { return add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("shared", &[("lib.airy", lib), ("main.airy", main)]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    let shared = |project: &Project| {
+        ids.iter().all(|file_id| {
+            let (module, thin) = (&project.modules[file_id], &project.metadata[file_id]);
+            std::sync::Arc::ptr_eq(&module.functions, &thin.functions)
+                && std::sync::Arc::ptr_eq(&module.structs, &thin.structs)
+                && std::sync::Arc::ptr_eq(&module.fields, &thin.fields)
+        })
+    };
+    assert!(shared(&project));
+
+    vfs.update_file(&ids[0], format!("{}\nfn sub() -> i32 {{ return 0; }}", lib));
+    project.update_file(&vfs, ids[0]);
+    assert!(shared(&project));
+}
+
+#[test]
+fn test_const_array_flat() {
+    let source = r#"
+    let table: const [[i32; 16]; 3] = {{1, -2}, {}, {0, 0, 0, 9}};
+    fn main() -> i32 {
+        let a: const i32 = table[0][1];
+        let b: const i32 = table[2][3];
+        let c: const i32 = table[1][2];
+        return a + b + c;
+    }
+    "#;
+    let module = analyze(source);
+    assert!(module.semantic_errors.is_empty());
+
+    let value_of = |name: &str| {
+        let (_, var) = module
+            .variables
+            .iter()
+            .find(|(_, v)| v.name == name)
+            .unwrap();
+        module.value_table.get(&var.range).cloned()
+    };
+    let Some(crate::value::Value::FlatArray(flat)) = value_of("table") else {
+        panic!("Expected flat array");
+    };
+    assert_eq!(flat.shape, vec![3, 16]);
+    assert!(flat.is_zero(16, 16));
+    assert_eq!(flat.row(32, 4), vec![0, 0, 0, 9]);
+    // 初始化列表内的常量已经释放，只保留整个列表的值
+    let init = tools::TextRange::new(
+        source.find("{{1").unwrap() as u32,
+        (source.find("9}}").unwrap() + 3) as u32,
+    );
+    assert!(
+        module
+            .value_table
+            .iter()
+            .filter(|(range, _)| init.contains_range(range.0))
+            .all(|(_, value)| matches!(value, crate::value::Value::FlatArray(_))),
+        "{:?}",
+        module.value_table
+    );
+    assert_eq!(value_of("a"), Some(crate::value::Value::I32(-2)));
+    assert_eq!(value_of("b"), Some(crate::value::Value::I32(9)));
+    assert_eq!(value_of("c"), Some(crate::value::Value::I32(0)));
+}
+
+#[test]
+fn test_symbol_index() {
+    use crate::symbol_index::{SymbolKind, match_score};
+
+    let lib =
+        "struct Point { x: i32, y: i32 }\nfn point_add(x: i32, y: i32) -> i32 { return x + y; }";
+    let main = r#"
+        import "lib.airy"
+        let max_points: const i32 = 8;
+        fn main() -> i32 { let local_point: i32 = 1; return point_add(1, 2); }
+    "#;
+    let (vfs, ids) = setup_project("symbols", &[("lib.airy", lib), ("main.airy", main)]);
+    let (lib_id, main_id) = (ids[0], ids[1]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert_eq!(project.symbols.len(), 4);
+
+    // 只包含全局符号，按匹配程度排序
+    let names = |project: &Project, query: &str| {
+        project
+            .symbols
+            .search(query)
+            .iter()
+            .map(|symbol| symbol.name.clone())
+            .collect::<Vec<_>>()
+    };
+    assert_eq!(
+        names(&project, "POINT"),
+        ["Point", "point_add", "max_points"]
+    );
+    assert_eq!(names(&project, "ma"), ["main", "max_points"]);
+    assert_eq!(names(&project, "").len(), 4);
+    let max_points = &project.symbols.search("max_points")[0];
+    assert_eq!(max_points.kind, SymbolKind::Constant);
+    assert_eq!(max_points.file_id, main_id);
+
+    // 重新分析后只替换该模块的符号
+    vfs.update_file(&lib_id, "fn point_sub() -> i32 { return 0; }".to_string());
+    project.update_file(&vfs, lib_id);
+    assert_eq!(names(&project, "point"), ["point_sub", "max_points"]);
+    assert_eq!(project.symbols.len(), 3);
+
+    assert_eq!(match_score("add", "add"), Some(0));
+    assert_eq!(match_score("addOne", "add"), Some(1));
+    assert_eq!(match_score("one_add", "add"), Some(2));
+    assert_eq!(match_score("oneAdd", "add"), Some(2));
+    assert_eq!(match_score("padd", "add"), Some(3));
+    assert_eq!(match_score("sub", "add"), None);
+}
+
+#[test]
+fn test_load_imports() {
+    let base = "fn zero() -> i32 { return 0; }";
+    let lib = "import \"nested/base\"\nfn one() -> i32 { return zero() + 1; }";
+    let main = r#"
+        import "lib.airy" :: one
+        fn main() -> i32 { return one(); }
+    "#;
+    let (disk, ids) = setup_project(
+        "load-imports",
+        &[
+            ("main.airy", main),
+            ("lib.airy", lib),
+            ("unused.airy", "fn unused() -> i32 { return 0; }"),
+        ],
+    );
+    let dir = disk
+        .get_file_by_file_id(&ids[0])
+        .unwrap()
+        .path
+        .parent()
+        .unwrap()
+        .to_path_buf();
+    std::fs::create_dir_all(dir.join("nested")).unwrap();
+    std::fs::write(dir.join("nested/base.airy"), base).unwrap();
+
+    // 只给出入口文件，导入的文件从磁盘读取，没有被导入的文件不加载
+    let vfs = Vfs::default();
+    let main_path = dir.join("main.airy");
+    let main_id = vfs.new_file(main_path, main.to_string());
+    crate::header::HeaderAnalyzer::load_imports(&vfs, &[main_id]);
+    assert_eq!(vfs.file_ids().len(), 3);
+    assert!(vfs.get_file_id_by_path(&dir.join("lib.airy")).is_some());
+    assert!(
+        vfs.get_file_id_by_path(&dir.join("nested/base.airy").canonicalize().unwrap())
+            .is_some()
+    );
+    assert!(vfs.get_file_id_by_path(&dir.join("unused.airy")).is_none());
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(
+        project
+            .modules
+            .values()
+            .all(|m| m.semantic_errors.is_empty())
+    );
+}
+
+#[test]
+fn test_imported_constants() {
+    let config = r#"
+        let SIZE: const i32 = 4 * 2;
+        let TABLE: [const i32; 3] = {10, 20, 30};
+    "#;
+    let mid = r#"
+        import "config.airy" :: SIZE
+        let DOUBLE: const i32 = SIZE * 2;
+    "#;
+    let main = r#"
+        import "config.airy"
+        import "mid.airy"
+        fn main() -> i32 {
+            let buf: [i32; DOUBLE];
+            return TABLE[1] + SIZE;
+        }
+    "#;
+    // 依赖方排在前面，分析顺序不能依赖文件顺序
+    let (vfs, ids) = setup_project(
+        "constants",
+        &[
+            ("main.airy", main),
+            ("mid.airy", mid),
+            ("config.airy", config),
+        ],
+    );
+    let (main_id, config_id) = (ids[0], ids[2]);
+
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    for module in project.modules.values() {
+        assert!(
+            module.semantic_errors.is_empty(),
+            "{:?}",
+            module.semantic_errors
+        );
+    }
+
+    // 导入的常量决定数组大小，并折叠为常量
+    let main_module = &project.modules[&main_id];
+    let buf = main_module
+        .variables
+        .iter()
+        .find(|(_, v)| v.name == "buf")
+        .map(|(_, v)| v.ty.clone())
+        .unwrap();
+    assert_eq!(
+        buf,
+        crate::r#type::Ty::Array(Box::new(crate::r#type::Ty::I32), Some(16))
+    );
+    assert!(
+        main_module
+            .value_table
+            .values()
+            .any(|v| *v == crate::value::Value::I32(28))
+    );
+
+    // 常量的引用记录在定义它的模块中
+    let config_module = &project.modules[&config_id];
+    let size_id = config_module.get_constant_id_by_name("SIZE").unwrap();
+    assert_eq!(config_module.index.constant_reference[&size_id].len(), 2);
+
+    // 常量的值是接口的一部分，改变后依赖方重新求值
+    vfs.update_file(
+        &config_id,
+        "let SIZE: const i32 = 5;\nlet TABLE: [const i32; 3] = {10, 20, 30};".to_string(),
+    );
+    project.update_file(&vfs, config_id);
+    let buf = project.modules[&main_id]
+        .variables
+        .iter()
+        .find(|(_, v)| v.name == "buf")
+        .map(|(_, v)| v.ty.clone())
+        .unwrap();
+    assert_eq!(
+        buf,
+        crate::r#type::Ty::Array(Box::new(crate::r#type::Ty::I32), Some(10))
+    );
+}
+
+#[test]
+fn test_imported_constant_errors() {
+    let lib = "let LIMIT: const i32 = 10;";
+    let main = r#"
+        import "lib.airy"
+        fn main() -> i32 {
+            LIMIT = 3;
+            return LIMIT;
+        }
+    "#;
+    let (vfs, ids) = setup_project("constant-assign", &[("lib.airy", lib), ("main.airy", main)]);
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(
+        project.modules[&ids[1]]
+            .semantic_errors
+            .iter()
+            .any(|e| matches!(e, AnalyzeError::AssignToConst { name, .. } if name == "LIMIT"))
+    );
+
+    // 循环导入的常量无法求值
+    let a = "import \"b.airy\"\nlet A: const i32 = B + 1;";
+    let b = "import \"a.airy\"\nlet B: const i32 = A + 1;";
+    let (vfs, _) = setup_project("constant-cycle", &[("a.airy", a), ("b.airy", b)]);
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    assert!(project.modules.values().any(|m| {
+        m.semantic_errors
+            .iter()
+            .any(|e| matches!(e, AnalyzeError::ImportedConstantUnavailable { .. }))
+    }));
+}
+
+/// 模块中报告为递归类型的结构体名字，按名字排序
+fn recursive_structs(module: &Module) -> Vec<String> {
+    let mut names: Vec<_> = module
+        .semantic_errors
+        .iter()
+        .filter_map(|e| match e {
+            AnalyzeError::RecursiveType { struct_name, .. } => Some(struct_name.clone()),
+            _ => None,
+        })
+        .collect();
+    names.sort();
+    names
+}
+
+#[test]
+fn test_recursive_type_checker() {
+    use crate::checker::RecursiveTypeChecker;
+
+    let shapes = r#"
+        struct Node { next: struct Node, value: i32 }
+        struct A { b: [struct B; 2] }
+        struct B { a: const struct A }
+        struct List { next: *mut struct List }
+    "#;
+    let (vfs, ids) = setup_project("recursive-type", &[("shapes.airy", shapes)]);
+    let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
+    project.full_initialize(&vfs);
+    assert_eq!(
+        recursive_structs(&project.modules[&ids[0]]),
+        vec!["A", "B", "Node"]
+    );
+    // 自环只报告一次
+    let cycle = project.modules[&ids[0]]
+        .semantic_errors
+        .iter()
+        .find_map(|e| match e {
+            AnalyzeError::RecursiveType {
+                struct_name, cycle, ..
+            } if struct_name == "Node" => Some(cycle.clone()),
+            _ => None,
+        });
+    assert_eq!(cycle, Some(vec!["Node".to_string(), "Node".to_string()]));
+}
+
+#[test]
+fn test_recursive_type_checker_incremental() {
+    use crate::checker::RecursiveTypeChecker;
+
+    let a = "struct A { b: *mut struct B }\nstruct B { a: struct A }";
+    let main = "fn main() -> i32 { return 0; }";
+    let (vfs, ids) = setup_project("recursive-type-inc", &[("a.airy", a), ("main.airy", main)]);
+    let (a_id, main_id) = (ids[0], ids[1]);
+    let mut project = Project::new().with_checker::<RecursiveTypeChecker>();
+    project.full_initialize(&vfs);
+    assert!(recursive_structs(&project.modules[&a_id]).is_empty());
+
+    // 把指针改为按值包含，形成环
+    vfs.update_file(
+        &a_id,
+        "struct A { b: struct B }\nstruct B { a: struct A }".to_string(),
+    );
+    project.update_file(&vfs, a_id);
+    assert_eq!(recursive_structs(&project.modules[&a_id]), vec!["A", "B"]);
+
+    // 不相关的模块变化不影响已有的错误
+    vfs.update_file(&main_id, "fn main() -> i32 { return 1; }".to_string());
+    project.update_file(&vfs, main_id);
+    assert_eq!(recursive_structs(&project.modules[&a_id]), vec!["A", "B"]);
+    assert!(project.modules[&main_id].semantic_errors.is_empty());
+
+    // 环缩小为自环
+    vfs.update_file(
+        &a_id,
+        "struct A { a: struct A }\nstruct B { a: struct A }".to_string(),
+    );
+    project.update_file(&vfs, a_id);
+    assert_eq!(recursive_structs(&project.modules[&a_id]), vec!["A"]);
+
+    // 打破环之后错误消失
+    vfs.update_file(&a_id, a.to_string());
+    project.update_file(&vfs, a_id);
+    assert!(recursive_structs(&project.modules[&a_id]).is_empty());
+}
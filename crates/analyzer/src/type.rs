@@ -11,7 +11,7 @@ pub enum UnaryOpError {
     InvalidOp,
 }
 
-#[derive(Debug, Clone, PartialEq, Eq)]
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
 pub enum Ty {
     I32,
     I8,
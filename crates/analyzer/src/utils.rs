@@ -1,13 +1,13 @@
-use std::collections::HashMap;
+use std::sync::Arc;
 
 use syntax::SyntaxKind;
 use syntax::ast::{AstNode as _, Expr, IndexVal, InitVal, OpNode, PostfixExpr, Type, UnaryExpr};
-use tools::TextRange;
+use tools::{TextRange, hash::FxHashMap};
 
 use crate::{
-    array::ArrayTree,
+    array::{ArrayTree, ArrayTreeValue, FlatArray},
     error::AnalyzeError,
-    module::{Module, StructID},
+    module::{ConstantID, Module, ReferenceTag, StructID},
     r#type::Ty,
     value::Value,
 };
@@ -23,7 +23,7 @@ use crate::{
 pub fn parse_type_node(
     module: &Module,
     ty_node: &Type,
-    value_table: Option<&HashMap<TextRange, Value>>,
+    value_table: Option<&FxHashMap<TextRange, Value>>,
 ) -> Result<Option<Ty>, AnalyzeError> {
     if ty_node.l_brack_token().is_some() {
         // 数组类型: [Type; Expr]
@@ -165,6 +165,102 @@ impl Module {
         }
     }
 
+    /// 按 `node` 中的下标从常量 `value` 中取值
+    ///
+    /// 不是数组的值直接返回；下标或元素不是编译时常量时返回 None
+    pub(crate) fn index_const_value(
+        &self,
+        node: &IndexVal,
+        value: &Value,
+        const_zero: Value,
+    ) -> Result<Option<Value>, AnalyzeError> {
+        if !matches!(value, Value::Array(_) | Value::FlatArray(_)) {
+            return Ok(Some(value.clone()));
+        }
+
+        let mut indices = Vec::new();
+        for indice in node.indices() {
+            let Some(v) = self.get_value_by_range(indice.text_range()) else {
+                return Ok(None);
+            };
+            let Some(index) = v.get_array_size() else {
+                return Err(AnalyzeError::TypeMismatch {
+                    expected: Ty::I32,
+                    found: v.get_type(self),
+                    range: utils::trim_node_text_range(&indice),
+                });
+            };
+            indices.push(index);
+        }
+        let leaf = match value {
+            Value::FlatArray(flat) => flat.get(&indices).map(Some),
+            Value::Array(tree) => tree.get_leaf(&indices).map(|leaf| match leaf {
+                ArrayTreeValue::Expr(range)
+                | ArrayTreeValue::Struct {
+                    init_list: range, ..
+                } => self.value_table.get(&range).cloned(),
+                ArrayTreeValue::Empty => Some(const_zero),
+            }),
+            _ => unreachable!(),
+        };
+        leaf.map_err(|e| AnalyzeError::ArrayError {
+            message: Box::new(e),
+            range: utils::trim_node_text_range(node),
+        })
+    }
+
+    /// 读取导入的全局常量
+    ///
+    /// 常量在定义它的模块中已经求值，这里直接使用元数据中的值，不再分析定义处的表达式
+    pub(crate) fn leave_imported_constant(
+        &mut self,
+        node: IndexVal,
+        name_range: TextRange,
+        const_id: ConstantID,
+    ) {
+        self.new_reference(name_range, ReferenceTag::ConstRead(const_id));
+
+        let Some(constant) = self.get_constant_by_id(const_id) else {
+            return;
+        };
+        // 定义所在的模块还没有分析，类型仍是分配时的占位
+        if constant.ty == Ty::Void {
+            let name = constant.name.clone();
+            self.new_error(AnalyzeError::ImportedConstantUnavailable {
+                name,
+                range: name_range,
+            });
+            return;
+        }
+
+        let result_ty = match Self::compute_indexed_type(
+            &constant.ty,
+            node.indices().count(),
+            utils::trim_node_text_range(&node),
+        ) {
+            Ok(ty) => ty,
+            Err(e) => {
+                self.new_error(e);
+                return;
+            }
+        };
+        let folded = match &constant.value {
+            Some(value) if constant.ty.is_const() && result_ty.is_const() => {
+                self.index_const_value(&node, value, constant.ty.const_zero())
+            }
+            _ => Ok(None),
+        };
+        self.set_expr_type(node.text_range(), result_ty);
+
+        match folded {
+            Ok(Some(value)) => {
+                self.value_table.insert(node.text_range(), value);
+            }
+            Ok(None) => {}
+            Err(e) => self.new_error(e),
+        }
+    }
+
     /// 解析 struct 初始化列表，返回 Value::Struct
     /// 如果非常量初始化列表，返回 None
     /// 一定要遍历所有子树，目的是初始化 ArrayTree
@@ -269,7 +365,7 @@ impl Module {
             // 数组类型：使用 ArrayTree 解析
             Ty::Array(_, _) => {
                 let range = init_val_node.text_range();
-                let (array_tree, is_const) = ArrayTree::new(self, field_ty, init_val_node)
+                let (array_tree, is_const) = ArrayTree::new(self, field_ty, init_val_node.clone())
                     .map_err(|e| AnalyzeError::ArrayError {
                         message: Box::new(e),
                         range,
@@ -279,11 +375,11 @@ impl Module {
                     self.expand_array.insert(range, array_tree);
                     return Ok(None);
                 }
-                self.expand_array.insert(range, array_tree.clone());
-                self.value_table
-                    .insert(range, Value::Array(array_tree.clone()));
-
-                Ok(Some(Value::Array(array_tree)))
+                Ok(Some(self.insert_const_array(
+                    &init_val_node,
+                    field_ty,
+                    array_tree,
+                )))
             }
 
             // Struct 类型：递归解析
@@ -302,6 +398,26 @@ impl Module {
         }
     }
 
+    /// 把常量数组 `init` 写入常量表并返回它的值
+    ///
+    /// 整数或布尔数组使用扁平表示。扁平数组不再引用叶子表达式，初始化列表内的常量随
+    /// `ArrayTree` 一起释放，大的查找表在常量表中只占一项
+    pub(crate) fn insert_const_array(&mut self, init: &InitVal, ty: &Ty, tree: ArrayTree) -> Value {
+        let value = match FlatArray::new(&tree, ty, &self.value_table) {
+            Some(flat) => {
+                drop(tree);
+                for node in init.syntax().descendants() {
+                    self.value_table.remove(&node.text_range());
+                }
+                Value::FlatArray(Arc::new(flat))
+            }
+            None => Value::Array(tree),
+        };
+        self.value_table
+            .insert(init.syntax().text_range(), value.clone());
+        value
+    }
+
     /// 返回 true 如果是有效的左值
     pub(crate) fn is_lvalue_expr(&self, expr: &Expr) -> bool {
         match expr {
@@ -334,6 +450,16 @@ impl Module {
         };
 
         let Some(def_id) = self.find_variable_def(&var_name) else {
+            // 导入的常量不可被赋值
+            if self
+                .get_constant_id_by_name(&var_name)
+                .is_some_and(|id| id.module != self.file_id)
+            {
+                self.new_error(AnalyzeError::AssignToConst {
+                    name: var_name.to_string(),
+                    range: var_range,
+                });
+            }
             return false;
         };
 
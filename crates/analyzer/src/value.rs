@@ -1,12 +1,14 @@
+use std::sync::Arc;
+
 use syntax::SyntaxKind;
 
 use crate::{
-    array::ArrayTree,
+    array::{ArrayTree, FlatArray},
     module::{Module, StructID},
     r#type::Ty,
 };
 
-#[derive(Debug, Clone, PartialEq)]
+#[derive(Debug, Clone, PartialEq, Hash)]
 pub enum Value {
     I32(i32),
     I8(i8),
@@ -17,6 +19,8 @@ pub enum Value {
     Bool(bool),
     String(String),
     Array(ArrayTree),
+    /// 整数或布尔元素的常量数组
+    FlatArray(Arc<FlatArray>),
     Struct(StructID, Vec<Value>),
     StructZero(StructID),
     Null,
@@ -219,7 +223,7 @@ impl Value {
                 pointee: Box::new(Ty::U8),
                 is_const: true,
             },
-            Value::Array(_) => Ty::Array(Box::new(Ty::Void), None),
+            Value::Array(_) | Value::FlatArray(_) => Ty::Array(Box::new(Ty::Void), None),
             Value::Struct(struct_id, _) => {
                 let name = module
                     .get_struct_by_id(*struct_id)
@@ -389,4 +393,15 @@ impl Value {
             _ => None,
         }
     }
+
+    /// 值是否不依赖模块的常量表，可以放入跨模块的元数据
+    ///
+    /// [`Value::Array`] 的叶子是所在模块中表达式的位置，离开该模块无法求值
+    pub fn is_portable(&self) -> bool {
+        match self {
+            Value::Array(_) => false,
+            Value::Struct(_, fields) => fields.iter().all(Value::is_portable),
+            _ => true,
+        }
+    }
 }
@@ -0,0 +1,158 @@
+//! 按函数数量测量 LLVM IR 生成，以及生成 + 优化 + 输出目标文件的耗时
+
+use std::collections::HashMap;
+use std::path::PathBuf;
+
+use analyzer::{module::Module, project::Project};
+use codegen::llvm_ir::Program;
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use inkwell::{
+    OptimizationLevel,
+    context::Context,
+    passes::PassBuilderOptions,
+    targets::{
+        CodeModel, FileType, InitializationConfig, RelocMode, Target, TargetData, TargetMachine,
+    },
+};
+use syntax::{
+    SyntaxNode,
+    ast::{AstNode, CompUnit},
+};
+use vfs::Vfs;
+
+/// 生成 `functions` 个函数的源码，每个函数调用前一个
+fn synthetic_source(functions: usize) -> String {
+    let mut text = String::new();
+    for i in 0..functions {
+        let call = match i {
+            0 => "0".to_string(),
+            _ => format!("f{}(a - 1, b)", i - 1),
+        };
+        text.push_str(&format!(
+            r#"
+struct P{i} {{ x: i32, y: i32 }}
+
+fn f{i}(a: i32, b: *mut i32) -> i32 {{
+    let arr: [i32; 16] = {{1, 2, 3, {i}}};
+    let p: struct P{i} = {{a, {i}}};
+    let sum: i32 = p.x * p.y;
+    let k: i32 = 0;
+    while (k < 16) {{
+        if (arr[k] % 2 == 0 && a > k) {{
+            sum = sum + arr[k] * a;
+        }} else {{
+            sum = sum - b[k % 4];
+        }}
+        k = k + 1;
+    }}
+    return sum + {call};
+}}
+"#
+        ));
+    }
+    text
+}
+
+/// 分析单个模块的源码
+fn analyze(text: &str) -> Module {
+    let vfs = Vfs::default();
+    let file_id = vfs.new_file(PathBuf::from("bench.airy"), text.to_string());
+    let mut project = Project::new();
+    project.full_initialize(&vfs);
+    let module = project.modules.remove(&file_id).unwrap();
+    assert!(module.semantic_errors.is_empty());
+    module
+}
+
+/// 生成模块的 LLVM IR
+fn generate<'ctx>(context: &'ctx Context, module: &Module) -> inkwell::module::Module<'ctx> {
+    let llvm_module = context.create_module("bench");
+    let builder = context.create_builder();
+    let target_data = TargetData::create("");
+    let mut program = Program {
+        context,
+        builder: &builder,
+        module: &llvm_module,
+        analyzer: module,
+        target_data: &target_data,
+        options: Default::default(),
+        symbols: Default::default(),
+        string_constants: HashMap::new(),
+        unit: None,
+    };
+    let root = SyntaxNode::new_root(module.green_tree.clone());
+    program
+        .compile_comp_unit(CompUnit::cast(root).unwrap())
+        .unwrap();
+    llvm_module
+}
+
+fn target_machine() -> TargetMachine {
+    Target::initialize_native(&InitializationConfig::default()).unwrap();
+    let triple = TargetMachine::get_default_triple();
+    Target::from_triple(&triple)
+        .unwrap()
+        .create_target_machine(
+            &triple,
+            "generic",
+            "",
+            OptimizationLevel::Default,
+            RelocMode::PIC,
+            CodeModel::Default,
+        )
+        .unwrap()
+}
+
+fn bench_codegen(c: &mut Criterion) {
+    let machine = target_machine();
+    let modules: Vec<_> = [1, 10, 100, 1000]
+        .into_iter()
+        .map(|functions| (functions, analyze(&synthetic_source(functions))))
+        .collect();
+
+    let mut group = c.benchmark_group("llvm_ir");
+    for (functions, module) in &modules {
+        group.throughput(Throughput::Elements(*functions as u64));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(functions),
+            module,
+            |b, module| {
+                b.iter(|| {
+                    let context = Context::create();
+                    generate(&context, module).get_functions().count()
+                })
+            },
+        );
+    }
+    group.finish();
+
+    // 与 airyc-cli 的 compile_to_object_bytes 相同：生成、O2 优化、输出目标文件
+    let mut group = c.benchmark_group("object_bytes");
+    group.sample_size(10);
+    for (functions, module) in &modules {
+        group.throughput(Throughput::Elements(*functions as u64));
+        group.bench_with_input(
+            BenchmarkId::from_parameter(functions),
+            module,
+            |b, module| {
+                b.iter(|| {
+                    let context = Context::create();
+                    let llvm_module = generate(&context, module);
+                    llvm_module.set_triple(&machine.get_triple());
+                    llvm_module.set_data_layout(&machine.get_target_data().get_data_layout());
+                    llvm_module
+                        .run_passes("default<O2>", &machine, PassBuilderOptions::create())
+                        .unwrap();
+                    machine
+                        .write_to_memory_buffer(&llvm_module, FileType::Object)
+                        .unwrap()
+                        .get_size()
+                })
+            },
+        );
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_codegen);
+criterion_main!(benches);
@@ -37,6 +37,9 @@ pub enum CodegenError {
     #[error("LLVM optimization failed: {0}")]
     LlvmOptimization(String),
 
+    #[error("failed to link LLVM modules: {0}")]
+    LlvmLink(String),
+
     #[error("root node is not CompUnit")]
     InvalidRoot,
 }
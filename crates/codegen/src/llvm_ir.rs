@@ -1,24 +1,29 @@
 use std::collections::HashMap;
 
 use inkwell::basic_block::BasicBlock;
+use inkwell::targets::TargetData;
 use inkwell::values::{FunctionValue, GlobalValue, PointerValue};
 use inkwell::{builder::Builder, context::Context};
 use syntax::ast::*;
+use tools::{
+    Name,
+    hash::{FxHashMap, FxHashSet},
+};
 
-use crate::error::Result;
+use crate::error::{CodegenError, Result};
 
 mod decl;
 mod expr;
 mod func;
 mod stmt;
 
-/// 变量和函数的符号表
+/// 变量和函数的符号表，以驻留后的名称为键
 #[derive(Default)]
 pub struct SymbolTable<'a, 'ctx> {
     pub current_function: Option<FunctionValue<'ctx>>,
-    pub scopes: Vec<HashMap<String, Symbol<'a, 'ctx>>>,
-    pub functions: HashMap<String, FunctionValue<'ctx>>,
-    pub globals: HashMap<String, Symbol<'a, 'ctx>>,
+    pub scopes: Vec<FxHashMap<Name, Symbol<'a, 'ctx>>>,
+    pub functions: FxHashMap<Name, FunctionValue<'ctx>>,
+    pub globals: FxHashMap<Name, Symbol<'a, 'ctx>>,
     pub loop_stack: Vec<LoopContext<'ctx>>,
 }
 
@@ -27,8 +32,83 @@ pub struct Program<'a, 'ctx> {
     pub builder: &'a Builder<'ctx>,
     pub module: &'a inkwell::module::Module<'ctx>,
     pub analyzer: &'a analyzer::module::Module,
+    /// 目标机器的数据布局，决定聚合初始化时 memset/memcpy 的大小和对齐
+    pub target_data: &'a TargetData,
+    pub options: CodegenOptions,
     pub symbols: SymbolTable<'a, 'ctx>,
     pub string_constants: HashMap<String, GlobalValue<'ctx>>,
+    /// 只生成模块的一部分函数体，为 None 时生成整个模块
+    pub unit: Option<CodegenUnit>,
+}
+
+/// 会改变程序语义的代码生成选项，默认都关闭
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, Hash)]
+pub struct CodegenOptions {
+    /// 标量的 load/store 附加 TBAA：int、long、bool 和指针的访问互不别名，
+    /// 通过 `*void` 用另一种类型读写同一块内存是未定义行为
+    pub strict_aliasing: bool,
+    /// 有符号整数的加减乘和取负带 nsw：有符号溢出是未定义行为
+    pub no_signed_overflow: bool,
+}
+
+/// 代码生成单元
+///
+/// 一个模块的函数体可以分给多个单元，每个单元在各自的 LLVM context 中并行生成和优化。
+/// 所有单元都声明模块中的全部函数，只有 0 号单元定义可修改的全局变量
+#[derive(Debug, Clone)]
+pub struct CodegenUnit {
+    pub index: usize,
+    /// 本单元生成函数体的函数
+    pub functions: FxHashSet<Name>,
+}
+
+impl CodegenUnit {
+    /// 把模块中带函数体的函数分成至多 `count` 个单元
+    ///
+    /// 以函数的源码长度估计代码生成的工作量，从大到小依次放入当前最轻的单元
+    pub fn partition(comp_unit: &CompUnit, count: usize) -> Vec<CodegenUnit> {
+        let mut bodies: Vec<_> = comp_unit
+            .global_decls()
+            .filter_map(|global| {
+                let name = match &global {
+                    GlobalDecl::FuncDef(func) => {
+                        func.block()?;
+                        func.sign()?.name()?.var_name()?
+                    }
+                    GlobalDecl::FuncAttach(attach) => {
+                        attach.block()?;
+                        attach.name()?.var_name()?
+                    }
+                    _ => return None,
+                };
+                Some((
+                    u32::from(global.syntax().text_range().len()),
+                    Name::new(&name),
+                ))
+            })
+            .collect();
+        // 长度相同时保持源码顺序，划分结果与遍历顺序无关
+        bodies.sort_by_key(|(len, _)| std::cmp::Reverse(*len));
+
+        let count = count.clamp(1, bodies.len().max(1));
+        let mut units: Vec<_> = (0..count)
+            .map(|index| {
+                (
+                    0,
+                    CodegenUnit {
+                        index,
+                        functions: FxHashSet::default(),
+                    },
+                )
+            })
+            .collect();
+        for (len, name) in bodies {
+            let (load, unit) = units.iter_mut().min_by_key(|(load, _)| *load).unwrap();
+            *load += len;
+            unit.functions.insert(name);
+        }
+        units.into_iter().map(|(_, unit)| unit).collect()
+    }
 }
 
 #[derive(Clone, Copy)]
@@ -59,18 +139,49 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                     self.declare_function(func_info)?;
                 }
             }
+            for const_id in self.analyzer.constant_map.values() {
+                if const_id.module != self.analyzer.file_id
+                    && let Some(constant) = self.analyzer.get_constant_by_id(*const_id)
+                {
+                    self.declare_imported_constant(constant)?;
+                }
+            }
         }
 
         for global in node.global_decls() {
             match global {
                 GlobalDecl::VarDef(decl) => self.compile_var_def(decl)?,
-                GlobalDecl::FuncDef(func) => self.compile_func_def(func)?,
+                GlobalDecl::FuncDef(func) => {
+                    if self.emits_body(func.sign().and_then(|sign| sign.name())) {
+                        self.compile_func_def(func)?
+                    } else {
+                        let sign = func.sign().ok_or(CodegenError::Missing("function sign"))?;
+                        self.compile_func_signature(sign)?
+                    }
+                }
                 GlobalDecl::FuncAttach(attach) => {
-                    self.compile_func_attach(attach.name(), attach.block())?
+                    if self.emits_body(attach.name()) {
+                        self.compile_func_attach(attach.name(), attach.block())?
+                    }
                 }
                 GlobalDecl::StructDef(_) => {}
             }
         }
         Ok(())
     }
+
+    /// 当前单元是否生成函数 `name` 的函数体
+    fn emits_body(&self, name: Option<syntax::ast::Name>) -> bool {
+        let Some(unit) = &self.unit else {
+            return true;
+        };
+        name.and_then(|name| name.var_name())
+            .and_then(|name| Name::lookup(&name))
+            .is_some_and(|name| unit.functions.contains(&name))
+    }
+
+    /// 当前单元是否定义模块的全局变量
+    fn defines_globals(&self) -> bool {
+        self.unit.as_ref().is_none_or(|unit| unit.index == 0)
+    }
 }
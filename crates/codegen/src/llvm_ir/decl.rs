@@ -1,14 +1,36 @@
 use analyzer::array::{ArrayTree, ArrayTreeValue};
+use analyzer::module::Constant;
 use analyzer::r#type::Ty;
+use inkwell::module::Linkage;
 use inkwell::types::BasicTypeEnum;
 use inkwell::values::{BasicValueEnum, IntValue, PointerValue};
 use syntax::ast::*;
+use tools::Name;
 use utils::find_node_by_range;
 
 use crate::error::{CodegenError, Result};
 use crate::llvm_ir::Program;
 
 impl<'a, 'ctx> Program<'a, 'ctx> {
+    /// 声明导入的全局常量
+    ///
+    /// 与其他代码生成单元中的常量一样只保留值用于优化，定义在常量所在的模块中
+    pub(crate) fn declare_imported_constant(&mut self, constant: &'a Constant) -> Result<()> {
+        let llvm_ty = self.convert_ntype_to_type(&constant.ty)?;
+        let global = self.module.add_global(llvm_ty, None, &constant.name);
+        if let Some(value) = &constant.value {
+            let init_val = self.convert_value(value, Some(llvm_ty))?;
+            global.set_initializer(&init_val);
+            global.set_constant(true);
+            global.set_linkage(Linkage::AvailableExternally);
+        }
+        self.symbols.globals.insert(
+            Name::new(&constant.name),
+            crate::llvm_ir::Symbol::new(global.as_pointer_value(), &constant.ty),
+        );
+        Ok(())
+    }
+
     pub(crate) fn compile_var_def(&mut self, def: VarDef) -> Result<()> {
         let name_node = def.name().ok_or(CodegenError::Missing("variable name"))?;
         let name = name_node
@@ -39,12 +61,17 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
             };
 
             let global = self.module.add_global(llvm_ty, None, &name);
-            global.set_initializer(&init_val);
-            if is_const {
+            if self.defines_globals() {
+                global.set_initializer(&init_val);
+                global.set_constant(is_const);
+            } else if is_const {
+                // 其他代码生成单元只保留常量的值用于优化，不生成定义
+                global.set_initializer(&init_val);
                 global.set_constant(true);
+                global.set_linkage(Linkage::AvailableExternally);
             }
             self.symbols.globals.insert(
-                name.to_string(),
+                Name::new(&name),
                 crate::llvm_ir::Symbol::new(global.as_pointer_value(), var_ty),
             );
         } else {
@@ -72,28 +99,20 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                         .ok_or(CodegenError::Missing("expr type"))?;
                     let init_val_casted = self.cast_value(init_val, expr_ty, var_ty)?;
 
-                    self.builder
-                        .build_store(alloca, init_val_casted)
+                    self.build_tbaa_store(alloca, init_val_casted)
                         .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
                 } else if ty.is_array() {
                     // 数组初始化列表
-                    let array_tree = self
-                        .analyzer
-                        .expand_array
-                        .get(&range)
-                        .ok_or(CodegenError::Missing("array init info"))?;
-
-                    if self.analyzer.is_compile_time_constant(range) {
-                        let init_val =
-                            self.convert_array_tree_to_global_init(array_tree, llvm_ty)?;
-                        self.builder
-                            .build_store(alloca, init_val)
-                            .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                    if let Some(value) = self.analyzer.get_value_by_range(range) {
+                        self.store_const(alloca, llvm_ty, value)?;
                     } else {
-                        // 非常量数组：先 zero init，再逐个 store
-                        self.builder
-                            .build_store(alloca, llvm_ty.const_zero())
-                            .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                        let array_tree = self
+                            .analyzer
+                            .expand_array
+                            .get(&range)
+                            .ok_or(CodegenError::Missing("array init info"))?;
+                        // 非常量数组：先写入常量部分，再逐个 store
+                        let skip_const = self.store_array_prefix(alloca, llvm_ty, array_tree)?;
                         let mut indices = vec![self.context.i32_type().const_zero()];
                         // 提取数组元素类型
                         let element_ty = match &ty {
@@ -110,16 +129,14 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                             alloca,
                             llvm_ty,
                             element_ty,
+                            skip_const,
                         )?;
                     }
                 } else if ty.is_struct() {
                     // Struct 初始化列表
-                    if self.analyzer.is_compile_time_constant(range) {
-                        // 常量 struct：直接 store
-                        let init_val = self.get_const_var_value(&init_node, Some(llvm_ty))?;
-                        self.builder
-                            .build_store(alloca, init_val)
-                            .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                    if let Some(value) = self.analyzer.get_value_by_range(range) {
+                        // 常量 struct：整体写入
+                        self.store_const(alloca, llvm_ty, value)?;
                     } else {
                         // 非常量 struct：逐字段 store（struct 初始化要求完全覆盖，不需要 zero init）
                         self.store_struct_init(var_ty, init_node, alloca, llvm_ty)?;
@@ -129,12 +146,10 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                 }
             } else {
                 // 无初始值，zero init
-                self.builder
-                    .build_store(alloca, llvm_ty.const_zero())
-                    .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                self.store_zero(alloca, llvm_ty)?;
             }
 
-            self.symbols.insert_var(name.to_string(), alloca, var_ty);
+            self.symbols.insert_var(&name, alloca, var_ty);
         }
         Ok(())
     }
@@ -194,23 +209,18 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                     .ok_or(CodegenError::Missing("expr type"))?;
                 let value_casted = self.cast_value(value, expr_ty, &field.ty)?;
 
-                self.builder
-                    .build_store(field_ptr, value_casted)
+                self.build_tbaa_store(field_ptr, value_casted)
                     .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
             } else if inner_field_ty.is_array() {
                 // 数组字段：使用 ArrayTree 解析
-                if self.analyzer.is_compile_time_constant(init.text_range()) {
-                    let init_val = self.get_const_var_value(&init, Some(field_llvm_ty))?;
-                    self.builder
-                        .build_store(field_ptr, init_val)
-                        .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                if let Some(value) = self.analyzer.get_value_by_range(init.text_range()) {
+                    self.store_const(field_ptr, field_llvm_ty, value)?;
                 } else {
-                    // 非常量数组需要先 zero init
-                    self.builder
-                        .build_store(field_ptr, field_llvm_ty.const_zero())
-                        .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
-                    let mut indices = vec![self.context.i32_type().const_zero()];
+                    // 非常量数组需要先写入常量部分
                     let array_tree = self.analyzer.expand_array.get(&init.text_range()).unwrap();
+                    let skip_const =
+                        self.store_array_prefix(field_ptr, field_llvm_ty, array_tree)?;
+                    let mut indices = vec![self.context.i32_type().const_zero()];
                     // 提取数组元素类型
                     let element_ty = match &field.ty {
                         Ty::Array(inner, _) => inner.as_ref(),
@@ -230,15 +240,13 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                         field_ptr,
                         field_llvm_ty,
                         element_ty,
+                        skip_const,
                     )?;
                 }
             } else if inner_field_ty.is_struct() {
                 // 嵌套 struct 字段：递归处理（不需要 zero init）
-                if self.analyzer.is_compile_time_constant(init.text_range()) {
-                    let init_val = self.get_const_var_value(&init, Some(field_llvm_ty))?;
-                    self.builder
-                        .build_store(field_ptr, init_val)
-                        .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+                if let Some(value) = self.analyzer.get_value_by_range(init.text_range()) {
+                    self.store_const(field_ptr, field_llvm_ty, value)?;
                 } else {
                     self.store_struct_init(&field.ty, init, field_ptr, field_llvm_ty)?;
                 }
@@ -253,6 +261,9 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
     }
 
     /// 遍历 ArrayTree 叶子节点并存储初始化值
+    ///
+    /// `skip_const` 为 true 时常量叶子已经由 [`Program::store_array_prefix`] 写入，跳过
+    #[allow(clippy::too_many_arguments)]
     fn store_on_array_tree(
         &mut self,
         array_tree: &ArrayTree,
@@ -260,8 +271,16 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         ptr: PointerValue<'ctx>,
         llvm_ty: BasicTypeEnum<'ctx>,
         element_ty: &Ty,
+        skip_const: bool,
     ) -> Result<()> {
         match array_tree {
+            ArrayTree::Val(
+                ArrayTreeValue::Expr(expr_range)
+                | ArrayTreeValue::Struct {
+                    init_list: expr_range,
+                    ..
+                },
+            ) if skip_const && self.analyzer.is_compile_time_constant(*expr_range) => {}
             ArrayTree::Val(ArrayTreeValue::Expr(expr_range)) => {
                 let syntax_tree = SyntaxNode::new_root(self.analyzer.get_green_tree());
                 let expr = find_node_by_range::<Expr>(&syntax_tree, *expr_range)
@@ -277,11 +296,10 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
 
                 let gep = unsafe {
                     self.builder
-                        .build_gep(llvm_ty, ptr, indices, "idx.gep")
+                        .build_in_bounds_gep(llvm_ty, ptr, indices, "idx.gep")
                         .map_err(|_| CodegenError::LlvmBuild("gep failed"))?
                 };
-                self.builder
-                    .build_store(gep, value_casted)
+                self.build_tbaa_store(gep, value_casted)
                     .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
             }
             ArrayTree::Val(ArrayTreeValue::Struct {
@@ -300,13 +318,12 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                 let llvm_ty = self.convert_ntype_to_type(&struct_ty)?;
                 let gep = unsafe {
                     self.builder
-                        .build_gep(llvm_ty, ptr, indices, "idx.gep")
+                        .build_in_bounds_gep(llvm_ty, ptr, indices, "idx.gep")
                         .map_err(|_| CodegenError::LlvmBuild("gep failed"))?
                 };
                 if let Ok(const_val) = self.get_const_var_value_by_range(*list_range, Some(llvm_ty))
                 {
-                    self.builder
-                        .build_store(gep, const_val)
+                    self.build_tbaa_store(gep, const_val)
                         .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
                 } else {
                     let syntax_tree = SyntaxNode::new_root(self.analyzer.get_green_tree());
@@ -324,10 +341,19 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                     // 根据当前 element_ty 确定下一层的类型
                     match element_ty {
                         Ty::Array(inner, _) => {
-                            self.store_on_array_tree(child, indices, ptr, llvm_ty, inner.as_ref())?;
+                            self.store_on_array_tree(
+                                child,
+                                indices,
+                                ptr,
+                                llvm_ty,
+                                inner.as_ref(),
+                                skip_const,
+                            )?;
                         }
                         _ => {
-                            self.store_on_array_tree(child, indices, ptr, llvm_ty, element_ty)?;
+                            self.store_on_array_tree(
+                                child, indices, ptr, llvm_ty, element_ty, skip_const,
+                            )?;
                         }
                     }
                     indices.pop();
@@ -3,6 +3,7 @@ use inkwell::types::{BasicType, BasicTypeEnum};
 use inkwell::values::{BasicMetadataValueEnum, BasicValueEnum, PointerValue};
 use syntax::ast::*;
 use syntax::syntax_kind::SyntaxKind;
+use tools::Name;
 
 use crate::error::{CodegenError, Result};
 use crate::llvm_ir::Program;
@@ -41,8 +42,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
             .get_expr_type(range)
             .ok_or(CodegenError::Missing("deref type"))?;
         let llvm_ty = self.convert_ntype_to_type(result_ty)?;
-        self.builder
-            .build_load(llvm_ty, ptr, "deref")
+        self.build_tbaa_load(llvm_ty, ptr, "deref")
             .map_err(|_| CodegenError::LlvmBuild("deref load"))
     }
 
@@ -232,11 +232,19 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         match val {
             BasicValueEnum::IntValue(i) => match op_token.kind() {
                 SyntaxKind::PLUS => Ok(i.into()),
-                SyntaxKind::MINUS => Ok(self
-                    .builder
-                    .build_int_neg(i, "ineg")
-                    .map_err(|_| CodegenError::LlvmBuild("int neg"))?
-                    .into()),
+                SyntaxKind::MINUS => {
+                    let nsw = self.options.no_signed_overflow
+                        && self
+                            .analyzer
+                            .get_expr_type(expr.text_range())
+                            .is_some_and(is_signed_int);
+                    let neg = if nsw {
+                        self.builder.build_int_nsw_neg(i, "ineg")
+                    } else {
+                        self.builder.build_int_neg(i, "ineg")
+                    };
+                    Ok(neg.map_err(|_| CodegenError::LlvmBuild("int neg"))?.into())
+                }
                 SyntaxKind::BANG => {
                     let b = self.as_bool(val)?;
                     let nb = self
@@ -259,7 +267,10 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         let func = self
             .module
             .get_function(&name)
-            .or_else(|| self.symbols.functions.get(&name).copied())
+            .or_else(|| {
+                let name = Name::lookup(&name)?;
+                self.symbols.functions.get(&name).copied()
+            })
             .ok_or_else(|| CodegenError::UndefinedFunc(name.clone()))?;
 
         // 获取函数参数类型
@@ -322,8 +333,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         }
 
         // 否则 load 值
-        self.builder
-            .build_load(ty, ptr, &name)
+        self.build_tbaa_load(ty, ptr, &name)
             .map_err(|_| CodegenError::LlvmBuild("load"))
     }
 
@@ -390,8 +400,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         }
 
         // 否则 load 值
-        self.builder
-            .build_load(field_ty, field_ptr, "field")
+        self.build_tbaa_load(field_ty, field_ptr, "field")
             .map_err(|_| CodegenError::LlvmBuild("load field failed"))
     }
 
@@ -601,6 +610,9 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
     }
 
     /// 构建整数算术运算指令
+    ///
+    /// 有符号整数溢出默认按补码回绕；开启 `no_signed_overflow` 时溢出是未定义行为，
+    /// 有符号的加减乘带 nsw（常量表达式溢出总是由 analyzer 报错）
     fn build_int_arithmetic_op(
         &self,
         op: SyntaxKind,
@@ -609,16 +621,29 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         ty: &Ty,
     ) -> Result<BasicValueEnum<'ctx>> {
         let is_unsigned = matches!(ty, Ty::U8 | Ty::U32 | Ty::U64);
+        let nsw = self.options.no_signed_overflow && is_signed_int(ty);
 
         let res = match op {
+            SyntaxKind::PLUS if nsw => self
+                .builder
+                .build_int_nsw_add(l, r, "add")
+                .map_err(|_| CodegenError::LlvmBuild("int add"))?,
             SyntaxKind::PLUS => self
                 .builder
                 .build_int_add(l, r, "add")
                 .map_err(|_| CodegenError::LlvmBuild("int add"))?,
+            SyntaxKind::MINUS if nsw => self
+                .builder
+                .build_int_nsw_sub(l, r, "sub")
+                .map_err(|_| CodegenError::LlvmBuild("int sub"))?,
             SyntaxKind::MINUS => self
                 .builder
                 .build_int_sub(l, r, "sub")
                 .map_err(|_| CodegenError::LlvmBuild("int sub"))?,
+            SyntaxKind::STAR if nsw => self
+                .builder
+                .build_int_nsw_mul(l, r, "mul")
+                .map_err(|_| CodegenError::LlvmBuild("int mul"))?,
             SyntaxKind::STAR => self
                 .builder
                 .build_int_mul(l, r, "mul")
@@ -792,3 +817,12 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         }
     }
 }
+
+/// 有符号整数类型，包括 const 修饰的
+fn is_signed_int(ty: &Ty) -> bool {
+    match ty {
+        Ty::I8 | Ty::I32 | Ty::I64 => true,
+        Ty::Const(inner) => is_signed_int(inner),
+        _ => false,
+    }
+}
@@ -1,7 +1,11 @@
-use analyzer::module::Function;
+use analyzer::module::{Function, ReferenceTag, VariableID};
 use analyzer::r#type::Ty;
-use inkwell::types::BasicType;
+use inkwell::attributes::{Attribute, AttributeLoc};
+use inkwell::types::{BasicType, BasicTypeEnum};
+use inkwell::values::FunctionValue;
 use syntax::ast::*;
+use syntax::syntax_kind::SyntaxKind;
+use tools::Name;
 
 use crate::error::{CodegenError, Result};
 use crate::llvm_ir::Program;
@@ -54,14 +58,133 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         };
 
         let function = self.module.add_function(name, fn_type, None);
-        self.symbols.functions.insert(name.to_string(), function);
+
+        // 没有初始值的变量都会清零，传递和返回的标量不会是 undef/poison
+        if let Some(noundef) = self.enum_attribute("noundef") {
+            for (i, param) in function.get_param_iter().enumerate() {
+                if is_scalar(param.get_type()) {
+                    function.add_attribute(AttributeLoc::Param(i as u32), noundef);
+                }
+            }
+            if !is_void && is_scalar(ret_llvm_ty) {
+                function.add_attribute(AttributeLoc::Return, noundef);
+            }
+        }
+
+        self.symbols.functions.insert(Name::new(name), function);
         Ok(())
     }
 
+    /// 按名称创建不带参数的 LLVM 属性，当前版本的 LLVM 没有这个属性时返回 None
+    fn enum_attribute(&self, name: &str) -> Option<Attribute> {
+        match Attribute::get_named_enum_kind_id(name) {
+            0 => None,
+            kind => Some(self.context.create_enum_attribute(kind, 0)),
+        }
+    }
+
+    /// 根据函数体中的用法给指针参数加上 `captures(none)` 和 `readonly`
+    fn add_pointer_param_attributes(
+        &self,
+        function: FunctionValue<'ctx>,
+        params: &[VariableID],
+        block: &Block,
+    ) {
+        // `captures(none)` 是 LLVM 21 中 `nocapture` 的新写法，取值 0 表示完全不捕获
+        let no_capture = self
+            .enum_attribute("captures")
+            .or_else(|| self.enum_attribute("nocapture"));
+        let readonly = self.enum_attribute("readonly");
+
+        for (i, &var_id) in params.iter().enumerate() {
+            let is_pointer = self
+                .analyzer
+                .get_variable_by_id(var_id)
+                .is_some_and(|var| var.ty.is_pointer());
+            if !is_pointer {
+                continue;
+            }
+            let loc = AttributeLoc::Param(i as u32);
+            let usage = self.pointer_param_use(block, var_id);
+            if usage != PointerUse::Escaped
+                && let Some(attr) = no_capture
+            {
+                function.add_attribute(loc, attr);
+            }
+            if usage == PointerUse::Read
+                && let Some(attr) = readonly
+            {
+                function.add_attribute(loc, attr);
+            }
+        }
+    }
+
+    /// 指针参数 `param` 在函数体 `block` 中的使用方式
+    ///
+    /// 只检查语法上对参数的引用：每一处都必须是 [`Program::scalar_access`] 接受的访问，
+    /// 否则参数的值可能被复制、传递、返回或参与运算
+    fn pointer_param_use(&self, block: &Block, param: VariableID) -> PointerUse {
+        let mut usage = PointerUse::Read;
+        for index_val in block.syntax().descendants().filter_map(IndexVal::cast) {
+            let refers_to_param = index_val
+                .name()
+                .and_then(|name| name.var_range())
+                .and_then(|range| self.analyzer.get_reference_by_range(range))
+                .is_some_and(|reference| reference.tag == ReferenceTag::VarRead(param));
+            if !refers_to_param {
+                continue;
+            }
+            match self.scalar_access(&index_val) {
+                Some(PointerUse::ReadWrite) => usage = PointerUse::ReadWrite,
+                Some(_) => {}
+                None => return PointerUse::Escaped,
+            }
+        }
+        usage
+    }
+
+    /// `index_val` 是否只读写它指向的一个标量：`p[i]`（至少一个下标）或 `*p`，
+    /// 结果不是数组或结构体（数组会退化为指针，结构体可以继续取字段），并且没有被取地址
+    fn scalar_access(&self, index_val: &IndexVal) -> Option<PointerUse> {
+        let access = if index_val.indices().next().is_some() {
+            Expr::IndexVal(index_val.clone())
+        } else {
+            let deref = index_val.syntax().parent().and_then(UnaryExpr::cast)?;
+            if deref.op()?.op().kind() != SyntaxKind::STAR {
+                return None;
+            }
+            Expr::UnaryExpr(deref)
+        };
+        let ty = self.analyzer.get_expr_type(access.text_range())?;
+        if ty.is_array() || ty.is_struct() {
+            return None;
+        }
+
+        let mut outer = access.syntax().clone();
+        while let Some(paren) = outer
+            .parent()
+            .filter(|parent| parent.kind() == SyntaxKind::PAREN_EXPR)
+        {
+            outer = paren;
+        }
+        let parent = outer.parent()?;
+        if let Some(unary) = UnaryExpr::cast(parent.clone())
+            && unary.op()?.op().kind() == SyntaxKind::AMP
+        {
+            return None;
+        }
+        if let Some(assign) = AssignStmt::cast(parent)
+            && assign.lhs().is_some_and(|lhs| lhs.syntax() == &outer)
+        {
+            return Some(PointerUse::ReadWrite);
+        }
+        Some(PointerUse::Read)
+    }
+
     /// 编译函数体（为已声明的函数附加实现）
     pub(super) fn compile_func_attach(
         &mut self,
-        name: Option<Name>,
+        name: Option<syntax::ast::Name>,
         block: Option<Block>,
     ) -> Result<()> {
         let Some(block) = block else {
@@ -102,6 +225,8 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
             })
             .collect();
 
+        self.add_pointer_param_attributes(function, &func_info.params, &block);
+
         let entry = self.context.append_basic_block(function, "entry");
         self.builder.position_at_end(entry);
 
@@ -117,10 +242,9 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
 
             let alloc_ty = param_val.get_type();
             let alloca = self.create_entry_alloca(function, alloc_ty, &pname)?;
-            self.builder
-                .build_store(alloca, param_val)
+            self.build_tbaa_store(alloca, param_val)
                 .map_err(|_| CodegenError::LlvmBuild("parameter store failed"))?;
-            self.symbols.insert_var(pname, alloca, param_ty);
+            self.symbols.insert_var(&pname, alloca, param_ty);
         }
 
         self.compile_block(block)?;
@@ -145,3 +269,22 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         Ok(())
     }
 }
+
+/// 指针参数在函数体中的使用方式
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum PointerUse {
+    /// 只读取指向的标量
+    Read,
+    /// 只读写指向的标量
+    ReadWrite,
+    /// 指针本身被使用
+    Escaped,
+}
+
+/// 整数和指针，可以加 `noundef`；聚合中的填充字节是 undef
+fn is_scalar(ty: BasicTypeEnum<'_>) -> bool {
+    matches!(
+        ty,
+        BasicTypeEnum::IntType(_) | BasicTypeEnum::PointerType(_)
+    )
+}
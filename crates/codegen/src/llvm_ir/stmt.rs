@@ -63,8 +63,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         // 如果类型不同，插入转换
         let rhs_casted = self.cast_value(rhs, rhs_ty, lhs_ty)?;
 
-        self.builder
-            .build_store(lhs_ptr, rhs_casted)
+        self.build_tbaa_store(lhs_ptr, rhs_casted)
             .map_err(|_| CodegenError::LlvmBuild("assign store failed"))?;
         Ok(())
     }
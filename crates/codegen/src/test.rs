@@ -3,6 +3,7 @@ use std::path::PathBuf;
 
 use analyzer::{module::Module, project::Project};
 use inkwell::context::Context;
+use inkwell::targets::TargetData;
 use syntax::{
     SyntaxNode,
     ast::{AstNode, CompUnit},
@@ -11,7 +12,35 @@ use vfs::Vfs;
 
 use crate::llvm_ir;
 
+/// x86-64 Linux 的数据布局，测试输出与运行测试的机器无关
+const TEST_DATA_LAYOUT: &str =
+    "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-i128:128-f80:128-n8:16:32:64-S128";
+
 fn try_it(code: &str) -> String {
+    compile(code, None)
+}
+
+/// 按 [`llvm_ir::CodegenUnit::partition`] 划分后分别生成每个单元的 IR
+fn try_units(code: &str, count: usize) -> Vec<String> {
+    let parser = parser::parse::Parser::new(code);
+    let (green_node, _) = parser.parse();
+    let comp_unit = CompUnit::cast(SyntaxNode::new_root(green_node)).unwrap();
+    llvm_ir::CodegenUnit::partition(&comp_unit, count)
+        .into_iter()
+        .map(|unit| compile(code, Some(unit)))
+        .collect()
+}
+
+fn compile(code: &str, unit: Option<llvm_ir::CodegenUnit>) -> String {
+    compile_with(code, unit, TEST_DATA_LAYOUT, Default::default())
+}
+
+fn compile_with(
+    code: &str,
+    unit: Option<llvm_ir::CodegenUnit>,
+    data_layout: &str,
+    options: llvm_ir::CodegenOptions,
+) -> String {
     let parser = parser::parse::Parser::new(code);
     let (green_node, errors) = parser.parse();
     assert!(errors.is_empty(), "Parser errors: {:?}", errors);
@@ -39,13 +68,17 @@ fn try_it(code: &str) -> String {
     let llvm_module = context.create_module("main");
     let builder = context.create_builder();
 
+    let target_data = TargetData::create(data_layout);
     let mut program = llvm_ir::Program {
         context: &context,
         builder: &builder,
         module: &llvm_module,
         analyzer: &module,
+        target_data: &target_data,
+        options,
         symbols: Default::default(),
         string_constants: HashMap::new(),
+        unit,
     };
 
     program.compile_comp_unit(comp_unit).unwrap();
@@ -163,3 +196,171 @@ fn test_array_initialize() {
     "#;
     insta::assert_snapshot!(try_it(code));
 }
+
+#[test]
+fn test_codegen_units() {
+    let code = r#"
+    let n: const i32 = 4;
+    let g: i32 = 1;
+
+    fn add(x: i32) -> i32 {
+        return x + g + n;
+    }
+
+    fn main() -> i32 {
+        let a: i32 = add(1);
+        let b: i32 = add(a);
+        return a + b;
+    }
+    "#;
+    let units = try_units(code, 4);
+    assert_eq!(units.len(), 2);
+
+    // 每个函数体只在一个单元中生成，其他单元只有声明
+    for function in ["@add(", "@main("] {
+        let defined = units
+            .iter()
+            .filter(|ir| {
+                ir.lines()
+                    .any(|line| line.starts_with("define") && line.contains(function))
+            })
+            .count();
+        assert_eq!(defined, 1, "{}", function);
+        assert!(units.iter().all(|ir| ir.contains(function)));
+    }
+
+    // 全局变量只在 0 号单元定义，常量在其他单元中保留值
+    assert!(units[0].contains("@g = global i32 1"));
+    assert!(units[0].contains("@n = constant i32 4"));
+    assert!(units[1].contains("@g = external global i32"));
+    assert!(units[1].contains("@n = available_externally constant i32 4"));
+}
+
+#[test]
+fn test_bulk_init_uses_target_layout() {
+    let code = r#"
+    fn f() -> i64 {
+        let a: [i64; 16];
+        return a[0];
+    }
+    "#;
+    let memset = |ir: &str| {
+        ir.lines()
+            .find(|line| line.contains("@llvm.memset"))
+            .unwrap()
+            .to_string()
+    };
+
+    // i64 在 x86-64 上按 8 字节对齐，在 i386 上按 4 字节对齐
+    let ir = try_it(code);
+    assert!(memset(&ir).contains("ptr align 8"), "{}", ir);
+    let i386 =
+        "e-m:e-p:32:32-p270:32:32-p271:32:32-p272:64:64-i128:128-f64:32:64-f80:32-n8:16:32-S128";
+    let ir = compile_with(code, None, i386, Default::default());
+    assert!(memset(&ir).contains("ptr align 4"), "{}", ir);
+}
+
+#[test]
+fn test_alias_and_param_attributes() {
+    let code = r#"
+    fn sum(n: i32, arr: *const i32) -> i32 {
+        let i: i32 = 0;
+        let s: i32 = 0;
+        while (i < n) {
+            s = s + arr[i];
+            i = i + 1;
+        }
+        return s;
+    }
+
+    fn fill(n: i32, arr: *mut i32) {
+        let i: i32 = 0;
+        while (i < n) {
+            arr[i] = -i;
+            i = i + 1;
+        }
+    }
+
+    fn pass(arr: *mut i32) {
+        fill(4, arr);
+    }
+
+    fn id(p: *mut i32) -> *mut i32 {
+        return p;
+    }
+    "#;
+    let ir = try_it(code);
+    let define = |name: &str| {
+        ir.lines()
+            .find(|line| line.starts_with("define") && line.contains(name))
+            .unwrap()
+            .to_string()
+    };
+
+    // 只读取元素的指针参数不会被保存，也不会被写入
+    let sum = define("@sum(");
+    assert!(sum.starts_with("define noundef i32"), "{}", sum);
+    assert!(sum.contains("i32 noundef %n"), "{}", sum);
+    assert!(sum.contains("readonly"), "{}", sum);
+    assert!(sum.contains("captures(none)"), "{}", sum);
+
+    let fill = define("@fill(");
+    assert!(fill.contains("captures(none)"), "{}", fill);
+    assert!(!fill.contains("readonly"), "{}", fill);
+
+    // 参数被传给其他函数或者被返回
+    for name in ["@pass(", "@id("] {
+        let line = define(name);
+        assert!(!line.contains("captures"), "{}", line);
+        assert!(!line.contains("readonly"), "{}", line);
+    }
+
+    assert!(ir.contains("getelementptr inbounds i32"));
+}
+
+#[test]
+fn test_strict_aliasing_and_signed_overflow_are_opt_in() {
+    // 同一块内存先作为 i32 写入，再通过 `*void` 转换后作为指针读出
+    let code = r#"
+    fn pun(slot: *mut i32) -> *mut i8 {
+        let v: *mut void = slot;
+        let pp: *mut *mut i8 = v;
+        slot[0] = 0;
+        return pp[0];
+    }
+
+    fn arith(a: i32, b: u32) -> u32 {
+        let x: i32 = -a * a + a;
+        return b * b;
+    }
+    "#;
+
+    // 默认不附加 TBAA，类型双关的访问保持有定义；有符号溢出按补码回绕
+    let ir = try_it(code);
+    assert!(!ir.contains("!tbaa"), "{}", ir);
+    assert!(!ir.contains("nsw"), "{}", ir);
+
+    let options = llvm_ir::CodegenOptions {
+        strict_aliasing: true,
+        no_signed_overflow: true,
+    };
+    let ir = compile_with(code, None, TEST_DATA_LAYOUT, options);
+    let pun = ir
+        .split("define")
+        .find(|function| function.contains("@pun("))
+        .unwrap();
+    let tag_of = |pattern: &str| {
+        let line = pun.lines().find(|line| line.contains(pattern)).unwrap();
+        line.rsplit_once("!tbaa ").unwrap().1.to_string()
+    };
+    // 两次访问的 TBAA 标签不同，优化可以认为它们不别名
+    assert_ne!(tag_of("store i32 0"), tag_of("load ptr"), "{}", ir);
+    assert!(ir.contains(r#"!{!"int", "#), "{}", ir);
+    assert!(ir.contains(r#"!{!"any pointer", "#), "{}", ir);
+
+    // 只有有符号运算带 nsw
+    assert!(ir.contains("sub nsw i32 0"), "{}", ir);
+    assert!(ir.contains("mul nsw i32"), "{}", ir);
+    assert!(ir.contains("add nsw i32"), "{}", ir);
+    assert!(ir.contains("mul i32 %"), "{}", ir);
+}
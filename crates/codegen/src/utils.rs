@@ -1,22 +1,31 @@
-use std::collections::HashMap;
-
-use analyzer::array::ArrayTree;
+use analyzer::array::{ArrayTree, FlatArray};
 use analyzer::r#type::Ty;
 use analyzer::value::Value;
 use inkwell::basic_block::BasicBlock;
+use inkwell::builder::BuilderError;
+use inkwell::module::Linkage;
 use inkwell::types::{BasicType, BasicTypeEnum};
-use inkwell::values::{BasicValueEnum, FunctionValue, IntValue, PointerValue};
+use inkwell::values::{
+    BasicValue, BasicValueEnum, FunctionValue, InstructionValue, IntValue, MetadataValue,
+    PointerValue,
+};
 use inkwell::{AddressSpace, IntPredicate};
 use syntax::ast::AstNode;
-use tools::TextRange;
+use tools::{Name, TextRange, hash::FxHashMap};
 
 use crate::error::{CodegenError, Result};
 use crate::llvm_ir::{LoopContext, Program, Symbol, SymbolTable};
 
+/// 局部聚合的初始化超过这个字节数时使用 memset/memcpy，否则整体 store
+const BULK_INIT_BYTES: u64 = 64;
+
+/// 常量数组的非零元素不超过这个数量时，memset 后逐个 store，不生成全局常量
+const SPARSE_STORE_LIMIT: usize = 8;
+
 impl<'a, 'ctx> SymbolTable<'a, 'ctx> {
     /// Push new scope
     pub(crate) fn push_scope(&mut self) {
-        self.scopes.push(HashMap::new());
+        self.scopes.push(FxHashMap::default());
     }
 
     /// Pop scope
@@ -33,20 +42,21 @@ impl<'a, 'ctx> SymbolTable<'a, 'ctx> {
     }
 
     /// 插入局部变量
-    pub(crate) fn insert_var(&mut self, name: String, ptr: PointerValue<'ctx>, ty: &'a Ty) {
+    pub(crate) fn insert_var(&mut self, name: &str, ptr: PointerValue<'ctx>, ty: &'a Ty) {
         if let Some(scope) = self.scopes.last_mut() {
-            scope.insert(name, Symbol::new(ptr, ty));
+            scope.insert(Name::new(name), Symbol::new(ptr, ty));
         }
     }
 
     /// Lookup variable (inner to outer)
     pub(crate) fn lookup_var(&self, name: &str) -> Option<Symbol<'a, 'ctx>> {
+        let name = Name::lookup(name)?;
         for scope in self.scopes.iter().rev() {
-            if let Some(p) = scope.get(name) {
+            if let Some(p) = scope.get(&name) {
                 return Some(*p);
             }
         }
-        if let Some(g) = self.globals.get(name) {
+        if let Some(g) = self.globals.get(&name) {
             return Some(*g);
         }
         None
@@ -136,11 +146,13 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
     }
 
     /// Convert `ArrayTree` to LLVM constant value for global variable initialization.
-    /// This function only handles compile-time constants.
+    /// `partial` 为 false 时只处理编译期常量；为 true 时非常量的叶子生成零，
+    /// 用于局部数组先整体复制常量部分、再逐个 store 非常量元素
     pub(crate) fn convert_array_tree_to_global_init(
         &mut self,
         tree: &ArrayTree,
         ty: BasicTypeEnum<'ctx>,
+        partial: bool,
     ) -> Result<BasicValueEnum<'ctx>> {
         match tree {
             ArrayTree::Children(array_trees) => {
@@ -148,7 +160,8 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                 let mut value_vec = Vec::with_capacity(len);
                 let child_ty = ty.into_array_type().get_element_type();
                 for child in array_trees {
-                    value_vec.push(self.convert_array_tree_to_global_init(child, child_ty)?);
+                    value_vec
+                        .push(self.convert_array_tree_to_global_init(child, child_ty, partial)?);
                 }
                 let count = len.saturating_sub(array_trees.len());
                 value_vec.extend(std::iter::repeat_with(|| child_ty.const_zero()).take(count));
@@ -190,18 +203,278 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                 })
             }
             ArrayTree::Val(array_tree_value) => match array_tree_value {
-                analyzer::array::ArrayTreeValue::Expr(expr_range) => {
-                    self.get_const_var_value_by_range(*expr_range, None)
+                analyzer::array::ArrayTreeValue::Expr(range)
+                | analyzer::array::ArrayTreeValue::Struct {
+                    init_list: range, ..
+                } => {
+                    if partial && !self.analyzer.is_compile_time_constant(*range) {
+                        return Ok(ty.const_zero());
+                    }
+                    self.get_const_var_value_by_range(*range, None)
                 }
-                analyzer::array::ArrayTreeValue::Struct {
-                    init_list: list_range,
-                    ..
-                } => self.get_const_var_value_by_range(*list_range, None),
                 analyzer::array::ArrayTreeValue::Empty => Ok(ty.const_zero()),
             },
         }
     }
 
+    /// 生成扁平常量数组第 `dim` 维、从下标 `offset` 开始的子数组
+    ///
+    /// 全零的子数组直接生成 `zeroinitializer`；`i8` 元素用字节串生成，
+    /// 其他整数元素由 LLVM 折叠为 `ConstantDataArray`
+    fn convert_flat_array(
+        &self,
+        flat: &FlatArray,
+        dim: usize,
+        offset: usize,
+        ty: BasicTypeEnum<'ctx>,
+    ) -> Result<BasicValueEnum<'ctx>> {
+        let len = flat.shape[dim] as usize;
+        let stride = flat.stride(dim);
+        if flat.is_zero(offset, len * stride) {
+            return Ok(ty.const_zero());
+        }
+
+        let elem_ty = ty.into_array_type().get_element_type();
+        if dim + 1 < flat.shape.len() {
+            let rows = (0..len)
+                .map(|i| {
+                    self.convert_flat_array(flat, dim + 1, offset + i * stride, elem_ty)
+                        .map(|row| row.into_array_value())
+                })
+                .collect::<Result<Vec<_>>>()?;
+            return Ok(elem_ty.into_array_type().const_array(&rows).into());
+        }
+
+        let int_ty = elem_ty.into_int_type();
+        let bits = flat.row(offset, len);
+        if int_ty.get_bit_width() == 8 {
+            let bytes: Vec<u8> = bits.iter().map(|&b| b as u8).collect();
+            return Ok(self.context.const_string(&bytes, false).into());
+        }
+        let values: Vec<_> = bits.iter().map(|&b| int_ty.const_int(b, false)).collect();
+        Ok(int_ty.const_array(&values).into())
+    }
+
+    /// 类型在目标机器上的存储大小和 ABI 对齐（字节）
+    pub(crate) fn type_layout(&self, ty: BasicTypeEnum<'ctx>) -> (u64, u32) {
+        (
+            self.target_data.get_store_size(&ty),
+            self.target_data.get_abi_alignment(&ty),
+        )
+    }
+
+    /// load 一个值，开启严格别名时标量附加 TBAA 元数据
+    pub(crate) fn build_tbaa_load(
+        &self,
+        ty: BasicTypeEnum<'ctx>,
+        ptr: PointerValue<'ctx>,
+        name: &str,
+    ) -> std::result::Result<BasicValueEnum<'ctx>, BuilderError> {
+        let value = self.builder.build_load(ty, ptr, name)?;
+        if let Some(load) = value.as_instruction_value() {
+            self.attach_tbaa(load, ty);
+        }
+        Ok(value)
+    }
+
+    /// store 一个值，开启严格别名时标量附加 TBAA 元数据
+    pub(crate) fn build_tbaa_store(
+        &self,
+        ptr: PointerValue<'ctx>,
+        value: impl BasicValue<'ctx>,
+    ) -> std::result::Result<InstructionValue<'ctx>, BuilderError> {
+        let ty = value.as_basic_value_enum().get_type();
+        let store = self.builder.build_store(ptr, value)?;
+        self.attach_tbaa(store, ty);
+        Ok(store)
+    }
+
+    fn attach_tbaa(&self, inst: InstructionValue<'ctx>, ty: BasicTypeEnum<'ctx>) {
+        if !self.options.strict_aliasing {
+            return;
+        }
+        let Some(node) = self.tbaa_type_node(ty) else {
+            return;
+        };
+        let offset = self.context.i64_type().const_zero();
+        let tag = self
+            .context
+            .metadata_node(&[node.into(), node.into(), offset.into()]);
+        // 只对 load/store 调用，附加不会失败
+        let _ = inst.set_metadata(tag, self.context.get_kind_id("tbaa"));
+    }
+
+    /// 标量访问的 TBAA 类型节点，聚合类型不附加元数据，返回 None
+    ///
+    /// 与 C 的严格别名规则相同，按存储类型区分：有符号和无符号整数共用节点，所有指针共用
+    /// 一个节点。`*void` 可以与任意指针互转，i8 与 C 的 char 一样作为根下的
+    /// "omnipotent char"，可以与所有类型别名，其他类型都是它的子节点
+    fn tbaa_type_node(&self, ty: BasicTypeEnum<'ctx>) -> Option<MetadataValue<'ctx>> {
+        let name = match ty {
+            BasicTypeEnum::PointerType(_) => Some("any pointer"),
+            BasicTypeEnum::IntType(int_ty) => match int_ty.get_bit_width() {
+                1 => Some("bool"),
+                32 => Some("int"),
+                64 => Some("long"),
+                _ => None,
+            },
+            _ => return None,
+        };
+
+        let offset = self.context.i64_type().const_zero();
+        let scalar = |name: &str, parent: MetadataValue<'ctx>| {
+            self.context.metadata_node(&[
+                self.context.metadata_string(name).into(),
+                parent.into(),
+                offset.into(),
+            ])
+        };
+        let root = self
+            .context
+            .metadata_node(&[self.context.metadata_string("airyc TBAA").into()]);
+        let char_node = scalar("omnipotent char", root);
+        Some(match name {
+            Some(name) => scalar(name, char_node),
+            None => char_node,
+        })
+    }
+
+    /// 把 `ptr` 指向的 `ty` 类型内存清零，较大的聚合使用 memset
+    pub(crate) fn store_zero(
+        &self,
+        ptr: PointerValue<'ctx>,
+        ty: BasicTypeEnum<'ctx>,
+    ) -> Result<()> {
+        let (size, align) = self.type_layout(ty);
+        if size <= BULK_INIT_BYTES {
+            self.build_tbaa_store(ptr, ty.const_zero())
+                .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+            return Ok(());
+        }
+        let size = ty
+            .size_of()
+            .ok_or(CodegenError::LlvmBuild("unsized type"))?;
+        self.builder
+            .build_memset(ptr, align, self.context.i8_type().const_zero(), size)
+            .map_err(|_| CodegenError::LlvmBuild("memset failed"))?;
+        Ok(())
+    }
+
+    /// 用常量 `value` 初始化 `ptr` 指向的 `ty` 类型内存
+    ///
+    /// 较大的聚合中，全零或大部分为零的使用 memset（加少量 store），其他的从私有全局常量 memcpy
+    pub(crate) fn store_const(
+        &mut self,
+        ptr: PointerValue<'ctx>,
+        ty: BasicTypeEnum<'ctx>,
+        value: &Value,
+    ) -> Result<()> {
+        let (size, align) = self.type_layout(ty);
+        if size > BULK_INIT_BYTES {
+            if is_zero_value(value) {
+                return self.store_zero(ptr, ty);
+            }
+            if let Value::FlatArray(flat) = value
+                && flat.nonzeros().nth(SPARSE_STORE_LIMIT).is_none()
+            {
+                self.store_zero(ptr, ty)?;
+                return self.store_flat_nonzeros(ptr, ty, flat);
+            }
+            let init = self.convert_value(value, Some(ty))?;
+            return self.memcpy_from_constant(ptr, ty, init);
+        }
+
+        let init = self.convert_value(value, Some(ty))?;
+        self.build_tbaa_store(ptr, init)
+            .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+        Ok(())
+    }
+
+    /// 局部数组的非常量初始化：先写入常量部分，返回之后能否跳过常量叶子
+    ///
+    /// 较小的数组整体清零，之后每个叶子都要 store；较大的数组按常量部分 memset 或 memcpy
+    pub(crate) fn store_array_prefix(
+        &mut self,
+        ptr: PointerValue<'ctx>,
+        ty: BasicTypeEnum<'ctx>,
+        tree: &ArrayTree,
+    ) -> Result<bool> {
+        let (size, _) = self.type_layout(ty);
+        if size <= BULK_INIT_BYTES || !self.has_nonzero_const_leaf(tree) {
+            self.store_zero(ptr, ty)?;
+            return Ok(size > BULK_INIT_BYTES);
+        }
+        let init = self.convert_array_tree_to_global_init(tree, ty, true)?;
+        self.memcpy_from_constant(ptr, ty, init)?;
+        Ok(true)
+    }
+
+    fn has_nonzero_const_leaf(&self, tree: &ArrayTree) -> bool {
+        match tree {
+            ArrayTree::Children(children) => children
+                .iter()
+                .any(|child| self.has_nonzero_const_leaf(child)),
+            ArrayTree::Val(leaf) => leaf
+                .get_const_value(&self.analyzer.value_table)
+                .is_some_and(|value| !is_zero_value(value)),
+        }
+    }
+
+    /// 把常量放入私有全局变量，再复制到 `ptr`
+    fn memcpy_from_constant(
+        &mut self,
+        ptr: PointerValue<'ctx>,
+        ty: BasicTypeEnum<'ctx>,
+        init: BasicValueEnum<'ctx>,
+    ) -> Result<()> {
+        let (_, align) = self.type_layout(ty);
+        let global = self.module.add_global(ty, None, "const.init");
+        global.set_initializer(&init);
+        global.set_constant(true);
+        global.set_linkage(Linkage::Private);
+        global.set_unnamed_addr(true);
+        global.set_alignment(align);
+        let size = ty
+            .size_of()
+            .ok_or(CodegenError::LlvmBuild("unsized type"))?;
+        self.builder
+            .build_memcpy(ptr, align, global.as_pointer_value(), align, size)
+            .map_err(|_| CodegenError::LlvmBuild("memcpy failed"))?;
+        Ok(())
+    }
+
+    /// 逐个 store 扁平数组的非零元素
+    fn store_flat_nonzeros(
+        &self,
+        ptr: PointerValue<'ctx>,
+        ty: BasicTypeEnum<'ctx>,
+        flat: &FlatArray,
+    ) -> Result<()> {
+        let i32_type = self.context.i32_type();
+        let mut elem_ty = ty;
+        for _ in &flat.shape {
+            elem_ty = elem_ty.into_array_type().get_element_type();
+        }
+        let elem_ty = elem_ty.into_int_type();
+
+        for (offset, bits) in flat.nonzeros() {
+            let mut indices = vec![i32_type.const_zero()];
+            for (dim, &len) in flat.shape.iter().enumerate() {
+                let index = offset / flat.stride(dim) % len as usize;
+                indices.push(i32_type.const_int(index as u64, false));
+            }
+            let gep = unsafe {
+                self.builder
+                    .build_in_bounds_gep(ty, ptr, &indices, "idx.gep")
+                    .map_err(|_| CodegenError::LlvmBuild("gep failed"))?
+            };
+            self.build_tbaa_store(gep, elem_ty.const_int(bits, false))
+                .map_err(|_| CodegenError::LlvmBuild("store failed"))?;
+        }
+        Ok(())
+    }
+
+    /// 计算下标访问的地址，下标越界（包括超出数组的某一维）时行为未定义，GEP 都是 inbounds 的
     pub(crate) fn calculate_index_op(
         &self,
         mut cur_ntype: Ty,
@@ -233,7 +506,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
 
                     ptr = unsafe {
                         self.builder
-                            .build_gep(cur_llvm_type, ptr, &indices, "arr.gep")
+                            .build_in_bounds_gep(cur_llvm_type, ptr, &indices, "arr.gep")
                             .map_err(|_| CodegenError::LlvmBuild("gep failed"))?
                     };
 
@@ -249,15 +522,14 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                     // 指针：load 后 GEP 一个索引
                     let pointee_ty = self.convert_ntype_to_type(pointee)?;
                     let loaded_ptr = self
-                        .builder
-                        .build_load(ptr_ty, ptr, "ptr.load")
+                        .build_tbaa_load(ptr_ty.into(), ptr, "ptr.load")
                         .map_err(|_| CodegenError::LlvmBuild("load ptr"))?
                         .into_pointer_value();
 
                     let idx = idx_iter.next().unwrap();
                     ptr = unsafe {
                         self.builder
-                            .build_gep(pointee_ty, loaded_ptr, &[idx], "ptr.gep")
+                            .build_in_bounds_gep(pointee_ty, loaded_ptr, &[idx], "ptr.gep")
                             .map_err(|_| CodegenError::LlvmBuild("gep failed"))?
                     };
 
@@ -288,7 +560,7 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
             let zero = self.context.i32_type().const_zero();
             let decayed_ptr = unsafe {
                 self.builder
-                    .build_gep(ty, ptr, &[zero, zero], "arr.decay")
+                    .build_in_bounds_gep(ty, ptr, &[zero, zero], "arr.decay")
                     .map_err(|_| CodegenError::LlvmBuild("array decay gep"))?
             };
             let ptr_ty = self.context.ptr_type(AddressSpace::default()).into();
@@ -384,7 +656,8 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
                 let ptr = self.get_or_create_string_constant(s)?;
                 Ok(ptr.into())
             }
-            Value::Array(tree) => self.convert_array_tree_to_global_init(tree, ty.unwrap()),
+            Value::Array(tree) => self.convert_array_tree_to_global_init(tree, ty.unwrap(), false),
+            Value::FlatArray(flat) => self.convert_flat_array(flat, 0, 0, ty.unwrap()),
             Value::Struct(struct_id, fields) => {
                 // 生成 struct 常量
                 // 获取 struct 的 LLVM 类型
@@ -613,3 +886,20 @@ impl<'a, 'ctx> Program<'a, 'ctx> {
         Ok(global.as_pointer_value())
     }
 }
+
+/// 常量是否全为零
+fn is_zero_value(value: &Value) -> bool {
+    match value {
+        Value::I32(v) => *v == 0,
+        Value::I8(v) => *v == 0,
+        Value::U8(v) => *v == 0,
+        Value::U32(v) => *v == 0,
+        Value::I64(v) => *v == 0,
+        Value::U64(v) => *v == 0,
+        Value::Bool(v) => !v,
+        Value::Null | Value::StructZero(_) => true,
+        Value::Struct(_, fields) => fields.iter().all(is_zero_value),
+        Value::FlatArray(flat) => flat.nonzeros().next().is_none(),
+        Value::String(_) | Value::Array(_) => false,
+    }
+}
@@ -0,0 +1,56 @@
+//! 词法分析的吞吐量（tokens/s）
+
+use std::hint::black_box;
+
+use criterion::{BenchmarkId, Criterion, Throughput, criterion_group, criterion_main};
+use lexer::Lexer;
+
+/// 生成 `functions` 个函数的源码，每个函数调用前一个
+fn synthetic_source(functions: usize) -> String {
+    let mut text = String::new();
+    for i in 0..functions {
+        let call = match i {
+            0 => "0".to_string(),
+            _ => format!("f{}(a - 1, b)", i - 1),
+        };
+        text.push_str(&format!(
+            r#"
+struct P{i} {{ x: i32, y: i32 }}
+
+// 函数 {i}
+fn f{i}(a: i32, b: *mut i32) -> i32 {{
+    let arr: [i32; 16] = {{1, 2, 3, {i}}};
+    let p: struct P{i} = {{a, {i}}};
+    let sum: i32 = p.x * p.y;
+    let k: i32 = 0;
+    while (k < 16) {{
+        if (arr[k] % 2 == 0 && a > k) {{
+            sum = sum + arr[k] * a;
+        }} else {{
+            sum = sum - b[k % 4];
+        }}
+        k = k + 1;
+    }}
+    return sum + {call};
+}}
+"#
+        ));
+    }
+    text
+}
+
+fn bench_lexer(c: &mut Criterion) {
+    let mut group = c.benchmark_group("lexer");
+    for functions in [10, 100, 1000] {
+        let text = synthetic_source(functions);
+        let tokens = Lexer::new(&text).get_tokens().len();
+        group.throughput(Throughput::Elements(tokens as u64));
+        group.bench_with_input(BenchmarkId::from_parameter(functions), &text, |b, text| {
+            b.iter(|| Lexer::new(black_box(text)).get_tokens().len())
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, bench_lexer);
+criterion_main!(benches);
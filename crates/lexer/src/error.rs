@@ -37,4 +37,10 @@ impl LexerError {
             LexerError::InvalidInteger { range, .. } | LexerError::Unknown { range } => range,
         }
     }
+
+    pub fn range_mut(&mut self) -> &mut TextRange {
+        match self {
+            LexerError::InvalidInteger { range, .. } | LexerError::Unknown { range } => range,
+        }
+    }
 }
@@ -38,4 +38,11 @@ impl ParserError {
             Self::LexerError(e) => e.range(),
         }
     }
+
+    pub fn range_mut(&mut self) -> &mut TextRange {
+        match self {
+            Self::Expected { range, .. } => range,
+            Self::LexerError(e) => e.range_mut(),
+        }
+    }
 }
@@ -4,6 +4,7 @@ mod expression;
 mod function;
 mod header;
 mod recovery;
+mod reparse;
 mod statement;
 mod r#struct;
 mod variable;
@@ -0,0 +1,136 @@
+//! 增量重解析：只重新解析包含编辑位置的最小 Block / FuncDef / StructDef 节点，
+//! 并把新节点拼接回原语法树，未受影响的子树直接复用
+
+use rowan::GreenNode;
+use syntax::{SyntaxKind, SyntaxNode};
+use tools::{TextEdit, TextRange};
+
+use crate::parse::{Parser, ParserError};
+
+impl Parser<'_> {
+    /// 根据编辑增量更新语法树，无法增量处理时全量解析 `new_text`
+    ///
+    /// `old_errors` 是旧语法树对应的解析错误
+    pub fn parse_incremental(
+        old_tree: &GreenNode,
+        old_errors: &[ParserError],
+        edit: &TextEdit,
+        new_text: &str,
+    ) -> (GreenNode, Vec<ParserError>) {
+        Self::reparse(old_tree, old_errors, edit, new_text)
+            .unwrap_or_else(|| Parser::new(new_text).parse())
+    }
+
+    /// 尝试增量重解析，无法保证与全量解析结果一致时返回 `None`
+    pub fn reparse(
+        old_tree: &GreenNode,
+        old_errors: &[ParserError],
+        edit: &TextEdit,
+        new_text: &str,
+    ) -> Option<(GreenNode, Vec<ParserError>)> {
+        let root = SyntaxNode::new_root(old_tree.clone());
+        let edit_range = *edit.range;
+        if edit_range.end() > root.text_range().end() {
+            return None;
+        }
+
+        // 从最小的节点开始尝试，失败时扩大到外层节点
+        root.covering_element(edit_range)
+            .ancestors()
+            .filter(|node| {
+                matches!(
+                    node.kind(),
+                    SyntaxKind::BLOCK | SyntaxKind::FUNC_DEF | SyntaxKind::STRUCT_DEF
+                )
+            })
+            .filter(|node| {
+                let range = node.text_range();
+                range.start() < edit_range.start() && edit_range.end() < range.end()
+            })
+            .find_map(|node| Self::reparse_node(&node, old_errors, edit, new_text))
+    }
+
+    fn reparse_node(
+        node: &SyntaxNode,
+        old_errors: &[ParserError],
+        edit: &TextEdit,
+        new_text: &str,
+    ) -> Option<(GreenNode, Vec<ParserError>)> {
+        let delta = edit.delta();
+        let start = u32::from(node.text_range().start());
+        let old_end = u32::from(node.text_range().end());
+        let new_end = u32::try_from(old_end as i64 + delta).ok()?;
+        let slice = new_text.get(start as usize..new_end as usize)?;
+        let first_kind = node
+            .descendants_with_tokens()
+            .filter_map(|element| element.into_token())
+            .map(|token| token.kind())
+            .find(|kind| !kind.is_trivia())?;
+        let last_kind = node.last_token()?.kind();
+
+        let mut parser = Parser::new(slice);
+
+        // 词法层面的检查：节点片段必须能独立切分成与全量解析相同的 token
+        let tokens = parser.lexer.get_tokens();
+        // 解析函数会直接消费节点的第一个 token（比如 `fn`），不检查它的类型
+        if !parser.lexer.lexer_errors.is_empty()
+            || tokens.iter().map(|t| t.0).find(|kind| !kind.is_trivia()) != Some(first_kind)
+            || tokens.last().map(|t| t.0) != Some(last_kind)
+            || tokens.windows(2).any(|w| {
+                // 未闭合的块注释在全量解析时会吞掉节点之后的文本
+                w[0].0 == SyntaxKind::SLASH
+                    && w[1].0 == SyntaxKind::STAR
+                    && w[0].2.end() == w[1].2.start()
+            })
+        {
+            return None;
+        }
+
+        let success = match node.kind() {
+            SyntaxKind::BLOCK => parser.parse_block(),
+            SyntaxKind::FUNC_DEF => parser.parse_func_def(),
+            SyntaxKind::STRUCT_DEF => parser.parse_struct_def(),
+            _ => return None,
+        };
+
+        // 解析失败时外层的错误恢复会影响之后的文本；节点必须恰好覆盖整个片段
+        if !success || parser.lexer.current_kind() != SyntaxKind::EOF {
+            return None;
+        }
+        let green = parser.builder.finish();
+        if SyntaxKind::from(green.kind()) != node.kind()
+            || u32::from(green.text_len()) as usize != slice.len()
+        {
+            return None;
+        }
+
+        // 节点之外的旧错误保留（之后的平移），节点内的错误由新的解析结果替换
+        let mut errors: Vec<ParserError> = old_errors
+            .iter()
+            .filter_map(|e| {
+                let range = e.range();
+                if u32::from(range.end()) <= start {
+                    Some(e.clone())
+                } else if u32::from(range.start()) >= old_end {
+                    let mut e = e.clone();
+                    shift_range(e.range_mut(), delta);
+                    Some(e)
+                } else {
+                    None
+                }
+            })
+            .collect();
+        errors.extend(parser.parse_errors.into_iter().map(|mut e| {
+            shift_range(e.range_mut(), start as i64);
+            e
+        }));
+
+        Some((node.replace_with(green), errors))
+    }
+}
+
+fn shift_range(range: &mut TextRange, delta: i64) {
+    let start = (u32::from(range.start()) as i64 + delta) as u32;
+    let end = (u32::from(range.end()) as i64 + delta) as u32;
+    *range = TextRange::new(start, end);
+}
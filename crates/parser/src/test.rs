@@ -311,3 +311,59 @@ import "../utils"::add
         panic!("Failed to parse CompUnit");
     }
 }
+
+/// 对 `old` 应用编辑后增量解析，并检查结果与全量解析一致
+fn reparse_it(old: &str, range: (u32, u32), insert: &str) -> Option<rowan::GreenNode> {
+    let (old_tree, old_errors) = Parser::new(old).parse();
+    let edit = tools::TextEdit::new(tools::TextRange::new(range.0, range.1), insert.to_string());
+    let mut new = old.to_string();
+    edit.apply(&mut new);
+
+    let (tree, errors) = Parser::reparse(&old_tree, &old_errors, &edit, &new)?;
+    let (full_tree, full_errors) = Parser::new(&new).parse();
+    assert_eq!(tree, full_tree);
+    let sorted_ranges = |errors: &[crate::parse::ParserError]| {
+        let mut ranges: Vec<_> = errors.iter().map(|e| *e.range()).collect();
+        ranges.sort();
+        ranges
+    };
+    assert_eq!(sorted_ranges(&errors), sorted_ranges(&full_errors));
+    Some(tree)
+}
+
+#[test]
+fn test_reparse_block() {
+    let source = "fn f() -> i32 {\n    return 1;\n}\nfn g() -> i32 {\n    return 2;\n}\n";
+    let offset = source.find('1').unwrap() as u32;
+    let tree = reparse_it(source, (offset, offset + 1), "1 + x * 3").unwrap();
+
+    // 未修改的函数直接复用原来的子树
+    let (old_tree, _) = Parser::new(source).parse();
+    let old_g = old_tree.children().nth(2).unwrap().into_node().unwrap();
+    let new_g = tree.children().nth(2).unwrap().into_node().unwrap();
+    assert!(std::ptr::eq(old_g, new_g));
+}
+
+#[test]
+fn test_reparse_with_errors() {
+    let source = "fn f() -> i32 {\n    return 1;\n}\nfn g() -> i32 {\n    return;;\n}\n";
+    let offset = source.find('1').unwrap() as u32;
+    // 节点之外的旧错误保留
+    reparse_it(source, (offset, offset + 1), "(1 + 2)").unwrap();
+}
+
+#[test]
+fn test_reparse_fallback() {
+    let source = "fn f() -> i32 {\n    return 1;\n}\nfn g() -> i32 {\n    return 2;\n}\n";
+    let offset = source.find('1').unwrap() as u32;
+    // 破坏了块的边界，需要全量解析
+    assert!(reparse_it(source, (offset, offset + 1), "1; }").is_none());
+    // 未闭合的块注释
+    assert!(reparse_it(source, (offset, offset + 1), "/* 1").is_none());
+    // 编辑落在顶层，没有可以重解析的节点
+    assert!(reparse_it(source, (0, 0), "\n").is_none());
+    // 节点内出现语法错误，外层的错误恢复可能不同
+    assert!(reparse_it(source, (offset, offset + 1), "(1 +").is_none());
+    // 修改了节点的第一个 token
+    assert!(reparse_it(source, (1, 2), "x").is_none());
+}
@@ -0,0 +1,12 @@
+//! 把 `src/runtime.c` 编译为静态库 `libairyc_runtime.a`，放在 OUT_DIR 中
+//!
+//! cc 同时让使用这个 crate 的程序链接它，编译器进程中的 JIT 可以直接调用其中的函数
+
+fn main() {
+    println!("cargo:rerun-if-changed=src/runtime.c");
+    cc::Build::new()
+        .file("src/runtime.c")
+        .opt_level(2)
+        .warnings(true)
+        .compile("airyc_runtime");
+}
@@ -0,0 +1,42 @@
+//! airyc 程序的运行时库
+//!
+//! 提供带缓冲的整数和数组读写（`getint`/`getarray`/`putint`/`putarray` 等）以及计时函数
+//! `starttime`/`stoptime`，实现见 `src/runtime.c`。链接可执行文件时自动加入 [`ARCHIVE`]，
+//! 程序只需要声明用到的函数，例如 `fn getint() -> i32;`
+
+/// 运行时静态库的内容，按编译器所在平台编译
+pub static ARCHIVE: &[u8] = include_bytes!(concat!(env!("OUT_DIR"), "/libairyc_runtime.a"));
+
+/// 写出静态库时使用的文件名
+pub const ARCHIVE_NAME: &str = "libairyc_runtime.a";
+
+unsafe extern "C" {
+    fn getint() -> i32;
+    fn getlong() -> i64;
+    fn getch() -> i32;
+    fn getarray(array: *mut i32) -> i32;
+    fn putint(value: i32);
+    fn putlong(value: i64);
+    fn putch(c: i32);
+    fn putarray(len: i32, array: *const i32);
+    fn starttime();
+    fn stoptime();
+}
+
+/// 运行时函数的名称和在编译器进程中的地址
+///
+/// JIT 执行时把程序中没有实现的同名声明映射到这些地址
+pub fn symbols() -> [(&'static str, usize); 10] {
+    [
+        ("getint", getint as *const () as usize),
+        ("getlong", getlong as *const () as usize),
+        ("getch", getch as *const () as usize),
+        ("getarray", getarray as *const () as usize),
+        ("putint", putint as *const () as usize),
+        ("putlong", putlong as *const () as usize),
+        ("putch", putch as *const () as usize),
+        ("putarray", putarray as *const () as usize),
+        ("starttime", starttime as *const () as usize),
+        ("stoptime", stoptime as *const () as usize),
+    ]
+}
@@ -0,0 +1,119 @@
+// airyc 运行时库
+//
+// 整数直接在 stdio 的缓冲区上逐字符解析和输出，使用不加锁的 getchar_unlocked/putchar_unlocked，
+// 不解析格式串。与 printf/scanf 共用 stdin/stdout 的缓冲区，两者混用时读写顺序不变。
+// airyc 程序是单线程的，不需要 stdio 的锁
+//
+// 所有函数都是弱符号：程序自己定义了同名函数时使用程序的定义，不会重复定义
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define AIRYC_RUNTIME __attribute__((weak))
+
+// 跳过空白，读取一个可以带符号的十进制整数，之后的第一个字符退回输入流
+//
+// 没有数字时返回 0，溢出时按补码回绕
+static long long read_integer(void) {
+    int c = getchar_unlocked();
+    while (c == ' ' || (c >= '\t' && c <= '\r')) {
+        c = getchar_unlocked();
+    }
+
+    int negative = 0;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        c = getchar_unlocked();
+    }
+
+    unsigned long long value = 0;
+    while (c >= '0' && c <= '9') {
+        value = value * 10 + (unsigned)(c - '0');
+        c = getchar_unlocked();
+    }
+    if (c != EOF) {
+        ungetc(c, stdin);
+    }
+    return (long long)(negative ? 0 - value : value);
+}
+
+static void write_integer(long long value) {
+    // 取绝对值时用无符号运算，最小的负数也不会溢出
+    unsigned long long magnitude = (unsigned long long)value;
+    if (value < 0) {
+        putchar_unlocked('-');
+        magnitude = 0 - magnitude;
+    }
+
+    char digits[20];
+    int len = 0;
+    do {
+        digits[len++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (len > 0) {
+        putchar_unlocked(digits[--len]);
+    }
+}
+
+AIRYC_RUNTIME int getint(void) { return (int)read_integer(); }
+
+AIRYC_RUNTIME long long getlong(void) { return read_integer(); }
+
+// 读取一个字符，文件结束时返回 -1
+AIRYC_RUNTIME int getch(void) { return getchar_unlocked(); }
+
+// 先读取长度 n，再读取 n 个整数存入 array，返回 n
+AIRYC_RUNTIME int getarray(int *array) {
+    int len = getint();
+    for (int i = 0; i < len; i++) {
+        array[i] = getint();
+    }
+    return len;
+}
+
+AIRYC_RUNTIME void putint(int value) { write_integer(value); }
+
+AIRYC_RUNTIME void putlong(long long value) { write_integer(value); }
+
+AIRYC_RUNTIME void putch(int c) { putchar_unlocked(c); }
+
+// 输出 `n: a[0] a[1] ...` 并换行
+AIRYC_RUNTIME void putarray(int len, const int *array) {
+    write_integer(len);
+    putchar_unlocked(':');
+    for (int i = 0; i < len; i++) {
+        putchar_unlocked(' ');
+        write_integer(array[i]);
+    }
+    putchar_unlocked('\n');
+}
+
+// starttime 和 stoptime 之间经过的时间累加起来，程序退出时输出到 stderr
+static struct timespec timer_start;
+static long long timer_total_us;
+static int timer_registered;
+
+static void report_time(void) {
+    long long us = timer_total_us;
+    fprintf(stderr, "TOTAL: %lldH-%lldM-%lldS-%lldus\n", us / 3600000000LL,
+            us / 60000000LL % 60, us / 1000000LL % 60, us % 1000000LL);
+}
+
+AIRYC_RUNTIME void starttime(void) {
+    if (!timer_registered) {
+        timer_registered = 1;
+        atexit(report_time);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &timer_start);
+}
+
+AIRYC_RUNTIME void stoptime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timer_total_us += (long long)(now.tv_sec - timer_start.tv_sec) * 1000000LL +
+                      (now.tv_nsec - timer_start.tv_nsec) / 1000;
+}
@@ -0,0 +1,120 @@
+//! 标识符驻留
+//!
+//! 整个进程共享一张驻留表，同一个标识符只保存一份，[`Name`] 是指向它的句柄。以 `Name`
+//! 为键的表比较和哈希都只涉及一个 `u32` 编号。驻留的字符串不会释放：标识符的种类有限，
+//! 语言服务器长期运行也只会缓慢增长
+
+use std::{
+    fmt,
+    hash::{Hash, Hasher},
+    ops::Deref,
+    sync::{OnceLock, RwLock},
+};
+
+use crate::hash::FxHashMap;
+
+/// 驻留后的标识符
+///
+/// 句柄直接指向驻留的条目，读取字符串不经过驻留表，也不加锁
+#[derive(Clone, Copy)]
+pub struct Name(&'static Entry);
+
+struct Entry {
+    id: u32,
+    text: &'static str,
+}
+
+#[derive(Default)]
+struct Interner {
+    map: FxHashMap<&'static str, Name>,
+}
+
+fn interner() -> &'static RwLock<Interner> {
+    static INTERNER: OnceLock<RwLock<Interner>> = OnceLock::new();
+    INTERNER.get_or_init(Default::default)
+}
+
+impl Name {
+    /// 驻留 `text`，已经驻留过时返回原来的句柄
+    pub fn new(text: &str) -> Self {
+        if let Some(name) = Self::lookup(text) {
+            return name;
+        }
+        let mut interner = interner().write().unwrap();
+        // 可能在释放读锁后被其他线程驻留
+        if let Some(&name) = interner.map.get(text) {
+            return name;
+        }
+        let text: &'static str = Box::leak(text.into());
+        let entry = Box::leak(Box::new(Entry {
+            id: interner.map.len() as u32,
+            text,
+        }));
+        let name = Name(entry);
+        interner.map.insert(text, name);
+        name
+    }
+
+    /// 查找已驻留的 `text`，不存在时返回 `None` 且不驻留
+    ///
+    /// 用于只读的查找：没有驻留过的标识符一定不在任何以 `Name` 为键的表中
+    pub fn lookup(text: &str) -> Option<Self> {
+        interner().read().unwrap().map.get(text).copied()
+    }
+
+    pub fn as_str(self) -> &'static str {
+        self.0.text
+    }
+}
+
+impl PartialEq for Name {
+    fn eq(&self, other: &Self) -> bool {
+        self.0.id == other.0.id
+    }
+}
+
+impl Eq for Name {}
+
+impl Hash for Name {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        self.0.id.hash(state);
+    }
+}
+
+impl Deref for Name {
+    type Target = str;
+
+    fn deref(&self) -> &str {
+        self.as_str()
+    }
+}
+
+impl From<&str> for Name {
+    fn from(text: &str) -> Self {
+        Self::new(text)
+    }
+}
+
+impl From<&String> for Name {
+    fn from(text: &String) -> Self {
+        Self::new(text)
+    }
+}
+
+impl From<String> for Name {
+    fn from(text: String) -> Self {
+        Self::new(&text)
+    }
+}
+
+impl fmt::Debug for Name {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        fmt::Debug::fmt(self.as_str(), f)
+    }
+}
+
+impl fmt::Display for Name {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str(self.as_str())
+    }
+}
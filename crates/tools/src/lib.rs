@@ -5,3 +5,13 @@ pub use text_range::TextRange;
 
 mod line_index;
 pub use line_index::LineIndex;
+
+mod text_edit;
+pub use text_edit::TextEdit;
+
+pub mod profile;
+
+pub mod hash;
+
+mod intern;
+pub use intern::Name;
@@ -1,26 +1,102 @@
-#[derive(Debug)]
+use crate::TextEdit;
+
+#[derive(Debug, Clone)]
 pub struct LineIndex {
     spilit_points: Vec<u32>, // 开区间
+    /// 每一行中的多字节字符，纯 ASCII 行为空，此时 UTF-16 列号与字节列号相同
+    wide_chars: Vec<Vec<WideChar>>,
+}
+
+/// 行内的多字节字符
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct WideChar {
+    /// 行内字节偏移
+    start: u32,
+    /// UTF-8 编码长度
+    len: u8,
+}
+
+impl WideChar {
+    fn end(&self) -> u32 {
+        self.start + self.len as u32
+    }
+
+    /// UTF-16 编码长度
+    fn len_utf16(&self) -> u32 {
+        if self.len == 4 { 2 } else { 1 }
+    }
 }
 
 impl LineIndex {
     pub fn new(spilit_points: Vec<u32>) -> Self {
-        Self { spilit_points }
+        let wide_chars = vec![Vec::new(); spilit_points.len() + 1];
+        Self {
+            spilit_points,
+            wide_chars,
+        }
     }
 
     /// 从文本创建 LineIndex，扫描所有换行符位置
     pub fn from_text(text: &str) -> Self {
+        // `match_indices` 对单字节字符使用 memchr 按字扫描
         let spilit_points: Vec<u32> = text
-            .char_indices()
-            .filter_map(|(idx, ch)| {
-                if ch == '\n' {
-                    Some((idx + 1) as u32) // +1 因为是开区间
-                } else {
-                    None
-                }
-            })
+            .match_indices('\n')
+            .map(|(idx, _)| (idx + 1) as u32) // +1 因为是开区间
             .collect();
-        Self { spilit_points }
+        let wide_chars = if text.is_ascii() {
+            vec![Vec::new(); spilit_points.len() + 1]
+        } else {
+            Self::line_slices(text, 0, &spilit_points, text.len() as u32)
+                .map(Self::collect_wide_chars)
+                .collect()
+        };
+        Self {
+            spilit_points,
+            wide_chars,
+        }
+    }
+
+    /// 将编辑应用到索引上，`new_text` 为编辑后的完整文本
+    ///
+    /// 只重新扫描被编辑的行，之后的换行位置整体平移
+    pub fn apply_edit(&mut self, edit: &TextEdit, new_text: &str) {
+        let start = u32::from(edit.range.start());
+        let end = u32::from(edit.range.end());
+        let delta = edit.delta();
+
+        // 旧文本中 (start, end] 内的换行被删除
+        let first_line = self.spilit_points.partition_point(|x| *x <= start);
+        let last_line = self.spilit_points.partition_point(|x| *x <= end);
+
+        let inserted = edit
+            .insert
+            .match_indices('\n')
+            .map(|(idx, _)| start + idx as u32 + 1);
+        let shifted: Vec<u32> = self.spilit_points[last_line..]
+            .iter()
+            .map(|x| (*x as i64 + delta) as u32)
+            .collect();
+        self.spilit_points.truncate(first_line);
+        self.spilit_points.extend(inserted);
+        let new_last_line = self.spilit_points.len();
+        self.spilit_points.extend(shifted);
+
+        // 重新扫描受影响的行
+        let first_line_start = self.line_start(first_line as u32);
+        let last_line_end = self
+            .spilit_points
+            .get(new_last_line)
+            .copied()
+            .unwrap_or(new_text.len() as u32);
+        let rescanned: Vec<_> = Self::line_slices(
+            new_text,
+            first_line_start,
+            &self.spilit_points[first_line..new_last_line],
+            last_line_end,
+        )
+        .map(Self::collect_wide_chars)
+        .collect();
+        self.wide_chars.splice(first_line..=last_line, rescanned);
     }
 
     pub fn get_row_column(&self, offset: u32) -> (u32, u32) {
@@ -40,4 +116,78 @@ impl LineIndex {
             self.spilit_points[row as usize - 1] + col
         }
     }
+
+    /// 与 [`LineIndex::get_row_column`] 相同，但列号以 UTF-16 编码单元计
+    pub fn get_row_column_utf16(&self, offset: u32) -> (u32, u32) {
+        let (row, col) = self.get_row_column(offset);
+        (row, self.to_utf16_col(row, col))
+    }
+
+    /// 与 [`LineIndex::get_offset`] 相同，但列号以 UTF-16 编码单元计
+    pub fn get_offset_utf16(&self, row: u32, col: u32) -> u32 {
+        self.get_offset(row, self.to_byte_col(row, col))
+    }
+
+    /// 行内字节列号转换为 UTF-16 列号
+    pub fn to_utf16_col(&self, row: u32, col: u32) -> u32 {
+        let Some(wide_chars) = self.wide_chars.get(row as usize) else {
+            return col;
+        };
+        let mut res = col;
+        for c in wide_chars {
+            if c.end() > col {
+                break;
+            }
+            res = res - c.len as u32 + c.len_utf16();
+        }
+        res
+    }
+
+    /// 行内 UTF-16 列号转换为字节列号
+    pub fn to_byte_col(&self, row: u32, col: u32) -> u32 {
+        let Some(wide_chars) = self.wide_chars.get(row as usize) else {
+            return col;
+        };
+        let mut res = col;
+        for c in wide_chars {
+            // 多字节字符之前的 UTF-16 列号
+            let start_utf16 = c.start - (res - col);
+            if start_utf16 >= col {
+                break;
+            }
+            res = res + c.len as u32 - c.len_utf16();
+        }
+        res
+    }
+
+    fn line_start(&self, row: u32) -> u32 {
+        self.get_offset(row, 0)
+    }
+
+    /// 把 `start..end` 按换行位置 `points` 切分出的各行文本
+    fn line_slices<'a>(
+        text: &'a str,
+        start: u32,
+        points: &'a [u32],
+        end: u32,
+    ) -> impl Iterator<Item = &'a str> + 'a {
+        let starts = std::iter::once(start).chain(points.iter().copied());
+        let ends = points.iter().copied().chain(std::iter::once(end));
+        starts
+            .zip(ends)
+            .map(|(s, e)| text.get(s as usize..e as usize).unwrap_or(""))
+    }
+
+    fn collect_wide_chars(line: &str) -> Vec<WideChar> {
+        if line.is_ascii() {
+            return Vec::new();
+        }
+        line.char_indices()
+            .filter(|(_, ch)| !ch.is_ascii())
+            .map(|(idx, ch)| WideChar {
+                start: idx as u32,
+                len: ch.len_utf8() as u8,
+            })
+            .collect()
+    }
 }
@@ -0,0 +1,138 @@
+//! 编译阶段的计时和计数
+//!
+//! 默认关闭，关闭时 [`span`] 和 [`count`] 只读取一个原子变量。开启后记录每个计时区间所在的
+//! 线程、开始时间和持续时间，由调用方汇总为各阶段耗时或导出为时间线
+
+use std::{
+    cell::Cell,
+    sync::{
+        Mutex, OnceLock,
+        atomic::{AtomicBool, AtomicU64, Ordering},
+    },
+    time::{Duration, Instant},
+};
+
+static ENABLED: AtomicBool = AtomicBool::new(false);
+static EPOCH: OnceLock<Instant> = OnceLock::new();
+static EVENTS: Mutex<Vec<Event>> = Mutex::new(Vec::new());
+static COUNTERS: Mutex<Vec<(&'static str, u64)>> = Mutex::new(Vec::new());
+
+thread_local! {
+    /// 当前线程的编号，按第一次记录事件的顺序分配
+    static THREAD: Cell<Option<u64>> = const { Cell::new(None) };
+}
+
+/// 一个已结束的计时区间
+#[derive(Debug, Clone)]
+pub struct Event {
+    pub name: &'static str,
+    /// 附加信息，例如模块名；为空时表示整个阶段
+    pub detail: Option<String>,
+    pub thread: u64,
+    /// 相对于 [`enable`] 调用时刻的开始时间
+    pub start: Duration,
+    pub duration: Duration,
+}
+
+/// 开启记录
+pub fn enable() {
+    EPOCH.get_or_init(Instant::now);
+    ENABLED.store(true, Ordering::Relaxed);
+}
+
+pub fn is_enabled() -> bool {
+    ENABLED.load(Ordering::Relaxed)
+}
+
+/// 从开启记录到现在经过的时间
+pub fn elapsed() -> Duration {
+    EPOCH.get().map(Instant::elapsed).unwrap_or_default()
+}
+
+/// 计时区间，析构时记录
+#[must_use]
+pub struct Span {
+    name: &'static str,
+    detail: Option<String>,
+    /// 没有开启记录时为 None
+    start: Option<Instant>,
+}
+
+/// 开始一个阶段的计时
+pub fn span(name: &'static str) -> Span {
+    Span {
+        name,
+        detail: None,
+        start: is_enabled().then(Instant::now),
+    }
+}
+
+/// 开始一个带附加信息的计时，`detail` 只在开启记录时调用
+pub fn span_with(name: &'static str, detail: impl FnOnce() -> String) -> Span {
+    if !is_enabled() {
+        return Span {
+            name,
+            detail: None,
+            start: None,
+        };
+    }
+    Span {
+        name,
+        detail: Some(detail()),
+        start: Some(Instant::now()),
+    }
+}
+
+impl Drop for Span {
+    fn drop(&mut self) {
+        let Some(start) = self.start else {
+            return;
+        };
+        let duration = start.elapsed();
+        let epoch = *EPOCH.get_or_init(Instant::now);
+        let event = Event {
+            name: self.name,
+            detail: self.detail.take(),
+            thread: current_thread(),
+            start: start.saturating_duration_since(epoch),
+            duration,
+        };
+        EVENTS.lock().unwrap().push(event);
+    }
+}
+
+/// 累加计数器 `name`
+pub fn count(name: &'static str, n: u64) {
+    if !is_enabled() {
+        return;
+    }
+    let mut counters = COUNTERS.lock().unwrap();
+    match counters.iter_mut().find(|(counter, _)| *counter == name) {
+        Some((_, value)) => *value += n,
+        None => counters.push((name, n)),
+    }
+}
+
+/// 取出已记录的所有事件，按开始时间排序
+pub fn take_events() -> Vec<Event> {
+    let mut events = std::mem::take(&mut *EVENTS.lock().unwrap());
+    events.sort_by_key(|event| event.start);
+    events
+}
+
+/// 所有计数器，按第一次计数的顺序
+pub fn counters() -> Vec<(&'static str, u64)> {
+    COUNTERS.lock().unwrap().clone()
+}
+
+fn current_thread() -> u64 {
+    static NEXT: AtomicU64 = AtomicU64::new(0);
+    THREAD.with(|thread| match thread.get() {
+        Some(id) => id,
+        None => {
+            let id = NEXT.fetch_add(1, Ordering::Relaxed);
+            thread.set(Some(id));
+            id
+        }
+    })
+}
@@ -0,0 +1,93 @@
+use crate::TextRange;
+
+/// 文本编辑：把旧文本中 `range` 范围内的内容替换为 `insert`
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct TextEdit {
+    /// 被替换的范围（旧文本坐标）
+    pub range: TextRange,
+    /// 插入的文本
+    pub insert: String,
+}
+
+impl TextEdit {
+    pub fn new(range: TextRange, insert: String) -> Self {
+        Self { range, insert }
+    }
+
+    /// 编辑后文本长度的变化量
+    pub fn delta(&self) -> i64 {
+        self.insert.len() as i64 - u32::from(self.range.len()) as i64
+    }
+
+    /// 将编辑应用到文本上
+    pub fn apply(&self, text: &mut String) {
+        let start = u32::from(self.range.start()) as usize;
+        let end = u32::from(self.range.end()) as usize;
+        text.replace_range(start..end, &self.insert);
+    }
+
+    /// 根据公共前缀和公共后缀计算从 `old` 到 `new` 的最小编辑
+    ///
+    /// 两段文本相同时返回 `None`
+    pub fn diff(old: &str, new: &str) -> Option<Self> {
+        if old == new {
+            return None;
+        }
+        let (old_bytes, new_bytes) = (old.as_bytes(), new.as_bytes());
+
+        let mut prefix = old_bytes
+            .iter()
+            .zip(new_bytes)
+            .take_while(|(a, b)| a == b)
+            .count();
+        while !old.is_char_boundary(prefix) || !new.is_char_boundary(prefix) {
+            prefix -= 1;
+        }
+
+        let max_suffix = old.len().min(new.len()) - prefix;
+        let mut suffix = old_bytes
+            .iter()
+            .rev()
+            .zip(new_bytes.iter().rev())
+            .take(max_suffix)
+            .take_while(|(a, b)| a == b)
+            .count();
+        while !old.is_char_boundary(old.len() - suffix) || !new.is_char_boundary(new.len() - suffix)
+        {
+            suffix -= 1;
+        }
+
+        Some(Self {
+            range: TextRange::new(prefix as u32, (old.len() - suffix) as u32),
+            insert: new[prefix..new.len() - suffix].to_string(),
+        })
+    }
+
+    /// 将依次应用的多个编辑合并为一个覆盖所有修改的编辑（以第一个编辑之前的文本为坐标）
+    ///
+    /// `final_text` 为应用所有编辑后的文本
+    pub fn compose(edits: &[TextEdit], final_text: &str) -> Option<Self> {
+        // 合并的区域：旧文本中的 [start, old_end)，当前文本中的 [start, new_end)
+        let mut iter = edits.iter();
+        let first = iter.next()?;
+        let mut start = u32::from(first.range.start()) as i64;
+        let mut old_end = u32::from(first.range.end()) as i64;
+        let mut new_end = start + first.insert.len() as i64;
+
+        for edit in iter {
+            let a = u32::from(edit.range.start()) as i64;
+            let b = u32::from(edit.range.end()) as i64;
+            if b > new_end {
+                old_end += b - new_end;
+            }
+            new_end = new_end.max(b) + edit.delta();
+            start = start.min(a);
+        }
+
+        let insert = final_text.get(start as usize..new_end as usize)?;
+        Some(Self {
+            range: TextRange::new(start as u32, old_end as u32),
+            insert: insert.to_string(),
+        })
+    }
+}
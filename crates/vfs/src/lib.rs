@@ -1,12 +1,18 @@
 use std::collections::HashMap;
 use std::ops::{Deref, DerefMut};
 use std::path::PathBuf;
+use std::sync::Arc;
 
-use parking_lot::{RwLock, RwLockReadGuard, RwLockWriteGuard};
+use parking_lot::{RwLock, RwLockWriteGuard};
 use thunderdome::{Arena, Index};
-use tools::LineIndex;
+use tools::{LineIndex, TextEdit};
+
+pub mod load;
 
 /// 虚拟文件系统，支持并发访问
+///
+/// 文件以 `Arc` 共享，读取只在复制 `Arc` 时短暂持有读锁；并行阶段应先取得
+/// [`VfsSnapshot`]，之后的读取完全不加锁
 #[derive(Debug)]
 pub struct Vfs {
     /// 内部数据，使用 RwLock 保护
@@ -14,35 +20,34 @@ pub struct Vfs {
 }
 
 /// VFS 内部数据结构
-#[derive(Debug)]
+#[derive(Debug, Clone, Default)]
 struct VfsInner {
-    /// 文件存储
-    files: Arena<VirtulFile>,
+    /// 文件存储，修改时写时复制，不影响已有的快照
+    files: Arena<Arc<VirtulFile>>,
     /// 路径到文件 ID 的映射
-    index: HashMap<PathBuf, FileID>,
+    index: Arc<HashMap<PathBuf, FileID>>,
 }
 
 impl Default for Vfs {
     fn default() -> Self {
         Self {
-            inner: RwLock::new(VfsInner {
-                files: Arena::new(),
-                index: HashMap::new(),
-            }),
+            inner: RwLock::new(VfsInner::default()),
         }
     }
 }
 
-#[derive(Debug)]
+#[derive(Debug, Clone)]
 pub struct VirtulFile {
     /// 文件的绝对路径
     pub path: PathBuf,
-    pub text: String,
+    /// 文件内容，不可变，修改时整体替换
+    pub text: Arc<str>,
     pub line_index: LineIndex,
 }
 
 impl VirtulFile {
-    pub fn new(path: PathBuf, text: String) -> Self {
+    pub fn new(path: PathBuf, text: impl Into<Arc<str>>) -> Self {
+        let text = text.into();
         let line_index = LineIndex::from_text(&text);
         Self {
             path,
@@ -50,33 +55,32 @@ impl VirtulFile {
             line_index,
         }
     }
+
+    /// 应用编辑，增量更新 LineIndex
+    pub fn apply_edit(&mut self, edit: &TextEdit) {
+        let mut text = String::with_capacity((self.text.len() as i64 + edit.delta()) as usize);
+        text.push_str(&self.text);
+        edit.apply(&mut text);
+        self.text = text.into();
+        self.line_index.apply_edit(edit, &self.text);
+    }
 }
 
 utils::define_id_type!(FileID);
 
-/// 只读文件引用守卫
+/// 只读文件引用
 ///
-/// 持有 VFS 的读锁，保证在守卫存在期间数据不会被修改
+/// 持有文件的 `Arc`，不持有 VFS 的锁；之后对文件的修改不会反映到已有的引用上
 pub struct VfsFileRef<'a> {
-    guard: RwLockReadGuard<'a, VfsInner>,
-    index: Index,
-}
-
-impl<'a> VfsFileRef<'a> {
-    fn new(guard: RwLockReadGuard<'a, VfsInner>, index: Index) -> Option<Self> {
-        if guard.files.get(index).is_some() {
-            Some(Self { guard, index })
-        } else {
-            None
-        }
-    }
+    file: Arc<VirtulFile>,
+    _vfs: std::marker::PhantomData<&'a Vfs>,
 }
 
 impl<'a> Deref for VfsFileRef<'a> {
     type Target = VirtulFile;
 
     fn deref(&self) -> &Self::Target {
-        self.guard.files.get(self.index).expect("Invalid FileID")
+        &self.file
     }
 }
 
@@ -108,14 +112,61 @@ impl<'a> Deref for VfsFileMut<'a> {
 
 impl<'a> DerefMut for VfsFileMut<'a> {
     fn deref_mut(&mut self) -> &mut Self::Target {
-        self.guard
+        let file = self
+            .guard
             .files
             .get_mut(self.index)
-            .expect("Invalid FileID")
+            .expect("Invalid FileID");
+        Arc::make_mut(file)
+    }
+}
+
+/// 某一时刻所有文件的只读快照
+///
+/// 创建时只复制文件的 `Arc`，之后的读取不加锁，适合在并行阶段中使用
+#[derive(Debug, Clone, Default)]
+pub struct VfsSnapshot {
+    inner: VfsInner,
+}
+
+impl VfsSnapshot {
+    /// 根据路径获取文件 ID
+    pub fn get_file_id_by_path(&self, path: &PathBuf) -> Option<FileID> {
+        self.inner.index.get(path).copied()
+    }
+
+    /// 获取文件
+    pub fn get_file_by_file_id(&self, id: &FileID) -> Option<&VirtulFile> {
+        self.inner.files.get(**id).map(|file| &**file)
+    }
+
+    /// 获取所有文件 ID
+    pub fn file_ids(&self) -> Vec<FileID> {
+        self.inner
+            .files
+            .iter()
+            .map(|(idx, _)| FileID(idx))
+            .collect()
+    }
+}
+
+/// 从快照创建独立的 VFS，之后的修改互不影响
+impl From<VfsSnapshot> for Vfs {
+    fn from(snapshot: VfsSnapshot) -> Self {
+        Self {
+            inner: RwLock::new(snapshot.inner),
+        }
     }
 }
 
 impl Vfs {
+    /// 获取所有文件的快照
+    pub fn snapshot(&self) -> VfsSnapshot {
+        VfsSnapshot {
+            inner: self.inner.read().clone(),
+        }
+    }
+
     /// 根据路径获取文件 ID
     pub fn get_file_id_by_path(&self, path: &PathBuf) -> Option<FileID> {
         let inner = self.inner.read();
@@ -124,8 +175,11 @@ impl Vfs {
 
     /// 获取文件的只读引用
     pub fn get_file_by_file_id(&self, id: &FileID) -> Option<VfsFileRef<'_>> {
-        let guard = self.inner.read();
-        VfsFileRef::new(guard, **id)
+        let file = Arc::clone(self.inner.read().files.get(**id)?);
+        Some(VfsFileRef {
+            file,
+            _vfs: std::marker::PhantomData,
+        })
     }
 
     /// 获取文件的可写引用
@@ -135,28 +189,47 @@ impl Vfs {
     }
 
     /// 原子添加文件到 VFS（使用绝对路径）
-    pub fn new_file(&self, path: PathBuf, text: String) -> FileID {
+    pub fn new_file(&self, path: PathBuf, text: impl Into<Arc<str>>) -> FileID {
+        let file = Arc::new(VirtulFile::new(path.clone(), text));
         let mut inner = self.inner.write();
-        let file = VirtulFile::new(path.clone(), text);
         let id = FileID(inner.files.insert(file));
-        inner.index.insert(path, id);
+        Arc::make_mut(&mut inner.index).insert(path, id);
         id
     }
 
+    /// 批量添加文件，只加一次写锁，返回的 ID 与 `files` 的顺序一致
+    pub fn new_files(&self, files: impl IntoIterator<Item = VirtulFile>) -> Vec<FileID> {
+        let mut inner = self.inner.write();
+        let inner = &mut *inner;
+        let index = Arc::make_mut(&mut inner.index);
+        files
+            .into_iter()
+            .map(|file| {
+                let path = file.path.clone();
+                let id = FileID(inner.files.insert(Arc::new(file)));
+                index.insert(path, id);
+                id
+            })
+            .collect()
+    }
+
     /// 原子从 VFS 中删除文件
     pub fn remove_file(&self, file_id: &FileID) -> bool {
         let mut inner = self.inner.write();
         let Some(file) = inner.files.remove(**file_id) else {
             return false;
         };
-        inner.index.remove(&file.path).is_some()
+        Arc::make_mut(&mut inner.index).remove(&file.path).is_some()
     }
 
     /// 原子更新文件内容
-    pub fn update_file(&self, file_id: &FileID, text: String) -> bool {
+    pub fn update_file(&self, file_id: &FileID, text: impl Into<Arc<str>>) -> bool {
+        let text = text.into();
+        let line_index = LineIndex::from_text(&text);
         let mut inner = self.inner.write();
         if let Some(file) = inner.files.get_mut(**file_id) {
-            file.line_index = LineIndex::from_text(&text);
+            let file = Arc::make_mut(file);
+            file.line_index = line_index;
             file.text = text;
             true
         } else {
@@ -164,6 +237,20 @@ impl Vfs {
         }
     }
 
+    /// 原子地对文件应用编辑，编辑范围越界时返回 false
+    pub fn apply_edit(&self, file_id: &FileID, edit: &TextEdit) -> bool {
+        let mut inner = self.inner.write();
+        let Some(file) = inner.files.get_mut(**file_id) else {
+            return false;
+        };
+        let range: std::ops::Range<usize> = edit.range.into();
+        if file.text.get(range).is_none() {
+            return false;
+        }
+        Arc::make_mut(file).apply_edit(edit);
+        true
+    }
+
     /// 获取所有文件 ID 的快照
     pub fn file_ids(&self) -> Vec<FileID> {
         let inner = self.inner.read();
@@ -201,14 +288,14 @@ mod tests {
 
         // 读取文件
         let file = vfs.get_file_by_file_id(&file_id).unwrap();
-        assert_eq!(file.text, "content");
+        assert_eq!(&*file.text, "content");
         assert_eq!(file.path, path);
         drop(file); // 显式释放守卫
 
         // 更新文件
         assert!(vfs.update_file(&file_id, "new content".to_string()));
         let file = vfs.get_file_by_file_id(&file_id).unwrap();
-        assert_eq!(file.text, "new content");
+        assert_eq!(&*file.text, "new content");
         drop(file);
 
         // 删除文件
@@ -228,7 +315,7 @@ mod tests {
                 thread::spawn(move || {
                     for _ in 0..100 {
                         let file = vfs.get_file_by_file_id(&file_id).unwrap();
-                        assert_eq!(file.text, "content");
+                        assert_eq!(&*file.text, "content");
                     }
                 })
             })
@@ -325,6 +412,67 @@ mod tests {
         assert_eq!(count, 3);
     }
 
+    #[test]
+    fn test_apply_edit() {
+        let vfs = Vfs::default();
+        let id = vfs.new_file(PathBuf::from("/edit.airy"), "a\nbc\nd".to_string());
+
+        let edit = TextEdit::new(tools::TextRange::new(2, 4), "中\n😀x".to_string());
+        assert!(vfs.apply_edit(&id, &edit));
+
+        let file = vfs.get_file_by_file_id(&id).unwrap();
+        assert_eq!(&*file.text, "a\n中\n😀x\nd");
+        let fresh = LineIndex::from_text(&file.text);
+        for offset in [0, 2, 5, 6, 10, 11, 12] {
+            assert_eq!(
+                file.line_index.get_row_column_utf16(offset),
+                fresh.get_row_column_utf16(offset)
+            );
+        }
+        // UTF-16 列号：emoji 占两个编码单元
+        assert_eq!(file.line_index.get_row_column_utf16(10), (2, 2));
+        assert_eq!(file.line_index.get_offset_utf16(2, 2), 10);
+        drop(file);
+
+        // 越界的编辑被拒绝
+        let edit = TextEdit::new(tools::TextRange::new(0, 100), String::new());
+        assert!(!vfs.apply_edit(&id, &edit));
+    }
+
+    #[test]
+    fn test_snapshot() {
+        let vfs = Vfs::default();
+        let path = PathBuf::from("/snapshot.airy");
+        let id = vfs.new_file(path.clone(), "old");
+
+        let snapshot = vfs.snapshot();
+        let file = vfs.get_file_by_file_id(&id).unwrap();
+        assert!(vfs.update_file(&id, "new"));
+        let other = vfs.new_file(PathBuf::from("/other.airy"), "other");
+
+        // 快照和已有的引用不受之后修改的影响
+        assert_eq!(&*snapshot.get_file_by_file_id(&id).unwrap().text, "old");
+        assert_eq!(&*file.text, "old");
+        assert_eq!(snapshot.get_file_id_by_path(&path), Some(id));
+        assert!(snapshot.get_file_by_file_id(&other).is_none());
+        assert_eq!(&*vfs.get_file_by_file_id(&id).unwrap().text, "new");
+        assert_eq!(vfs.snapshot().file_ids().len(), 2);
+    }
+
+    #[test]
+    fn test_vfs_from_snapshot() {
+        let vfs = Vfs::default();
+        let id = vfs.new_file(PathBuf::from("/a.airy"), "a");
+        let copy = Vfs::from(vfs.snapshot());
+
+        assert!(vfs.update_file(&id, "b"));
+        assert_eq!(&*copy.get_file_by_file_id(&id).unwrap().text, "a");
+        let edit = TextEdit::new(tools::TextRange::new(0, 1), "c".to_string());
+        assert!(copy.apply_edit(&id, &edit));
+        assert_eq!(&*vfs.get_file_by_file_id(&id).unwrap().text, "b");
+        assert_eq!(&*copy.get_file_by_file_id(&id).unwrap().text, "c");
+    }
+
     #[test]
     fn test_multiple_files() {
         let vfs = Vfs::default();
@@ -337,7 +485,52 @@ mod tests {
         let file1 = vfs.get_file_by_file_id(&id1).unwrap();
         let file2 = vfs.get_file_by_file_id(&id2).unwrap();
 
-        assert_eq!(file1.text, "content1");
-        assert_eq!(file2.text, "content2");
+        assert_eq!(&*file1.text, "content1");
+        assert_eq!(&*file2.text, "content2");
+    }
+
+    #[test]
+    fn test_new_files_and_scan_dir() {
+        let dir = std::env::temp_dir().join(format!("airyc-vfs-scan-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::create_dir_all(dir.join("nested/deep")).unwrap();
+        std::fs::create_dir_all(dir.join("ignored")).unwrap();
+        std::fs::write(dir.join(".gitignore"), "ignored/\n").unwrap();
+        std::fs::write(dir.join("a.airy"), "fn a() {}").unwrap();
+        std::fs::write(dir.join("nested/deep/b.airy"), "fn b() {}").unwrap();
+        std::fs::write(dir.join("ignored/c.airy"), "fn c() {}").unwrap();
+        std::fs::write(dir.join("notes.txt"), "not airy").unwrap();
+        // 超过 mmap 阈值的文件
+        let large = "let x: i32 = 0;\n".repeat(8192);
+        std::fs::write(dir.join("nested/large.airy"), &large).unwrap();
+
+        let files = load::scan_dir(&dir, "airy");
+        let names: Vec<_> = files
+            .iter()
+            .map(|file| file.path.strip_prefix(&dir).unwrap().to_path_buf())
+            .collect();
+        assert_eq!(
+            names,
+            [
+                PathBuf::from("a.airy"),
+                PathBuf::from("nested/deep/b.airy"),
+                PathBuf::from("nested/large.airy"),
+            ]
+        );
+        assert_eq!(&*files[2].text, large);
+
+        let vfs = Vfs::default();
+        let paths: Vec<_> = files.iter().map(|file| file.path.clone()).collect();
+        let ids = vfs.new_files(files);
+        assert_eq!(ids.len(), 3);
+        for (path, id) in paths.iter().zip(&ids) {
+            assert_eq!(vfs.get_file_id_by_path(path), Some(*id));
+        }
+        assert_eq!(
+            &*vfs.get_file_by_file_id(&ids[0]).unwrap().text,
+            "fn a() {}"
+        );
+
+        std::fs::remove_dir_all(&dir).unwrap();
     }
 }
@@ -0,0 +1,50 @@
+//! 从磁盘批量读取文件
+//!
+//! 读取和构建 LineIndex 都在工作线程上完成，得到的 [`VirtulFile`] 通过 [`Vfs::new_files`]
+//! 一次加锁插入
+//!
+//! [`Vfs::new_files`]: crate::Vfs::new_files
+
+use std::fs;
+use std::io;
+use std::path::Path;
+use std::sync::Arc;
+
+use ignore::{WalkBuilder, WalkState};
+use parking_lot::Mutex;
+
+use crate::VirtulFile;
+
+/// 读取 UTF-8 文本文件，不是 UTF-8 时返回 [`io::ErrorKind::InvalidData`]
+pub fn read_text(path: &Path) -> io::Result<Arc<str>> {
+    fs::read_to_string(path).map(Arc::from)
+}
+
+/// 并行递归扫描 `root` 下扩展名为 `extension` 的文件
+///
+/// 遵循 `.gitignore`、`.ignore` 和 git 的全局排除规则（不要求位于 git 仓库中），跳过隐藏文件；
+/// 读取失败或不是 UTF-8 的文件被跳过。结果按路径排序，插入 VFS 后 FileID 的顺序是确定的
+pub fn scan_dir(root: &Path, extension: &str) -> Vec<VirtulFile> {
+    let files = Mutex::new(Vec::new());
+    WalkBuilder::new(root)
+        .require_git(false)
+        .build_parallel()
+        .run(|| {
+            let files = &files;
+            Box::new(move |entry| {
+                if let Ok(entry) = entry
+                    && entry.file_type().is_some_and(|ty| ty.is_file())
+                    && entry.path().extension().is_some_and(|ext| ext == extension)
+                    && let Ok(text) = read_text(entry.path())
+                {
+                    let file = VirtulFile::new(entry.into_path(), text);
+                    files.lock().push(file);
+                }
+                WalkState::Continue
+            })
+        });
+
+    let mut files = files.into_inner();
+    files.sort_by(|a, b| a.path.cmp(&b.path));
+    files
+}